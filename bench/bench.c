@@ -0,0 +1,687 @@
+/*
+ *  性能测试: 合成图像按缩放方式、倍数、尺寸、线程数、整图/数据流逐项测试
+ *  源图像由程序生成, 数据流模式通过 zoom_stream 回调按行提供, 不含jpeg编解码耗时
+ *  编译运行: make bench 或 make bench BENCH_ARGS="-q -j"; 校验各SIMD级别的输出一致: make bench BENCH_ARGS=-c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "zoom.h"
+#include "zoom_kernel.h"
+#include "pool.h"
+
+// 合成图像的不同行数(质数, 避免与缩放倍数的周期对齐), 数据流模式循环使用这些行
+#define BENCH_ROWS 61
+
+// 输入或输出超过这个像素数的组合跳过(100MP放大时内存占用过大)
+#define BENCH_MAX_PIXELS 200000000L
+
+// 每项最多执行次数
+#define BENCH_REPS_MAX 1000
+
+typedef struct
+{
+    const char *name;
+    int width, height;
+} Bench_Size;
+
+static const Bench_Size _sizes[] = {
+    {"vga", 640, 480},
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+    {"12mp", 4000, 3000},
+    {"100mp", 11552, 8664},
+};
+#define BENCH_SIZES (int)(sizeof(_sizes) / sizeof(_sizes[0]))
+
+// 与 Zoom_Type、Zoom_Format 的顺序一致
+static const char *_types[] = {"near", "linear", "cubic", "lanczos3", "area"};
+static const char *_formats[] = {"rgb", "bgr", "gray", "rgbx", "rgba", "rgba_pm", "uv"};
+#define BENCH_TYPES (int)(sizeof(_types) / sizeof(_types[0]))
+#define BENCH_FORMATS (int)(sizeof(_formats) / sizeof(_formats[0]))
+
+#define BENCH_LIST 16
+
+//测试参数, 各列表以逗号分隔的命令行参数给出
+typedef struct
+{
+    int size[BENCH_LIST], sizes;
+    int type[BENCH_LIST], types;
+    float zoom[BENCH_LIST];
+    int zooms;
+    int thread[BENCH_LIST], threads;
+    int format[BENCH_LIST], formats;
+    int whole, stream; // 测试整图模式、数据流模式
+    int reps;          // 每项最少执行次数
+    double budget;     // 每项最少耗时(秒), 执行次数不够时继续
+    int json;
+    int check; // 校验模式(-c), 不测性能
+} Bench_Args;
+
+//一项测试的结果
+typedef struct
+{
+    int size, type, format, stream;
+    int widthOut, heightOut;
+    float zoom;
+    int threads, reps;
+    double p50, p90, p99, min; // 单次耗时(毫秒)
+    double mpixIn, mpixOut;    // 按中位耗时计算的每秒处理像素(百万)
+    long rssKb;                // 峰值内存
+} Bench_Result;
+
+//合成数据流: 行数据从 BENCH_ROWS 行合成图像中循环取出
+typedef struct
+{
+    unsigned char *rows;
+    int rowSize;
+    int y;
+} Bench_Stream;
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//峰值内存清零(写 /proc/self/clear_refs), 不支持时峰值为进程启动以来的最大值
+static void bench_rss_reset(void)
+{
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (fp)
+    {
+        fputs("5", fp);
+        fclose(fp);
+    }
+}
+
+//峰值内存(KB)
+static long bench_rss_peak(void)
+{
+    char line[256];
+    long kb = -1;
+    struct rusage ru;
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp)
+    {
+        while (fgets(line, sizeof(line), fp))
+        {
+            if (sscanf(line, "VmHWM: %ld", &kb) == 1)
+                break;
+        }
+        fclose(fp);
+    }
+    if (kb < 0 && getrusage(RUSAGE_SELF, &ru) == 0)
+        kb = ru.ru_maxrss;
+    return kb;
+}
+
+//合成行: 平滑渐变加少量噪声, 接近照片的像素变化
+static void bench_fill(unsigned char *rows, int rowSize, int count)
+{
+    unsigned int seed = 12345;
+    int x, y;
+    for (y = 0; y < count; y++)
+    {
+        for (x = 0; x < rowSize; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            rows[(long)y * rowSize + x] = (unsigned char)((x * 7 + y * 13) / 8 + ((seed >> 16) & 15));
+        }
+    }
+}
+
+static int bench_read(void *obj, unsigned char *line, int lines)
+{
+    Bench_Stream *st = (Bench_Stream *)obj;
+    int i;
+    for (i = 0; i < lines; i++, st->y++)
+        memcpy(&line[i * st->rowSize], &st->rows[st->y % BENCH_ROWS * st->rowSize], st->rowSize);
+    return lines;
+}
+
+static int bench_write(void *obj, unsigned char *line, int lines)
+{
+    //只计数, 输出行直接丢弃
+    *(long *)obj += lines;
+    return lines;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+    double d = *(const double *)a - *(const double *)b;
+    return d < 0 ? -1 : (d > 0 ? 1 : 0);
+}
+
+//百分位(最近秩), sorted 已从小到大排序
+static double bench_pct(const double *sorted, int count, int pct)
+{
+    int i = (count * pct + 99) / 100 - 1;
+    if (i < 0)
+        i = 0;
+    if (i > count - 1)
+        i = count - 1;
+    return sorted[i];
+}
+
+/*
+ *  执行一项测试
+ *  参数:
+ *      src: 整图模式的源图像(整幅), 数据流模式为 BENCH_ROWS 行合成行
+ *  返回: 0成功 -1失败
+ */
+static int bench_case(Bench_Args *args, Bench_Result *r, unsigned char *src)
+{
+    const Bench_Size *sz = &_sizes[r->size];
+    Zoom_Plan *plan = NULL;
+    Bench_Stream st;
+    unsigned char *out = NULL;
+    double ms[BENCH_REPS_MAX], t, begin;
+    long written;
+    int n, w, h, ret = 0;
+    int bpp = zoom_format_bytes((Zoom_Format)r->format);
+
+    //线程数限制对之后创建的计划、数据流生效, 超过cpu核心数时按实际线程数记录
+    pool_limit(r->threads);
+    r->threads = pool_threads();
+    bench_rss_reset();
+
+    if (!r->stream)
+    {
+        plan = zoom_plan_create(sz->width, sz->height, r->widthOut, r->heightOut, (Zoom_Type)r->type, (Zoom_Format)r->format);
+        out = (unsigned char *)malloc((size_t)r->widthOut * r->heightOut * bpp);
+        if (!plan || !out)
+            ret = -1;
+    }
+
+    begin = bench_now();
+    for (n = 0; ret == 0 && n < BENCH_REPS_MAX; n++)
+    {
+        //次数和总耗时都够了才结束
+        if (n >= args->reps && bench_now() - begin >= args->budget)
+            break;
+        t = bench_now();
+        if (!r->stream)
+            ret = zoom_plan_execute(plan, src, out);
+        else
+        {
+            st.rows = src;
+            st.rowSize = sz->width * bpp;
+            st.y = 0;
+            written = 0;
+            if (r->threads > 1)
+                zoom_stream_parallel(&st, &written, &bench_read, &bench_write, sz->width, sz->height, &w, &h,
+                                     r->zoom, (Zoom_Type)r->type, (Zoom_Format)r->format, 0, 0);
+            else
+                zoom_stream(&st, &written, &bench_read, &bench_write, sz->width, sz->height, &w, &h,
+                            r->zoom, (Zoom_Type)r->type, (Zoom_Format)r->format, 0);
+            if (written < 1 || written != h)
+                ret = -1;
+        }
+        ms[n] = (bench_now() - t) * 1000;
+    }
+    r->rssKb = bench_rss_peak();
+    zoom_plan_destroy(plan);
+    free(out);
+    pool_limit(0);
+
+    if (ret != 0 || n < 1)
+        return -1;
+
+    qsort(ms, n, sizeof(double), &bench_cmp);
+    r->reps = n;
+    r->min = ms[0];
+    r->p50 = bench_pct(ms, n, 50);
+    r->p90 = bench_pct(ms, n, 90);
+    r->p99 = bench_pct(ms, n, 99);
+    r->mpixIn = (double)sz->width * sz->height / (r->p50 * 1000);
+    r->mpixOut = (double)r->widthOut * r->heightOut / (r->p50 * 1000);
+    return 0;
+}
+
+static void bench_print(Bench_Args *args, Bench_Result *r, int first)
+{
+    const Bench_Size *sz = &_sizes[r->size];
+    if (args->json)
+    {
+        printf("%s\n  {\"size\": \"%s\", \"width\": %d, \"height\": %d, \"width_out\": %d, \"height_out\": %d, "
+               "\"type\": \"%s\", \"format\": \"%s\", \"zoom\": %g, \"mode\": \"%s\", \"threads\": %d, \"reps\": %d, "
+               "\"ms_min\": %.4f, \"ms_p50\": %.4f, \"ms_p90\": %.4f, \"ms_p99\": %.4f, "
+               "\"mpix_in_s\": %.2f, \"mpix_out_s\": %.2f, \"peak_rss_kb\": %ld}",
+               first ? "" : ",", sz->name, sz->width, sz->height, r->widthOut, r->heightOut,
+               _types[r->type], _formats[r->format], r->zoom, r->stream ? "stream" : "whole", r->threads, r->reps,
+               r->min, r->p50, r->p90, r->p99, r->mpixIn, r->mpixOut, r->rssKb);
+        return;
+    }
+    if (first)
+        printf("%-6s %-12s %-8s %-7s %5s %-6s %3s %5s %10s %10s %9s %9s %9s %9s\n",
+               "size", "out", "type", "format", "zoom", "mode", "thr", "reps",
+               "in MP/s", "out MP/s", "p50 ms", "p90 ms", "p99 ms", "rss MB");
+    printf("%-6s %5dx%-6d %-8s %-7s %5.2f %-6s %3d %5d %10.1f %10.1f %9.3f %9.3f %9.3f %9.1f\n",
+           sz->name, r->widthOut, r->heightOut, _types[r->type], _formats[r->format], r->zoom,
+           r->stream ? "stream" : "whole", r->threads, r->reps,
+           r->mpixIn, r->mpixOut, r->p50, r->p90, r->p99, r->rssKb / 1024.0);
+    fflush(stdout);
+}
+
+//按名称查找, 找不到时按序号解析, 返回-1无效
+static int bench_lookup(const char *item, const char **names, int count)
+{
+    char *end;
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        if (strcmp(item, names[i]) == 0)
+            return i;
+    }
+    i = (int)strtol(item, &end, 10);
+    return (*end == 0 && i >= 0 && i < count) ? i : -1;
+}
+
+//逗号分隔的列表: 名称或序号
+static int bench_list(char *arg, int *list, const char **names, int count)
+{
+    char *item;
+    int n = 0, i;
+    for (item = strtok(arg, ","); item && n < BENCH_LIST; item = strtok(NULL, ","))
+    {
+        if ((i = bench_lookup(item, names, count)) < 0)
+        {
+            fprintf(stderr, "bench: unknown item %s\n", item);
+            return -1;
+        }
+        list[n++] = i;
+    }
+    return n;
+}
+
+// -------------------------- 校验模式 --------------------------
+// 各SIMD级别(ZOOM_SIMD=0~3)分别在子进程中执行同一组缩放, 输出与级别0逐字节比较;
+// 最近点、双线性再与按定位表 i * src / dist 逐点计算的参考结果比较, 覆盖有理数倍率重复模式和通用版本
+
+// 有理数倍率 p/q, 源尺寸为 q * BENCH_CHECK_K(奇数)时正好整除, 加1后不整除(只按通用版本处理)
+static const int _checkRatio[][2] = {{2, 1}, {3, 1}, {4, 1}, {3, 2}, {5, 2}, {4, 3}, {7, 4}, {1, 2}, {1, 4}, {2, 3}, {3, 4}, {8, 3}};
+#define BENCH_CHECK_RATIOS (int)(sizeof(_checkRatio) / sizeof(_checkRatio[0]))
+#define BENCH_CHECK_K 151
+#define BENCH_CHECK_CASES (BENCH_CHECK_RATIOS * 2 * BENCH_FORMATS * BENCH_TYPES)
+
+static unsigned long long bench_hash(const unsigned char *data, long size)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    long i;
+    for (i = 0; i < size; i++)
+        h = (h ^ data[i]) * 1099511628211ULL;
+    return h;
+}
+
+//参考定位: 同 zoom.c 的定位表, 输出第i点对应源坐标 i * src / dist
+static void bench_step(int i, int src, int dist, Zoom_Step *st)
+{
+    long long pos = ((long long)i * src << ZOOM_FIX_BITS) / dist;
+    st->i1 = (int)(pos >> ZOOM_FIX_BITS);
+    st->w = (int)(pos >> (ZOOM_FIX_BITS - ZOOM_W_BITS)) & (ZOOM_W_ONE - 1);
+    st->i2 = (pos & ((1 << ZOOM_FIX_BITS) - 1)) ? st->i1 + 1 : st->i1;
+    if (st->i2 >= src)
+        st->i2 = src - 1;
+    if (st->i1 >= src)
+        st->i1 = src - 1;
+}
+
+//最近点、双线性与参考结果比较, 返回不一致的字节数
+static long bench_reference(const unsigned char *src, int width, int height,
+                            const unsigned char *out, int widthOut, int heightOut, int zt, int bpp)
+{
+    const unsigned char *l1, *l2;
+    Zoom_Step sx, sy;
+    long bad = 0;
+    int x, y, c, v;
+
+    for (y = 0; y < heightOut; y++)
+    {
+        bench_step(y, height, heightOut, &sy);
+        l1 = &src[(long)sy.i1 * width * bpp];
+        l2 = &src[(long)sy.i2 * width * bpp];
+        for (x = 0; x < widthOut; x++)
+        {
+            bench_step(x, width, widthOut, &sx);
+            for (c = 0; c < bpp; c++)
+            {
+                if (zt == ZT_NEAR)
+                    v = l1[sx.i1 * bpp + c];
+                else
+                    v = LINEAR(l1[sx.i1 * bpp + c], l1[sx.i2 * bpp + c], l2[sx.i1 * bpp + c], l2[sx.i2 * bpp + c], sx.w, sy.w);
+                bad += v != out[((long)y * widthOut + x) * bpp + c];
+            }
+        }
+    }
+    return bad;
+}
+
+/*
+ *  子进程: 按当前 ZOOM_SIMD 级别执行全部校验项
+ *  参数:
+ *      hash: 返回每项输出的哈希, BENCH_CHECK_CASES 个
+ *  返回: 与参考结果不一致的项数
+ */
+static int bench_check_level(unsigned long long *hash)
+{
+    unsigned char *src, *out;
+    Zoom_Plan *plan;
+    int r, e, f, t, i = 0, bad = 0;
+    int width, height, widthOut, heightOut, bpp;
+
+    for (r = 0; r < BENCH_CHECK_RATIOS; r++)
+    {
+        for (e = 0; e < 2; e++)
+        {
+            width = _checkRatio[r][1] * BENCH_CHECK_K + e;
+            height = _checkRatio[r][1] * 13 + e;
+            widthOut = _checkRatio[r][0] * BENCH_CHECK_K;
+            heightOut = _checkRatio[r][0] * 13;
+            for (f = 0; f < BENCH_FORMATS; f++)
+            {
+                bpp = zoom_format_bytes((Zoom_Format)f);
+                src = (unsigned char *)malloc((size_t)width * height * bpp);
+                out = (unsigned char *)malloc((size_t)widthOut * heightOut * bpp);
+                bench_fill(src, width * bpp, height);
+                for (t = 0; t < BENCH_TYPES; t++, i++)
+                {
+                    memset(out, 0, (size_t)widthOut * heightOut * bpp);
+                    plan = zoom_plan_create(width, height, widthOut, heightOut, (Zoom_Type)t, (Zoom_Format)f);
+                    if (!plan || zoom_plan_execute(plan, src, out) != 0)
+                        hash[i] = 0;
+                    else
+                        hash[i] = bench_hash(out, (long)widthOut * heightOut * bpp);
+                    zoom_plan_destroy(plan);
+                    if ((t == ZT_NEAR || t == ZT_LINEAR) &&
+                        bench_reference(src, width, height, out, widthOut, heightOut, t, bpp) != 0)
+                    {
+                        fprintf(stderr, "check: %dx%d -> %dx%d %s %s differs from reference\n",
+                                width, height, widthOut, heightOut, _types[t], _formats[f]);
+                        bad += 1;
+                    }
+                }
+                free(src);
+                free(out);
+            }
+        }
+    }
+    return bad;
+}
+
+/*
+ *  校验模式: 每个SIMD级别一个子进程(内核级别在首次缩放时确定, 之后不能再切换)
+ *  返回: 0全部一致 1有不一致
+ */
+static int bench_check(void)
+{
+    static unsigned long long hash[4][BENCH_CHECK_CASES];
+    char level[8];
+    int fd[2], lv, i, status, bad = 0;
+    long n, got;
+    pid_t pid;
+
+    for (lv = 0; lv < 4; lv++)
+    {
+        if (pipe(fd) != 0 || (pid = fork()) < 0)
+        {
+            fprintf(stderr, "check: fork failed\n");
+            return 1;
+        }
+        if (pid == 0)
+        {
+            close(fd[0]);
+            snprintf(level, sizeof(level), "%d", lv);
+            setenv("ZOOM_SIMD", level, 1);
+            i = bench_check_level(hash[lv]);
+            printf("check: ZOOM_SIMD=%d kernel %s, %d cases, %d differ from reference\n",
+                   lv, zoom_kernel(3)->name, BENCH_CHECK_CASES, i);
+            fflush(stdout);
+            n = write(fd[1], hash[lv], sizeof(hash[lv]));
+            _exit(i == 0 && n == (long)sizeof(hash[lv]) ? 0 : 1);
+        }
+        close(fd[1]);
+        for (got = 0; got < (long)sizeof(hash[lv]); got += n)
+        {
+            if ((n = read(fd[0], (char *)hash[lv] + got, sizeof(hash[lv]) - got)) < 1)
+                break;
+        }
+        close(fd[0]);
+        if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+            got != (long)sizeof(hash[lv]))
+        {
+            bad = 1;
+            continue;
+        }
+        //各级别与级别0(标量)逐项比较
+        for (i = 0; lv > 0 && i < BENCH_CHECK_CASES; i++)
+        {
+            if (hash[lv][i] != hash[0][i])
+            {
+                fprintf(stderr, "check: ZOOM_SIMD=%d case %d (%s %s) differs from ZOOM_SIMD=0\n",
+                        lv, i, _types[i % BENCH_TYPES], _formats[i / BENCH_TYPES % BENCH_FORMATS]);
+                bad = 1;
+            }
+        }
+    }
+    printf("check: %s\n", bad ? "FAILED" : "ok");
+    return bad;
+}
+
+static void bench_help(char *name)
+{
+    printf(
+        "Usage: %s [options]\n"
+        "  -s list   sizes: vga,720p,1080p,4k,12mp,100mp (default all)\n"
+        "  -z list   zoom types: near,linear,cubic,lanczos3,area (default all)\n"
+        "  -f list   zoom factors (default 0.25,0.5,2)\n"
+        "  -t list   thread counts (default 1,2,4,... up to cpu count)\n"
+        "  -p list   pixel formats: rgb,bgr,gray,rgbx,rgba,rgba_pm,uv (default rgb)\n"
+        "  -m list   modes: whole,stream (default both)\n"
+        "  -n reps   minimum runs per case (default 3)\n"
+        "  -b sec    minimum time per case (default 0.3)\n"
+        "  -q        quick: vga,1080p / linear,cubic / 0.5,2\n"
+        "  -j        JSON output\n"
+        "  -c        verify: every SIMD level (ZOOM_SIMD=0..3) and the ratio path against the reference, odd sizes\n"
+        "  -h        show this help\n",
+        name);
+}
+
+//命令行参数, 返回0继续 1已显示帮助(-h) -1参数有误
+static int bench_args(Bench_Args *args, int argc, char **argv)
+{
+    const char *modes[] = {"whole", "stream"};
+    const char *sizeNames[BENCH_SIZES];
+    char *item;
+    int i, opt, n, mode[2];
+    int cpus = pool_threads();
+
+    memset(args, 0, sizeof(Bench_Args));
+    for (i = 0; i < BENCH_SIZES; i++)
+        sizeNames[i] = _sizes[i].name;
+    //默认全部
+    for (i = 0; i < BENCH_SIZES; i++)
+        args->size[args->sizes++] = i;
+    for (i = 0; i < BENCH_TYPES; i++)
+        args->type[args->types++] = i;
+    args->zoom[args->zooms++] = 0.25;
+    args->zoom[args->zooms++] = 0.5;
+    args->zoom[args->zooms++] = 2;
+    for (i = 1; i < cpus && args->threads < BENCH_LIST - 1; i *= 2)
+        args->thread[args->threads++] = i;
+    args->thread[args->threads++] = cpus;
+    args->format[args->formats++] = ZF_RGB;
+    args->whole = args->stream = 1;
+    args->reps = 3;
+    args->budget = 0.3;
+
+    while ((opt = getopt(argc, argv, "s:z:f:t:p:m:n:b:qjch")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            n = args->sizes = bench_list(optarg, args->size, sizeNames, BENCH_SIZES);
+            break;
+        case 'z':
+            n = args->types = bench_list(optarg, args->type, _types, BENCH_TYPES);
+            break;
+        case 'p':
+            n = args->formats = bench_list(optarg, args->format, _formats, BENCH_FORMATS);
+            break;
+        case 'm':
+            n = bench_list(optarg, mode, modes, 2);
+            args->whole = args->stream = 0;
+            for (i = 0; i < n; i++)
+                *(mode[i] ? &args->stream : &args->whole) = 1;
+            break;
+        case 'f':
+            for (n = 0, item = strtok(optarg, ","); item && n < BENCH_LIST; item = strtok(NULL, ","))
+            {
+                if ((args->zoom[n] = atof(item)) <= 0)
+                    n = -BENCH_LIST;
+                n++;
+            }
+            args->zooms = n;
+            break;
+        case 't':
+            for (n = 0, item = strtok(optarg, ","); item && n < BENCH_LIST; item = strtok(NULL, ","))
+            {
+                if ((args->thread[n] = atoi(item)) < 1)
+                    n = -BENCH_LIST;
+                n++;
+            }
+            args->threads = n;
+            break;
+        case 'n':
+            n = args->reps = atoi(optarg);
+            break;
+        case 'b':
+            args->budget = atof(optarg);
+            n = args->budget >= 0 ? 1 : -1;
+            break;
+        case 'q':
+            args->sizes = args->types = args->zooms = 2;
+            args->size[0] = 0;
+            args->size[1] = 2;
+            args->type[0] = ZT_LINEAR;
+            args->type[1] = ZT_CUBIC;
+            args->zoom[0] = 0.5;
+            args->zoom[1] = 2;
+            n = 1;
+            break;
+        case 'j':
+            n = args->json = 1;
+            break;
+        case 'c':
+            n = args->check = 1;
+            break;
+        case 'h':
+            bench_help(argv[0]);
+            return 1;
+        default:
+            n = -1;
+            break;
+        }
+        if (n < 1)
+        {
+            bench_help(argv[0]);
+            return -1;
+        }
+    }
+    if (args->reps > BENCH_REPS_MAX)
+        args->reps = BENCH_REPS_MAX;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    Bench_Args args;
+    Bench_Result r;
+    unsigned char *src;
+    int s, z, f, t, p, m, first = 1;
+    long pixels;
+
+    if ((s = bench_args(&args, argc, argv)) != 0)
+        return s < 0 ? 1 : 0;
+    if (args.check)
+        return bench_check();
+
+    if (args.json)
+        printf("{\"cpus\": %d, \"results\": [", pool_threads());
+    else
+        printf("bench: %d cpus\n", pool_threads());
+
+    for (s = 0; s < args.sizes; s++)
+    {
+        for (p = 0; p < args.formats; p++)
+        {
+            //整图模式先测(需要整幅源图像), 释放后再测数据流模式; 峰值内存每项测试前清零, 含源图像
+            for (m = 0; m < 2; m++)
+            {
+                const Bench_Size *sz = &_sizes[args.size[s]];
+                int bpp = zoom_format_bytes((Zoom_Format)args.format[p]);
+                int rows = m ? BENCH_ROWS : sz->height;
+
+                if ((m == 0 && !args.whole) || (m == 1 && !args.stream))
+                    continue;
+                src = (unsigned char *)malloc((size_t)sz->width * rows * bpp);
+                if (!src)
+                {
+                    fprintf(stderr, "bench: no memory for %s\n", sz->name);
+                    continue;
+                }
+                bench_fill(src, sz->width * bpp, rows);
+
+                for (z = 0; z < args.types; z++)
+                {
+                    for (f = 0; f < args.zooms; f++)
+                    {
+                        for (t = 0; t < args.threads; t++)
+                        {
+                            //单线程数据流用 zoom_stream, 多线程用 zoom_stream_parallel
+                            memset(&r, 0, sizeof(r));
+                            r.size = args.size[s];
+                            r.type = args.type[z];
+                            r.format = args.format[p];
+                            r.stream = m;
+                            r.zoom = args.zoom[f];
+                            r.threads = args.thread[t];
+                            r.widthOut = (int)(sz->width * r.zoom);
+                            r.heightOut = (int)(sz->height * r.zoom);
+                            if (r.widthOut < 1)
+                                r.widthOut = 1;
+                            if (r.heightOut < 1)
+                                r.heightOut = 1;
+                            pixels = (long)r.widthOut * r.heightOut;
+                            if (pixels > BENCH_MAX_PIXELS)
+                            {
+                                if (!args.json)
+                                    fprintf(stderr, "bench: skip %s x%g (%ld pixels out)\n", sz->name, r.zoom, pixels);
+                                continue;
+                            }
+                            if (bench_case(&args, &r, src) != 0)
+                            {
+                                fprintf(stderr, "bench: %s %s x%g failed\n", sz->name, _types[r.type], r.zoom);
+                                continue;
+                            }
+                            bench_print(&args, &r, first);
+                            first = 0;
+                        }
+                    }
+                }
+                free(src);
+            }
+        }
+    }
+
+    if (args.json)
+        printf("\n]}\n");
+    return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ *  批量缩放
+ *  工作线程从列表中按顺序领取整张图片, 各自解码、缩放、编码, 互不等待
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "batch.h"
+#include "jpeg.h"
+#include "pool.h"
+#include "stats.h"
+
+typedef struct
+{
+    char **inFiles;
+    int count;
+    char *outDir;
+    float zm;
+    Zoom_Type zt;
+    int quality;
+    void (*report)(void *, int, int, int, int);
+    void *obj;
+
+    char *same; // 各文件是否与前面的文件同名(输出路径相同)
+
+    pthread_mutex_t lock;
+    int next; // 下一个待领取的文件
+    int ok;   // 成功的文件数
+} Zoom_Batch;
+
+//领取一个文件序号, 返回-1已领完
+static int _batch_take(Zoom_Batch *batch)
+{
+    int index = -1;
+    pthread_mutex_lock(&batch->lock);
+    if (batch->next < batch->count)
+        index = batch->next++;
+    pthread_mutex_unlock(&batch->lock);
+    return index;
+}
+
+//输入路径中的文件名
+static char *_batch_name(char *inFile)
+{
+    char *name = strrchr(inFile, '/');
+    return name ? name + 1 : inFile;
+}
+
+//输出路径: 输出目录 + 输入文件名
+static void _batch_out_path(Zoom_Batch *batch, char *inFile, char *path, int size)
+{
+    snprintf(path, size, "%s/%s", batch->outDir, _batch_name(inFile));
+}
+
+typedef struct
+{
+    char *name;
+    int index;
+} Zoom_Batch_Name;
+
+static int _batch_name_cmp(const void *a, const void *b)
+{
+    const Zoom_Batch_Name *na = (const Zoom_Batch_Name *)a;
+    const Zoom_Batch_Name *nb = (const Zoom_Batch_Name *)b;
+    int ret = strcmp(na->name, nb->name);
+    return ret ? ret : na->index - nb->index;
+}
+
+//标记同名文件: 按文件名排序, 同名的只保留列表中序号最小的, 返回0成功 -1内存不足
+static int _batch_same(Zoom_Batch *batch)
+{
+    Zoom_Batch_Name *names;
+    int i;
+
+    batch->same = (char *)calloc(batch->count + 1, 1);
+    names = (Zoom_Batch_Name *)calloc(batch->count + 1, sizeof(Zoom_Batch_Name));
+    if (!batch->same || !names)
+    {
+        free(names);
+        return -1;
+    }
+    for (i = 0; i < batch->count; i++)
+    {
+        names[i].name = _batch_name(batch->inFiles[i]);
+        names[i].index = i;
+    }
+    qsort(names, batch->count, sizeof(Zoom_Batch_Name), &_batch_name_cmp);
+    for (i = 1; i < batch->count; i++)
+    {
+        if (strcmp(names[i].name, names[i - 1].name) == 0)
+            batch->same[names[i].index] = 1;
+    }
+    free(names);
+    return 0;
+}
+
+//处理一个文件, 返回状态
+static int _batch_file(Zoom_Batch *batch, char *inFile, char *outFile, int *retWidth, int *retHeight)
+{
+    unsigned char *map, *outMap;
+    int width = 0, height = 0, pb = 3, ret;
+    float zm = batch->zm;
+
+    //缩小时按DCT缩放解码, zm 返回余下的缩放倍数
+    map = jpeg_get(inFile, &width, &height, &pb, &zm);
+    if (!map)
+        return ZB_ERR_READ;
+    outMap = zoom(map, width, height, retWidth, retHeight, zm, batch->zt, pb == 1 ? ZF_GRAY : ZF_RGB);
+    free(map);
+    if (!outMap)
+        return ZB_ERR_ZOOM;
+    ret = jpeg_create(outFile, outMap, *retWidth, *retHeight, pb, batch->quality);
+    free(outMap);
+    return ret == 0 ? ZB_OK : ZB_ERR_WRITE;
+}
+
+//一个线程池任务(一个线程)反复领取文件直到全部完成
+static void _batch_worker(Zoom_Batch *batch, int worker)
+{
+    char outFile[1024];
+    int index, status, width, height;
+    long long tick;
+
+    while ((index = _batch_take(batch)) >= 0)
+    {
+        tick = zoom_trace_on() ? zoom_stats_now() : 0;
+        width = height = 0;
+        if (batch->same[index])
+            status = ZB_ERR_SAME;
+        else
+        {
+            _batch_out_path(batch, batch->inFiles[index], outFile, sizeof(outFile));
+            status = _batch_file(batch, batch->inFiles[index], outFile, &width, &height);
+        }
+        if (tick)
+            zoom_trace_event("file", index, tick, zoom_stats_now());
+
+        pthread_mutex_lock(&batch->lock);
+        if (status == ZB_OK)
+            batch->ok += 1;
+        if (batch->report)
+            batch->report(batch->obj, index, status, width, height);
+        pthread_mutex_unlock(&batch->lock);
+    }
+}
+
+int zoom_batch(
+    char **inFiles, int count,
+    char *outDir,
+    float zm,
+    Zoom_Type zt,
+    int quality,
+    void (*report)(void *, int, int, int, int),
+    void *obj)
+{
+    Zoom_Batch batch = {
+        .inFiles = inFiles,
+        .count = count,
+        .outDir = outDir,
+        .zm = zm,
+        .zt = zt,
+        .quality = quality,
+        .report = report,
+        .obj = obj,
+    };
+    int threads;
+
+    // 参数检查
+    if (!inFiles || count < 0 || !outDir || zm <= 0 || quality < 1 || quality > 100)
+    {
+        fprintf(stderr, "zoom_batch: param error !!\n");
+        return -1;
+    }
+
+    //每核一个工作线程, 文件少于核数时按文件数
+    threads = pool_threads();
+    if (threads > count)
+        threads = count;
+
+    //同名文件会输出到同一路径, 领取前先标记
+    if (_batch_same(&batch) < 0)
+    {
+        fprintf(stderr, "zoom_batch: calloc failed !!\n");
+        return -1;
+    }
+
+    pthread_mutex_init(&batch.lock, NULL);
+    pool_run((void (*)(void *, int))&_batch_worker, &batch, threads);
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.same);
+
+    return batch.ok;
+}
@@ -0,0 +1,46 @@
+/*
+ *  批量缩放(如大量小图生成缩略图)
+ *  单张小图内部再分块并行收益很小, 改为每个工作线程处理整张图片, 线程数等于cpu核心数
+ */
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include "zoom.h"
+
+//单个文件的处理结果
+typedef enum
+{
+    ZB_OK = 0,         //成功
+    ZB_ERR_READ = -1,  //打开或解码失败
+    ZB_ERR_ZOOM = -2,  //缩放失败
+    ZB_ERR_WRITE = -3, //输出文件写入失败
+    ZB_ERR_SAME = -4,  //与列表中前面的文件同名(输出路径相同), 未处理
+} Zoom_Batch_Status;
+
+/*
+ *  批量缩放jpeg文件
+ *  参数:
+ *      inFiles: 输入文件路径列表
+ *      count: 文件数
+ *      outDir: 输出目录(须已存在), 输出文件与输入同名
+ *      zm: 缩放倍数,(0,1)小于1缩小倍数,(1,~]大于1放大倍数(缩小时先按DCT缩放解码)
+ *      zt: 缩放方式
+ *      quality: 输出图片质量,1~100
+ *      report: 每个文件处理完的回调, 不需要时传NULL
+ *            : 函数原型 void report(void *obj, int index, int status, int width, int height)
+ *            : index 为 inFiles 中的序号, status 见 Zoom_Batch_Status, width、height 为输出尺寸
+ *      obj: 用户私有参数,在调用 report 时传回给用户
+ *  返回: 成功的文件数, -1参数错误
+ *  说明: 文件按列表顺序领取, 完成顺序不确定; report 不会被同时调用, 但可能在不同线程中调用;
+ *       不同目录下的同名文件只处理列表中的第一个, 其余报告 ZB_ERR_SAME, 不会同时写同一个输出文件
+ */
+int zoom_batch(
+    char **inFiles, int count,
+    char *outDir,
+    float zm,
+    Zoom_Type zt,
+    int quality,
+    void (*report)(void *, int, int, int, int),
+    void *obj);
+
+#endif
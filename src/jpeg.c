@@ -1,131 +1,1420 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "jpeglib.h"
+#include "jerror.h"
+#include "zoom.h"
+#include "stats.h"
+#include "pool.h"
 
+// 按每像素字节数选择压缩输入格式(灰度图解码后每像素1字节)
+#define JPEG_COLOR_SPACE(pixelBytes) ((pixelBytes) == 1 ? JCS_GRAYSCALE : JCS_RGB)
+
+/*
+ *  DCT缩放解码: 缩小时让libjpeg在反DCT时直接输出 1/2、1/4、1/8 尺寸, 取仍不小于目标尺寸的最大缩小倍数,
+ *  余下的缩放交给像素缩放; 须在 jpeg_read_header 之后、jpeg_start_decompress 之前调用
+ *  参数:
+ *      zm: 相对原图的缩放倍数
+ *  返回: 缩小倍数的分母(1、2、4、8), 解码尺寸为原图宽高除以它(向上取整)
+ */
+static int _jpeg_scale(struct jpeg_decompress_struct *dinfo, float zm)
+{
+    int denom;
+    int width = (int)(dinfo->image_width * zm);
+    int height = (int)(dinfo->image_height * zm);
+
+    if (width < 1)
+        width = 1;
+    if (height < 1)
+        height = 1;
+    for (denom = 8; denom > 1; denom /= 2)
+    {
+        if ((int)(dinfo->image_width + denom - 1) / denom >= width &&
+            (int)(dinfo->image_height + denom - 1) / denom >= height)
+            break;
+    }
+    dinfo->scale_num = 1;
+    dinfo->scale_denom = denom;
+    return denom;
+}
+
+//解码输出的一个iMCU行的行数(DCT缩放后), libjpeg按此粒度输出
+static int _jpeg_imcu_rows(struct jpeg_decompress_struct *dinfo)
+{
+#if JPEG_LIB_VERSION >= 70
+    return dinfo->max_v_samp_factor * dinfo->min_DCT_v_scaled_size;
+#else
+    return dinfo->max_v_samp_factor * dinfo->min_DCT_scaled_size;
+#endif
+}
+
+//行指针数组每次最多装载的行数(libjpeg的iMCU最高16行)
+#define JPEG_ROWS_MAX 16
+
+// 输出缓冲大小: 输出到内存时为初始大小, 不够时翻倍; 输出到文件时每满一次写一次文件
+#define JPEG_OUT_BLOCK (64 * 1024)
+
+// 并行编码: 图像不小于这个像素数且多核时按条带并行编码, 每条不少于 JPEG_STRIP_PIXELS 像素(摊薄每条编码器的启动开销)
+#define JPEG_STRIP_MIN_PIXELS (1024 * 1024)
+#define JPEG_STRIP_PIXELS (256 * 1024)
+
+// 编解码上下文内存区: 新增内存块的最小大小, 分配对齐(libjpeg-turbo的SIMD要求行首32字节对齐)
+#define JPEG_ARENA_BLOCK (256 * 1024)
+#define JPEG_ARENA_ALIGN 64
+// 图像结束后内存区最多保留的字节数, 超出部分归还系统(常驻的线程池、批处理线程不会一直占着处理过的最大图像的内存)
+#define JPEG_ARENA_KEEP (4 * 1024 * 1024)
+
+/*
+ *  输入数据: mmap映射的文件或用户内存, 整块交给libjpeg直接读取, 不经过stdio缓冲和拷贝
+ *  (jpeg-6b 没有 jpeg_mem_src, 数据源管理器自己实现)
+ */
 typedef struct
 {
-    unsigned char r, g, b;
-} Jpeg_Rgb;
+    struct jpeg_source_mgr pub;
+    const unsigned char *data;
+    size_t size;
+    int mapped; // 1/mmap映射的文件, 用完需要munmap
+} Jpeg_Src;
 
+/*
+ *  输出目标: 文件(stdio)或内存
+ *  输出到内存时数据写入自动扩大的malloc缓冲, 编码完成时通过 data、size 返回给用户;
+ *  输出到文件时缓冲从编码器的图像内存中分配(不用 jpeg_stdio_dest, 复用的编码器上可能还挂着上次的输出目标)
+ */
 typedef struct
 {
+    struct jpeg_destination_mgr pub;
     FILE *fp;
-    int rw;       // 读写标志: 0/读 1/写
-    int rowCount; // 当前已处理行计数
-    int rowMax;   // rowCount计数目标
-    int rowSize;
-    struct jpeg_error_mgr jerr;
+    JOCTET *fileBuf;
+    unsigned char **data;
+    int *size;
+    unsigned char *buf;
+    size_t bufSize;
+    size_t used; // 并行编码直接写入内存缓冲的字节数
+} Jpeg_Out;
+
+/*
+ *  可恢复的错误处理: libjpeg默认遇到错误(如文件损坏)时直接exit()退出进程,
+ *  整图读写接口改为打印错误信息后跳回调用处返回失败, 批量处理时一个坏文件不影响其它文件
+ */
+typedef struct
+{
+    struct jpeg_error_mgr pub;
+    jmp_buf *jump;                 // 出错时跳回的位置, NULL时按libjpeg默认处理
+    void (*exit)(j_common_ptr);    // libjpeg默认的错误处理
+} Jpeg_Error;
+
+static void _jpeg_error_exit(j_common_ptr info)
+{
+    Jpeg_Error *err = (Jpeg_Error *)info->err;
+    if (!err->jump)
+        err->exit(info);
+    (*info->err->output_message)(info);
+    longjmp(*err->jump, 1);
+}
+
+static struct jpeg_error_mgr *_jpeg_error(Jpeg_Error *err)
+{
+    jpeg_std_error(&err->pub);
+    err->exit = err->pub.error_exit;
+    err->pub.error_exit = &_jpeg_error_exit;
+    err->jump = NULL;
+    return &err->pub;
+}
+
+// -------------------------- 编解码上下文 --------------------------
+// 编解码器对象用完不销毁, 由 jpeg_abort 复位后留给本线程下一幅图像使用, 省去每幅图像的创建、
+// 表格初始化; 每幅图像的内存(JPOOL_IMAGE)改从上下文自带的内存区顺序分配, 图像结束时整体回收,
+// 内存块留给下一幅图像, 同尺寸图像处理时不再 malloc/free
+
+//内存区的一个内存块, 数据从 JPEG_ARENA_ALIGN 偏移处开始
+typedef struct Jpeg_Block
+{
+    struct Jpeg_Block *next;
+    size_t size, used;
+} Jpeg_Block;
+
+typedef struct
+{
+    Jpeg_Block *block;          // 内存块链表, 从第一块分配
+    struct jpeg_memory_mgr mem; // libjpeg原内存管理方法(永久内存和虚拟数组仍由它分配)
+} Jpeg_Arena;
+
+typedef struct
+{
+    int rw; // 0/解码器 1/编码器
+    Jpeg_Error jerr;
+    Jpeg_Arena arena;
     struct jpeg_compress_struct cinfo;   // 压缩信息
     struct jpeg_decompress_struct dinfo; // 解压信息
-} Jpeg_Private;
+} Jpeg_Codec;
+
+static Jpeg_Block *_jpeg_block_new(size_t size)
+{
+    void *mem;
+    Jpeg_Block *b;
+    if (posix_memalign(&mem, JPEG_ARENA_ALIGN, JPEG_ARENA_ALIGN + size) != 0)
+        return NULL;
+    zoom_stats_bytes(zoom_stats_current(), JPEG_ARENA_ALIGN + size);
+    b = (Jpeg_Block *)mem;
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+static void _jpeg_arena_free(Jpeg_Arena *arena)
+{
+    Jpeg_Block *b;
+    while ((b = arena->block))
+    {
+        arena->block = b->next;
+        free(b);
+    }
+}
+
+//图像结束: 只有一块时直接复用, 多块时合并成一整块, 下一幅同尺寸的图像一块就够用;
+//合计超过 JPEG_ARENA_KEEP 时(如渐进式大图的系数缓冲)全部释放, 只保留 JPEG_ARENA_KEEP 大小的一块
+static void _jpeg_arena_reset(Jpeg_Arena *arena)
+{
+    Jpeg_Block *b;
+    size_t total = 0;
+    for (b = arena->block; b; b = b->next)
+        total += b->size;
+    if (total > JPEG_ARENA_KEEP)
+    {
+        _jpeg_arena_free(arena);
+        arena->block = _jpeg_block_new(JPEG_ARENA_KEEP);
+    }
+    else if (arena->block && arena->block->next)
+    {
+        _jpeg_arena_free(arena);
+        arena->block = _jpeg_block_new(total);
+    }
+    if (arena->block)
+        arena->block->used = 0;
+}
+
+static void *_jpeg_arena_alloc(j_common_ptr info, size_t size)
+{
+    Jpeg_Arena *arena = &((Jpeg_Codec *)info->client_data)->arena;
+    Jpeg_Block *b = arena->block;
+    void *mem;
+
+    size = (size + JPEG_ARENA_ALIGN - 1) & ~(size_t)(JPEG_ARENA_ALIGN - 1);
+    if (!b || b->size - b->used < size)
+    {
+        b = _jpeg_block_new(size > JPEG_ARENA_BLOCK ? size : JPEG_ARENA_BLOCK);
+        if (!b)
+            ERREXIT1(info, JERR_OUT_OF_MEMORY, 0);
+        b->next = arena->block;
+        arena->block = b;
+    }
+    mem = (char *)b + JPEG_ARENA_ALIGN + b->used;
+    b->used += size;
+    return mem;
+}
+
+static void *_jpeg_mem_small(j_common_ptr info, int pool, size_t size)
+{
+    if (pool != JPOOL_IMAGE)
+        return ((Jpeg_Codec *)info->client_data)->arena.mem.alloc_small(info, pool, size);
+    return _jpeg_arena_alloc(info, size);
+}
+
+static void *_jpeg_mem_large(j_common_ptr info, int pool, size_t size)
+{
+    if (pool != JPOOL_IMAGE)
+        return ((Jpeg_Codec *)info->client_data)->arena.mem.alloc_large(info, pool, size);
+    return _jpeg_arena_alloc(info, size);
+}
+
+//行数组: 行长度补齐到 JPEG_ARENA_ALIGN, 与libjpeg-turbo一致(SIMD按整块读写行尾)
+static JSAMPARRAY _jpeg_mem_sarray(j_common_ptr info, int pool, JDIMENSION samples, JDIMENSION rows)
+{
+    JSAMPARRAY array;
+    JSAMPROW data;
+    size_t rowSize;
+    JDIMENSION i;
+
+    if (pool != JPOOL_IMAGE)
+        return ((Jpeg_Codec *)info->client_data)->arena.mem.alloc_sarray(info, pool, samples, rows);
+    rowSize = ((size_t)samples * sizeof(JSAMPLE) + JPEG_ARENA_ALIGN - 1) & ~(size_t)(JPEG_ARENA_ALIGN - 1);
+    array = (JSAMPARRAY)_jpeg_arena_alloc(info, rows * sizeof(JSAMPROW));
+    data = (JSAMPROW)_jpeg_arena_alloc(info, rows * rowSize);
+    for (i = 0; i < rows; i++)
+        array[i] = (JSAMPROW)((char *)data + i * rowSize);
+    return array;
+}
+
+static JBLOCKARRAY _jpeg_mem_barray(j_common_ptr info, int pool, JDIMENSION blocks, JDIMENSION rows)
+{
+    JBLOCKARRAY array;
+    JBLOCKROW data;
+    JDIMENSION i;
+
+    if (pool != JPOOL_IMAGE)
+        return ((Jpeg_Codec *)info->client_data)->arena.mem.alloc_barray(info, pool, blocks, rows);
+    array = (JBLOCKARRAY)_jpeg_arena_alloc(info, rows * sizeof(JBLOCKROW));
+    data = (JBLOCKROW)_jpeg_arena_alloc(info, (size_t)rows * blocks * sizeof(JBLOCK));
+    for (i = 0; i < rows; i++)
+        array[i] = data + (size_t)i * blocks;
+    return array;
+}
+
+//释放图像内存时内存区一并回收(jpeg_abort、jpeg_finish_* 都会调用)
+static void _jpeg_mem_free(j_common_ptr info, int pool)
+{
+    Jpeg_Arena *arena = &((Jpeg_Codec *)info->client_data)->arena;
+    if (pool == JPOOL_IMAGE)
+        _jpeg_arena_reset(arena);
+    arena->mem.free_pool(info, pool);
+}
+
+static j_common_ptr _jpeg_codec_common(Jpeg_Codec *codec)
+{
+    return codec->rw ? (j_common_ptr)&codec->cinfo : (j_common_ptr)&codec->dinfo;
+}
+
+static Jpeg_Codec *_jpeg_codec_create(int rw)
+{
+    Jpeg_Codec *codec = (Jpeg_Codec *)calloc(1, sizeof(Jpeg_Codec));
+    j_common_ptr info;
+
+    codec->rw = rw;
+    if (rw)
+    {
+        codec->cinfo.err = _jpeg_error(&codec->jerr);
+        jpeg_create_compress(&codec->cinfo);
+    }
+    else
+    {
+        codec->dinfo.err = _jpeg_error(&codec->jerr);
+        jpeg_create_decompress(&codec->dinfo);
+    }
+
+    //图像内存改由内存区分配
+    info = _jpeg_codec_common(codec);
+    info->client_data = codec;
+    codec->arena.mem = *info->mem;
+    info->mem->alloc_small = &_jpeg_mem_small;
+    info->mem->alloc_large = &_jpeg_mem_large;
+    info->mem->alloc_sarray = &_jpeg_mem_sarray;
+    info->mem->alloc_barray = &_jpeg_mem_barray;
+    info->mem->free_pool = &_jpeg_mem_free;
+    return codec;
+}
+
+static void _jpeg_codec_destroy(Jpeg_Codec *codec)
+{
+    if (codec)
+    {
+        jpeg_destroy(_jpeg_codec_common(codec));
+        _jpeg_arena_free(&codec->arena);
+        free(codec);
+    }
+}
+
+//每个线程缓存一个解码器和一个编码器, 线程退出时销毁
+static pthread_key_t _jpeg_cache_key;
+static pthread_once_t _jpeg_cache_once = PTHREAD_ONCE_INIT;
+
+static void _jpeg_cache_free(void *arg)
+{
+    Jpeg_Codec **cache = (Jpeg_Codec **)arg;
+    _jpeg_codec_destroy(cache[0]);
+    _jpeg_codec_destroy(cache[1]);
+    free(cache);
+}
+
+static void _jpeg_cache_init(void)
+{
+    pthread_key_create(&_jpeg_cache_key, &_jpeg_cache_free);
+}
+
+//取本线程缓存的编解码器, 没有(或正被行处理模式占用)时新建
+static Jpeg_Codec *_jpeg_codec_get(int rw)
+{
+    Jpeg_Codec **cache, *codec;
+
+    pthread_once(&_jpeg_cache_once, &_jpeg_cache_init);
+    cache = (Jpeg_Codec **)pthread_getspecific(_jpeg_cache_key);
+    if (cache && cache[rw])
+    {
+        codec = cache[rw];
+        cache[rw] = NULL;
+        return codec;
+    }
+    return _jpeg_codec_create(rw);
+}
+
+//用完: jpeg_abort 复位(释放图像内存, 保留编解码器和内存区)后放回本线程缓存, 已有缓存时销毁
+static void _jpeg_codec_put(Jpeg_Codec *codec)
+{
+    Jpeg_Codec **cache;
+
+    jpeg_abort(_jpeg_codec_common(codec));
+    codec->jerr.jump = NULL;
+    cache = (Jpeg_Codec **)pthread_getspecific(_jpeg_cache_key);
+    if (!cache)
+    {
+        cache = (Jpeg_Codec **)calloc(2, sizeof(Jpeg_Codec *));
+        pthread_setspecific(_jpeg_cache_key, cache);
+    }
+    if (cache[codec->rw])
+        _jpeg_codec_destroy(codec);
+    else
+        cache[codec->rw] = codec;
+}
+
+static void _jpeg_src_init(j_decompress_ptr dinfo)
+{
+}
+
+//数据已全部交给libjpeg仍要读取(文件不完整): 插入EOI结束标记, 与 jpeg_stdio_src 读到文件尾时的处理相同
+static boolean _jpeg_src_fill(j_decompress_ptr dinfo)
+{
+    static const JOCTET eoi[2] = {0xFF, JPEG_EOI};
+    WARNMS(dinfo, JWRN_JPEG_EOF);
+    dinfo->src->next_input_byte = eoi;
+    dinfo->src->bytes_in_buffer = 2;
+    return TRUE;
+}
+
+static void _jpeg_src_skip(j_decompress_ptr dinfo, long num)
+{
+    struct jpeg_source_mgr *src = dinfo->src;
+    if (num <= 0)
+        return;
+    while (num > (long)src->bytes_in_buffer)
+    {
+        num -= (long)src->bytes_in_buffer;
+        _jpeg_src_fill(dinfo);
+    }
+    src->next_input_byte += num;
+    src->bytes_in_buffer -= num;
+}
+
+static void _jpeg_src_term(j_decompress_ptr dinfo)
+{
+}
+
+//输入数据交给解码器(每次从数据开头读取)
+static void _jpeg_src_attach(j_decompress_ptr dinfo, Jpeg_Src *src)
+{
+    src->pub.init_source = &_jpeg_src_init;
+    src->pub.fill_input_buffer = &_jpeg_src_fill;
+    src->pub.skip_input_data = &_jpeg_src_skip;
+    src->pub.resync_to_restart = &jpeg_resync_to_restart;
+    src->pub.term_source = &_jpeg_src_term;
+    src->pub.next_input_byte = src->data;
+    src->pub.bytes_in_buffer = src->size;
+    dinfo->src = &src->pub;
+}
+
+static void _jpeg_src_mem(Jpeg_Src *src, const unsigned char *data, int size)
+{
+    memset(src, 0, sizeof(Jpeg_Src));
+    src->data = data;
+    src->size = size > 0 ? size : 0;
+}
+
+//mmap映射输入文件, 返回: 0成功 -1失败
+static int _jpeg_src_file(Jpeg_Src *src, const char *inFile)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    memset(src, 0, sizeof(Jpeg_Src));
+    if ((fd = open(inFile, O_RDONLY)) < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 || st.st_size < 1)
+    {
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    //解码从头到尾顺序读取
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    src->data = (const unsigned char *)map;
+    src->size = st.st_size;
+    src->mapped = 1;
+    return 0;
+}
+
+static void _jpeg_src_close(Jpeg_Src *src)
+{
+    if (src->mapped)
+        munmap((void *)src->data, src->size);
+    memset(src, 0, sizeof(Jpeg_Src));
+}
+
+static void _jpeg_out_init(j_compress_ptr cinfo)
+{
+    Jpeg_Out *out = (Jpeg_Out *)cinfo->dest;
+    if (!out->buf)
+    {
+        out->bufSize = JPEG_OUT_BLOCK;
+        out->buf = (unsigned char *)malloc(out->bufSize);
+        if (!out->buf)
+            ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+    }
+    out->pub.next_output_byte = out->buf;
+    out->pub.free_in_buffer = out->bufSize;
+}
+
+//缓冲已满: 翻倍扩大, 已写入的数据保持不动
+static boolean _jpeg_out_empty(j_compress_ptr cinfo)
+{
+    Jpeg_Out *out = (Jpeg_Out *)cinfo->dest;
+    unsigned char *buf = (unsigned char *)realloc(out->buf, out->bufSize * 2);
+    if (!buf)
+        ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 1);
+    out->pub.next_output_byte = buf + out->bufSize;
+    out->pub.free_in_buffer = out->bufSize;
+    out->buf = buf;
+    out->bufSize *= 2;
+    return TRUE;
+}
+
+//编码完成: 缓冲交给用户
+static void _jpeg_out_term(j_compress_ptr cinfo)
+{
+    Jpeg_Out *out = (Jpeg_Out *)cinfo->dest;
+    *out->data = out->buf;
+    *out->size = (int)(out->bufSize - out->pub.free_in_buffer);
+    out->buf = NULL;
+}
+
+static void _jpeg_file_init(j_compress_ptr cinfo)
+{
+    Jpeg_Out *out = (Jpeg_Out *)cinfo->dest;
+    out->fileBuf = (JOCTET *)(*cinfo->mem->alloc_small)((j_common_ptr)cinfo, JPOOL_IMAGE, JPEG_OUT_BLOCK);
+    out->pub.next_output_byte = out->fileBuf;
+    out->pub.free_in_buffer = JPEG_OUT_BLOCK;
+}
+
+static boolean _jpeg_file_empty(j_compress_ptr cinfo)
+{
+    Jpeg_Out *out = (Jpeg_Out *)cinfo->dest;
+    if (fwrite(out->fileBuf, 1, JPEG_OUT_BLOCK, out->fp) != JPEG_OUT_BLOCK)
+        ERREXIT(cinfo, JERR_FILE_WRITE);
+    out->pub.next_output_byte = out->fileBuf;
+    out->pub.free_in_buffer = JPEG_OUT_BLOCK;
+    return TRUE;
+}
+
+static void _jpeg_file_term(j_compress_ptr cinfo)
+{
+    Jpeg_Out *out = (Jpeg_Out *)cinfo->dest;
+    size_t count = JPEG_OUT_BLOCK - out->pub.free_in_buffer;
+    if (count > 0 && fwrite(out->fileBuf, 1, count, out->fp) != count)
+        ERREXIT(cinfo, JERR_FILE_WRITE);
+    fflush(out->fp);
+    if (ferror(out->fp))
+        ERREXIT(cinfo, JERR_FILE_WRITE);
+}
+
+//输出目标交给编码器
+static void _jpeg_out_attach(j_compress_ptr cinfo, Jpeg_Out *out)
+{
+    if (out->fp)
+    {
+        out->pub.init_destination = &_jpeg_file_init;
+        out->pub.empty_output_buffer = &_jpeg_file_empty;
+        out->pub.term_destination = &_jpeg_file_term;
+    }
+    else
+    {
+        out->pub.init_destination = &_jpeg_out_init;
+        out->pub.empty_output_buffer = &_jpeg_out_empty;
+        out->pub.term_destination = &_jpeg_out_term;
+    }
+    cinfo->dest = &out->pub;
+}
+
+static void _jpeg_out_mem(Jpeg_Out *out, unsigned char **data, int *size)
+{
+    memset(out, 0, sizeof(Jpeg_Out));
+    out->data = data;
+    out->size = size;
+    *data = NULL;
+    *size = 0;
+}
+
+//打开输出文件, 返回: 0成功 -1失败
+static int _jpeg_out_file(Jpeg_Out *out, const char *outFile)
+{
+    memset(out, 0, sizeof(Jpeg_Out));
+    out->fp = fopen(outFile, "wb");
+    return out->fp ? 0 : -1;
+}
+
+//关闭输出文件, 未完成编码的内存缓冲在此释放
+static void _jpeg_out_close(Jpeg_Out *out)
+{
+    if (out->fp)
+        fclose(out->fp);
+    free(out->buf);
+    out->fp = NULL;
+    out->buf = NULL;
+}
+
+//并行编码时直接写出数据(不经过编码器), 返回: 0成功 -1失败
+static int _jpeg_out_write(Jpeg_Out *out, const void *data, size_t size)
+{
+    unsigned char *buf;
+    size_t bufSize;
+    if (out->fp)
+        return fwrite(data, 1, size, out->fp) == size ? 0 : -1;
+    if (out->used + size > out->bufSize)
+    {
+        for (bufSize = out->bufSize ? out->bufSize : JPEG_OUT_BLOCK; bufSize < out->used + size; bufSize *= 2)
+            ;
+        buf = (unsigned char *)realloc(out->buf, bufSize);
+        if (!buf)
+            return -1;
+        out->buf = buf;
+        out->bufSize = bufSize;
+    }
+    memcpy(out->buf + out->used, data, size);
+    out->used += size;
+    return 0;
+}
+
+//并行编码写完: 内存缓冲交给用户, 文件刷新, 返回: 0成功 -1失败
+static int _jpeg_out_finish(Jpeg_Out *out)
+{
+    if (out->fp)
+        return (fflush(out->fp) == 0 && !ferror(out->fp)) ? 0 : -1;
+    *out->data = out->buf;
+    *out->size = (int)out->used;
+    out->buf = NULL;
+    return 0;
+}
 
 /*
- *  生成 bmp 图片
- *  参数:
- *      outFile: 路径
- *      rgb: 原始数据
- *      width: 宽(像素)
- *      height: 高(像素)
- *      pixelBytes: 每像素字节数
- *      quality: 压缩质量,1~100,越大越好,文件越大
+ *  编码整幅图像(不做统计)
+ *  参数: 同 jpeg_create
+ *      restart: 重启间隔(MCU数), 0不插入重启标记
  *  返回: 0成功 -1失败
  */
-int jpeg_create(char *outFile, unsigned char *rgb, int width, int height, int pixelBytes, int quality)
+static int _jpeg_compress(Jpeg_Out *out, unsigned char *rgb, int width, int height, int pixelBytes, int quality, int restart)
 {
-    FILE *fp;
     int rowSize;
     JSAMPROW jsampRow[1];
-    struct jpeg_error_mgr jerr;
-    struct jpeg_compress_struct cinfo;
+    jmp_buf jump;
+    // 复用本线程的编码器, 出错时跳回这里返回失败
+    Jpeg_Codec *codec = _jpeg_codec_get(1);
+    j_compress_ptr cinfo = &codec->cinfo;
 
-    // 数据流IO准备
-    if ((fp = fopen(outFile, "wb")) == NULL)
+    codec->jerr.jump = &jump;
+    if (setjmp(jump))
     {
-        fprintf(stderr, "jpeg_create: can't open %s\n", outFile);
+        _jpeg_codec_put(codec);
         return -1;
     }
 
-    // Initialize the JPEG decompression object with default error handling.
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_compress(&cinfo);
-
-    // 传递文件流
-    jpeg_stdio_dest(&cinfo, fp);
+    // 传递输出目标
+    _jpeg_out_attach(cinfo, out);
 
     // 压缩参数设置
-    cinfo.image_width = width;
-    cinfo.image_height = height;
-    cinfo.input_components = pixelBytes;
-    cinfo.in_color_space = JCS_RGB; //压缩格式
-    jpeg_set_defaults(&cinfo);
+    cinfo->image_width = width;
+    cinfo->image_height = height;
+    cinfo->input_components = pixelBytes;
+    cinfo->in_color_space = JPEG_COLOR_SPACE(pixelBytes); //压缩格式
+    jpeg_set_defaults(cinfo);
+    cinfo->restart_interval = restart;
 
     // 设置压缩质量0~100,越大、文件越大、处理越久
-    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_set_quality(cinfo, quality, TRUE);
 
     // 开始压缩
-    jpeg_start_compress(&cinfo, TRUE);
+    jpeg_start_compress(cinfo, TRUE);
 
     // 逐行扫描数据
     rowSize = width * pixelBytes;
-    while (cinfo.next_scanline < cinfo.image_height)
+    while (cinfo->next_scanline < cinfo->image_height)
+    {
+        jsampRow[0] = (JSAMPROW)&rgb[(long)cinfo->next_scanline * rowSize];
+        jpeg_write_scanlines(cinfo, jsampRow, 1);
+    }
+
+    jpeg_finish_compress(cinfo);
+    _jpeg_codec_put(codec);
+    return 0;
+}
+
+// -------------------------- 并行编码 --------------------------
+// 输出按MCU行对齐切成水平条带, 每条用各线程自己的编码器独立编成一幅jpeg(重启间隔 = 一条的MCU数),
+// 再拼成一幅: 第一条的文件头(改为整幅高度) + 各条的熵编码数据, 条与条之间插入 RST0~RST7 轮流编号;
+// 重启处DC预测归零、位缓冲补齐到字节, 与独立编码的一条开头完全相同, 拼接结果与单线程按同样重启间隔编码逐字节一致
+
+typedef struct
+{
+    Jpeg_Out *out;
+    int width, height, pixelBytes, quality;
+    int rowSize;
+    int stripRows; // 每条行数(MCU高度的整数倍)
+    int interval;  // 重启间隔: 每条的MCU数
+    int group;     // 每次并行编码的条数(整图模式为全部)
+    int strip;     // 下一个待编码的条序号
+    int rowsDone;  // 已编码行数
+    int error;
+    //行模式: 攒满一组的行缓冲
+    unsigned char *buf;
+    int rows;
+    //当前一组: 第一条的首行, 各条的编码结果
+    unsigned char *base;
+    unsigned char **data;
+    int *size;
+    int *ret;
+} Jpeg_Strips;
+
+/*
+ *  准备并行编码
+ *  参数: 同 jpeg_create
+ *      out: 输出目标
+ *      line: 1/行模式(按组缓冲, 内存与图像高度无关) 0/整图模式
+ *  返回: NULL不适合并行(单核、图像较小、不足两条), 按单线程编码
+ */
+static Jpeg_Strips *_jpeg_strips_open(Jpeg_Out *out, int width, int height, int pixelBytes, int quality, int line)
+{
+    Jpeg_Strips *js;
+    int threads = pool_threads();
+    // jpeg_set_defaults: 灰度一个分量1x1采样, MCU为8x8; YCbCr亮度2x2采样, MCU为16x16
+    int mcu = pixelBytes == 1 ? 8 : 16;
+    int mcuCols = (width + mcu - 1) / mcu;
+    int mcuRows = (height + mcu - 1) / mcu;
+    int stripMcu;
+
+    if (threads < 2 || (pixelBytes != 1 && pixelBytes != 3) ||
+        (long)width * height < JPEG_STRIP_MIN_PIXELS || mcuCols > 65535)
+        return NULL;
+
+    //每条的MCU行数: 整图时再按每线程约4条切分以便均衡; 重启间隔(DRI)最大65535个MCU
+    stripMcu = (JPEG_STRIP_PIXELS + (long)width * mcu - 1) / ((long)width * mcu);
+    if (!line && stripMcu < (mcuRows + threads * 4 - 1) / (threads * 4))
+        stripMcu = (mcuRows + threads * 4 - 1) / (threads * 4);
+    if (stripMcu > 65535 / mcuCols)
+        stripMcu = 65535 / mcuCols;
+    if (stripMcu >= mcuRows)
+        return NULL;
+
+    js = (Jpeg_Strips *)calloc(1, sizeof(Jpeg_Strips));
+    js->out = out;
+    js->width = width;
+    js->height = height;
+    js->pixelBytes = pixelBytes;
+    js->quality = quality;
+    js->rowSize = width * pixelBytes;
+    js->stripRows = stripMcu * mcu;
+    js->interval = stripMcu * mcuCols;
+    js->group = line ? threads : (mcuRows + stripMcu - 1) / stripMcu;
+    js->data = (unsigned char **)calloc(js->group, sizeof(unsigned char *));
+    js->size = (int *)calloc(js->group, sizeof(int));
+    js->ret = (int *)calloc(js->group, sizeof(int));
+    return js;
+}
+
+//线程池任务: 编码当前一组的第i条
+static void _jpeg_strips_task(Jpeg_Strips *js, int i)
+{
+    Jpeg_Out out;
+    int y = (js->strip + i) * js->stripRows;
+    int h = js->height - y < js->stripRows ? js->height - y : js->stripRows;
+    long long tick = zoom_trace_on() ? zoom_stats_now() : 0;
+
+    _jpeg_out_mem(&out, &js->data[i], &js->size[i]);
+    js->ret[i] = _jpeg_compress(&out, js->base + (long)i * js->stripRows * js->rowSize,
+                                js->width, h, js->pixelBytes, js->quality, js->interval);
+    _jpeg_out_close(&out);
+    if (tick)
+        zoom_trace_event("strip", js->strip + i, tick, zoom_stats_now());
+}
+
+/*
+ *  在一条独立编码的jpeg中找到熵编码数据的起点(SOS段之后)
+ *  参数:
+ *      sof: 返回SOF段的位置(改写图像高度用)
+ *  返回: 熵编码数据起点, -1格式不对
+ */
+static int _jpeg_strips_scan(const unsigned char *data, int size, int *sof)
+{
+    int i = 2, len;
+    *sof = -1;
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8 || data[size - 2] != 0xFF || data[size - 1] != 0xD9)
+        return -1;
+    while (i + 4 <= size && data[i] == 0xFF)
+    {
+        len = data[i + 2] << 8 | data[i + 3];
+        if (data[i + 1] == 0xC0)
+            *sof = i;
+        if (data[i + 1] == 0xDA)
+            return (*sof >= 0 && i + 2 + len <= size - 2) ? i + 2 + len : -1;
+        i += 2 + len;
+    }
+    return -1;
+}
+
+//并行编码一组(从 base 开始的 rows 行, 第 js->strip 条起), 按顺序拼接写出
+static void _jpeg_strips_group(Jpeg_Strips *js, unsigned char *base, int rows)
+{
+    unsigned char marker[2] = {0xFF, 0xD0};
+    int n = (rows + js->stripRows - 1) / js->stripRows;
+    int i, k, start, sof;
+
+    if (!js->error)
+    {
+        js->base = base;
+        pool_run((void (*)(void *, int))&_jpeg_strips_task, js, n);
+    }
+    for (i = 0; i < n; i++)
+    {
+        k = js->strip + i;
+        start = -1;
+        if (!js->error && js->ret[i] == 0)
+            start = _jpeg_strips_scan(js->data[i], js->size[i], &sof);
+        if (start < 0)
+            js->error = 1;
+        else if (k == 0)
+        {
+            //文件头取第一条的, 高度改为整幅
+            js->data[i][sof + 5] = js->height >> 8;
+            js->data[i][sof + 6] = js->height & 0xFF;
+            js->error |= _jpeg_out_write(js->out, js->data[i], start);
+        }
+        else
+        {
+            marker[1] = 0xD0 + ((k - 1) & 7);
+            js->error |= _jpeg_out_write(js->out, marker, 2);
+        }
+        //熵编码数据(不含结尾的EOI)
+        if (!js->error)
+            js->error |= _jpeg_out_write(js->out, js->data[i] + start, js->size[i] - start - 2);
+        free(js->data[i]);
+        js->data[i] = NULL;
+    }
+    js->strip += n;
+    js->rowsDone += rows;
+}
+
+/*
+ *  写入行数据, 攒满一组时并行编码(用户数据中已有整组时直接编码, 不拷贝)
+ *  返回: 接收的行数
+ */
+static int _jpeg_strips_write(Jpeg_Strips *js, unsigned char *rgb, int lines)
+{
+    int need, n, count = 0;
+
+    if (lines > js->height - js->rowsDone - js->rows)
+        lines = js->height - js->rowsDone - js->rows;
+    while (count < lines)
+    {
+        //下一组的行数
+        need = js->group * js->stripRows;
+        if (need > js->height - js->rowsDone)
+            need = js->height - js->rowsDone;
+        if (js->rows == 0 && lines - count >= need)
+        {
+            _jpeg_strips_group(js, &rgb[(long)count * js->rowSize], need);
+            count += need;
+            continue;
+        }
+        if (!js->buf)
+            js->buf = (unsigned char *)malloc((long)js->group * js->stripRows * js->rowSize);
+        n = need - js->rows < lines - count ? need - js->rows : lines - count;
+        memcpy(&js->buf[(long)js->rows * js->rowSize], &rgb[(long)count * js->rowSize], (long)n * js->rowSize);
+        js->rows += n;
+        count += n;
+        if (js->rows == need)
+        {
+            _jpeg_strips_group(js, js->buf, need);
+            js->rows = 0;
+        }
+    }
+    return count;
+}
+
+//结束并行编码并释放, 返回: 0成功 -1失败(出错或行数不足)
+static int _jpeg_strips_close(Jpeg_Strips *js)
+{
+    unsigned char eoi[2] = {0xFF, 0xD9};
+    int ret = -1;
+
+    if (!js->error && js->rowsDone == js->height &&
+        _jpeg_out_write(js->out, eoi, 2) == 0)
+        ret = _jpeg_out_finish(js->out);
+    free(js->buf);
+    free(js->data);
+    free(js->size);
+    free(js->ret);
+    free(js);
+    return ret;
+}
+
+// -------------------------- 并行解码 --------------------------
+// 带重启标记(DRI/RSTn)的基线jpeg: 各重启段的熵编码数据互相独立(DC预测在段首归零), 按MCU行对齐切成水平条带,
+// 每条取出自己的几段, 配上文件头(高度改为条带高度)、段间重新从RST0编号, 拼成一幅独立的jpeg交给各线程的解码器,
+// 直接解码到输出缓冲; 色度垂直上采样要用到上下相邻的行, 此时每条多解码前后各一段MCU行再丢弃, 结果与单线程解码相同
+
+typedef struct
+{
+    const unsigned char *data; // 源数据
+    unsigned char *head;       // 解码用的文件头(去掉了与解码无关的APPn、COM段)
+    int headSize, sof;
+    int *seg;                  // 各重启段熵编码数据的起点, seg[segs]为结束标记EOI之后
+    int segs;
+    int interval;              // 重启间隔(MCU数)
+    int mcuCols, mcuRows;
+    int mcuHeight;             // 一个MCU行的源图像行数
+    int imageHeight;           // 源图像高度
+    int step;                  // 条带边界对齐的MCU行数(重启段边界与MCU行边界重合处)
+    int context;               // 1/垂直上采样需要相邻MCU行
+    unsigned int scaleNum, scaleDenom;
+    int width, height, pixelBytes, rowSize;
+    int stripMcu;              // 每条MCU行数
+    int stripRows;             // 每条输出行数
+    int group;                 // 每次并行解码的条数(整图模式为全部)
+    int strip;                 // 下一个待解码的条序号
+    int rowsDone;              // 已交出的行数
+    int error;
+    //行模式: 已解码一组的缓冲, 其中 rows 行有效, 已交出 pos 行
+    unsigned char *buf;
+    int rows, pos;
+    //当前一组: 第一条的首行, 各条的结果
+    unsigned char *base;
+    int *ret;
+} Jpeg_Restart;
+
+static int _jpeg_gcd(int a, int b)
+{
+    int t;
+    while (b)
+    {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+ *  准备并行解码, 在 jpeg_read_header、_jpeg_scale 之后, jpeg_start_decompress 之前调用
+ *  参数:
+ *      src: 输入数据(须整块在内存中)
+ *      dinfo: 已读完文件头的解码器, 成功时其 output_width 等输出参数已算好, 不要再 jpeg_start_decompress
+ *      line: 1/行模式(按组缓冲, 内存与图像高度无关) 0/整图模式
+ *  返回: NULL不适合并行(单核、图像较小、没有重启标记、渐进式等), 按单线程解码
+ */
+static Jpeg_Restart *_jpeg_restart_open(Jpeg_Src *src, j_decompress_ptr dinfo, int line)
+{
+    Jpeg_Restart *jr;
+    const unsigned char *data = src->data;
+    const unsigned char *p, *end = src->data + src->size;
+    int threads = pool_threads();
+    int mcu = dinfo->max_v_samp_factor * DCTSIZE;
+    int mcuCols = (dinfo->image_width + dinfo->max_h_samp_factor * DCTSIZE - 1) / (dinfo->max_h_samp_factor * DCTSIZE);
+    int mcuRows = (dinfo->image_height + mcu - 1) / mcu;
+    int interval = dinfo->restart_interval;
+    int i, k, len, marker, head = -1, sof = -1, segs, step, context = 0, stripMcu, parts;
+
+    //单扫描的霍夫曼基线/扩展顺序式, 所有分量交织在一次扫描中(单分量时须为1x1采样)
+    if (threads < 2 || interval == 0 || dinfo->progressive_mode || dinfo->arith_code ||
+        dinfo->comps_in_scan != dinfo->num_components ||
+        (dinfo->num_components == 1 && dinfo->max_v_samp_factor * dinfo->max_h_samp_factor != 1) ||
+        (long)dinfo->image_width * dinfo->image_height < JPEG_STRIP_MIN_PIXELS)
+        return NULL;
+
+    //DCT缩放后一个MCU行的输出行数须为整数
+    jpeg_calc_output_dimensions(dinfo);
+    if (_jpeg_imcu_rows(dinfo) * dinfo->scale_denom != mcu * dinfo->scale_num)
+        return NULL;
+    for (i = 0; i < dinfo->num_components; i++)
+    {
+        if (dinfo->comp_info[i].v_samp_factor != dinfo->max_v_samp_factor)
+            context = dinfo->do_fancy_upsampling;
+    }
+
+    //条带大小: 不少于 JPEG_STRIP_PIXELS 源像素, 整图时再按线程切分(要多解码相邻行时每线程一条, 否则约4条以便均衡);
+    //要多解码相邻行时每条至少8段, 多解码的部分不超过四分之一
+    step = interval / _jpeg_gcd(interval, mcuCols);
+    stripMcu = (JPEG_STRIP_PIXELS + (long)dinfo->image_width * mcu - 1) / ((long)dinfo->image_width * mcu);
+    parts = context ? threads : threads * 4;
+    if (!line && stripMcu < (mcuRows + parts - 1) / parts)
+        stripMcu = (mcuRows + parts - 1) / parts;
+    if (context && stripMcu < step * 8)
+        stripMcu = step * 8;
+    stripMcu = (stripMcu + step - 1) / step * step;
+    if (stripMcu >= mcuRows)
+        return NULL;
+
+    //文件头: 找到SOF和SOS段, SOS段之后为熵编码数据
+    if (src->size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return NULL;
+    for (i = 2; i + 4 <= (int)src->size && data[i] == 0xFF; i += 2 + len)
+    {
+        marker = data[i + 1];
+        if (marker == 0xFF)
+        {
+            len = -1; //填充字节
+            continue;
+        }
+        len = data[i + 2] << 8 | data[i + 3];
+        if (marker == 0xC0 || marker == 0xC1)
+            sof = i;
+        if (marker == 0xDA)
+        {
+            head = i + 2 + len;
+            break;
+        }
+    }
+    if (sof < 0 || head < 0 || head >= (int)src->size)
+        return NULL;
+
+    //熵编码数据: 逐个找出重启标记(0xFF00为填充的0xFF数据, 0xFFFF为填充字节), 编号须依次为RST0~RST7轮流, 最后为EOI
+    segs = (int)(((long)mcuCols * mcuRows + interval - 1) / interval);
+    jr = (Jpeg_Restart *)calloc(1, sizeof(Jpeg_Restart));
+    jr->seg = (int *)malloc((segs + 1) * sizeof(int));
+    jr->seg[0] = head;
+    k = 1;
+    for (p = data + head; (p = (const unsigned char *)memchr(p, 0xFF, end - p)) && p + 1 < end;)
+    {
+        if (p[1] == 0x00)
+            p += 2;
+        else if (p[1] == 0xFF)
+            p += 1;
+        else if (p[1] >= 0xD0 && p[1] <= 0xD7 && k < segs && p[1] == 0xD0 + ((k - 1) & 7))
+        {
+            jr->seg[k++] = p + 2 - data;
+            p += 2;
+        }
+        else
+            break;
+    }
+    if (!p || p + 1 >= end || p[1] != 0xD9 || k != segs)
+    {
+        free(jr->seg);
+        free(jr);
+        return NULL;
+    }
+    jr->seg[segs] = p + 2 - data;
+
+    //解码用的文件头: 只留下解码需要的段
+    jr->head = (unsigned char *)malloc(head);
+    jr->head[0] = 0xFF;
+    jr->head[1] = 0xD8;
+    jr->headSize = 2;
+    for (i = 2; i < head; i += 2 + len)
+    {
+        marker = data[i + 1];
+        if (marker == 0xFF)
+        {
+            len = -1;
+            continue;
+        }
+        len = data[i + 2] << 8 | data[i + 3];
+        if ((marker >= 0xE1 && marker <= 0xED) || marker == 0xEF || marker == 0xFE)
+            continue;
+        if (i == sof)
+            jr->sof = jr->headSize;
+        memcpy(&jr->head[jr->headSize], &data[i], 2 + len);
+        jr->headSize += 2 + len;
+    }
+
+    jr->data = data;
+    jr->segs = segs;
+    jr->interval = interval;
+    jr->mcuCols = mcuCols;
+    jr->mcuRows = mcuRows;
+    jr->mcuHeight = mcu;
+    jr->imageHeight = dinfo->image_height;
+    jr->step = step;
+    jr->context = context;
+    jr->scaleNum = dinfo->scale_num;
+    jr->scaleDenom = dinfo->scale_denom;
+    jr->width = dinfo->output_width;
+    jr->height = dinfo->output_height;
+    jr->pixelBytes = dinfo->output_components;
+    jr->rowSize = jr->width * jr->pixelBytes;
+    jr->stripMcu = stripMcu;
+    jr->stripRows = stripMcu * _jpeg_imcu_rows(dinfo);
+    jr->group = line ? threads : (mcuRows + stripMcu - 1) / stripMcu;
+    jr->ret = (int *)calloc(jr->group, sizeof(int));
+    return jr;
+}
+
+/*
+ *  解码拼好的一条
+ *  参数:
+ *      skip: 开头丢弃的行数(上方相邻的MCU行)
+ *      rgb, rows: 之后的 rows 行解码到这里
+ *  返回: 0成功 -1失败
+ */
+static int _jpeg_restart_decode(Jpeg_Restart *jr, const unsigned char *data, int size, int skip, unsigned char *rgb, int rows)
+{
+    Jpeg_Src src;
+    JSAMPROW jsampRow[JPEG_ROWS_MAX];
+    jmp_buf jump;
+    int i, n, ret, count;
+    // 复用本线程的解码器, 出错时跳回这里返回失败
+    Jpeg_Codec *codec = _jpeg_codec_get(0);
+    j_decompress_ptr dinfo = &codec->dinfo;
+
+    codec->jerr.jump = &jump;
+    if (setjmp(jump))
+    {
+        _jpeg_codec_put(codec);
+        return -1;
+    }
+
+    _jpeg_src_mem(&src, data, size);
+    _jpeg_src_attach(dinfo, &src);
+    if (jpeg_read_header(dinfo, TRUE) != JPEG_HEADER_OK)
+    {
+        _jpeg_codec_put(codec);
+        return -1;
+    }
+    dinfo->scale_num = jr->scaleNum;
+    dinfo->scale_denom = jr->scaleDenom;
+    if (jpeg_start_decompress(dinfo) == FALSE ||
+        (int)dinfo->output_width != jr->width || (int)dinfo->output_components != jr->pixelBytes ||
+        (int)dinfo->output_height < skip + rows)
+    {
+        _jpeg_codec_put(codec);
+        return -1;
+    }
+
+    // 丢弃上方相邻的行
+    if (skip > 0)
+    {
+        jsampRow[0] = (JSAMPROW)(*dinfo->mem->alloc_small)((j_common_ptr)dinfo, JPOOL_IMAGE, jr->rowSize);
+        while ((int)dinfo->output_scanline < skip)
+            jpeg_read_scanlines(dinfo, jsampRow, 1);
+    }
+    // 直接解码到输出缓冲
+    for (count = 0; count < rows; count += ret)
+    {
+        n = rows - count < JPEG_ROWS_MAX ? rows - count : JPEG_ROWS_MAX;
+        for (i = 0; i < n; i++)
+            jsampRow[i] = (JSAMPROW)&rgb[(long)(count + i) * jr->rowSize];
+        ret = jpeg_read_scanlines(dinfo, jsampRow, n);
+        if (ret < 1)
+            break;
+    }
+
+    // 下方相邻的行不用读, 由 jpeg_abort 中止
+    _jpeg_codec_put(codec);
+    return count == rows ? 0 : -1;
+}
+
+//线程池任务: 解码当前一组的第i条
+static void _jpeg_restart_task(Jpeg_Restart *jr, int i)
+{
+    int strip = jr->strip + i;
+    int r0 = strip * jr->stripMcu;
+    int r1 = r0 + jr->stripMcu < jr->mcuRows ? r0 + jr->stripMcu : jr->mcuRows;
+    int rows = jr->height - strip * jr->stripRows < jr->stripRows ? jr->height - strip * jr->stripRows : jr->stripRows;
+    // 实际解码的MCU行范围 c0~c1 及其重启段 k0~k1
+    int c0 = jr->context && r0 > 0 ? r0 - jr->step : r0;
+    int c1 = jr->context && r1 < jr->mcuRows ? r1 + jr->step : r1;
+    int k0, k1, k, n, size, height;
+    unsigned char *buf, *p;
+    long long tick = zoom_trace_on() ? zoom_stats_now() : 0;
+
+    if (c1 > jr->mcuRows)
+        c1 = jr->mcuRows;
+    k0 = (int)((long)c0 * jr->mcuCols / jr->interval);
+    k1 = c1 == jr->mcuRows ? jr->segs : (int)((long)c1 * jr->mcuCols / jr->interval);
+
+    //拼成独立的一幅: 文件头(高度改为这一条) + 各段数据, 段间重启标记从RST0重新编号, 最后EOI
+    size = jr->headSize + jr->seg[k1] - jr->seg[k0];
+    buf = (unsigned char *)malloc(size);
+    if (!buf)
+    {
+        jr->ret[i] = -1;
+        return;
+    }
+    memcpy(buf, jr->head, jr->headSize);
+    height = (c1 < jr->mcuRows ? c1 * jr->mcuHeight : jr->imageHeight) - c0 * jr->mcuHeight;
+    p = buf + jr->headSize;
+    for (k = k0; k < k1; k++)
+    {
+        n = jr->seg[k + 1] - 2 - jr->seg[k];
+        memcpy(p, jr->data + jr->seg[k], n);
+        p += n;
+        *p++ = 0xFF;
+        *p++ = k + 1 < k1 ? 0xD0 + ((k - k0) & 7) : 0xD9;
+    }
+    buf[jr->sof + 5] = height >> 8;
+    buf[jr->sof + 6] = height & 0xFF;
+
+    jr->ret[i] = _jpeg_restart_decode(jr, buf, size, (r0 - c0) * (jr->stripRows / jr->stripMcu),
+                                      jr->base + (long)i * jr->stripRows * jr->rowSize, rows);
+    free(buf);
+    if (tick)
+        zoom_trace_event("decode strip", strip, tick, zoom_stats_now());
+}
+
+//并行解码一组(第 jr->strip 条起, 共 rows 行)到 base, 返回: 0成功 -1失败
+static int _jpeg_restart_group(Jpeg_Restart *jr, unsigned char *base, int rows)
+{
+    int n = (rows + jr->stripRows - 1) / jr->stripRows;
+    int i;
+
+    jr->base = base;
+    pool_run((void (*)(void *, int))&_jpeg_restart_task, jr, n);
+    for (i = 0; i < n; i++)
+    {
+        if (jr->ret[i] != 0)
+            jr->error = 1;
+    }
+    jr->strip += n;
+    return jr->error ? -1 : 0;
+}
+
+/*
+ *  读取行数据, 缓冲读完时并行解码下一组(用户缓冲能装下整组时直接解码进去, 不拷贝)
+ *  返回: 读出的行数, 出错时停止(数据损坏等)
+ */
+static int _jpeg_restart_read(Jpeg_Restart *jr, unsigned char *rgb, int lines)
+{
+    int need, n, count = 0;
+
+    if (lines > jr->height - jr->rowsDone)
+        lines = jr->height - jr->rowsDone;
+    while (count < lines && !jr->error)
+    {
+        //先交出缓冲中已解码的行
+        if (jr->pos < jr->rows)
+        {
+            n = jr->rows - jr->pos < lines - count ? jr->rows - jr->pos : lines - count;
+            memcpy(&rgb[(long)count * jr->rowSize], &jr->buf[(long)jr->pos * jr->rowSize], (long)n * jr->rowSize);
+            jr->pos += n;
+            jr->rowsDone += n;
+            count += n;
+            continue;
+        }
+        //下一组的行数
+        need = jr->group * jr->stripRows;
+        if (need > jr->height - jr->strip * jr->stripRows)
+            need = jr->height - jr->strip * jr->stripRows;
+        if (lines - count >= need)
+        {
+            if (_jpeg_restart_group(jr, &rgb[(long)count * jr->rowSize], need) == 0)
+            {
+                jr->rowsDone += need;
+                count += need;
+            }
+            continue;
+        }
+        if (!jr->buf)
+            jr->buf = (unsigned char *)malloc((long)jr->group * jr->stripRows * jr->rowSize);
+        if (!jr->buf || _jpeg_restart_group(jr, jr->buf, need) != 0)
+            jr->error = 1;
+        else
+        {
+            jr->rows = need;
+            jr->pos = 0;
+        }
+    }
+    return count;
+}
+
+static void _jpeg_restart_close(Jpeg_Restart *jr)
+{
+    free(jr->head);
+    free(jr->seg);
+    free(jr->buf);
+    free(jr->ret);
+    free(jr);
+}
+
+typedef struct
+{
+    Jpeg_Src src; // 读: 输入数据
+    Jpeg_Out out; // 写: 输出目标
+    int open;     // 编解码进行中(行数据还没处理完)
+    int rw;       // 读写标志: 0/读 1/写
+    int rowCount; // 当前已处理行计数
+    int rowMax;   // rowCount计数目标
+    int rowSize;
+    Jpeg_Codec *codec;     // 编解码器(写时用cinfo, 读时用dinfo)
+    Jpeg_Strips *strips;   // 写: 并行编码(不用codec), NULL为单线程编码
+    Jpeg_Restart *restart; // 读: 并行解码(codec只读了文件头), NULL为单线程解码
+} Jpeg_Private;
+
+/*
+ *  生成 bmp 图片
+ *  参数:
+ *      outFile: 路径
+ *      rgb: 原始数据
+ *      width: 宽(像素)
+ *      height: 高(像素)
+ *      pixelBytes: 每像素字节数
+ *      quality: 压缩质量,1~100,越大越好,文件越大
+ *  返回: 0成功 -1失败
+ */
+static int _jpeg_createTo(Jpeg_Out *out, unsigned char *rgb, int width, int height, int pixelBytes, int quality)
+{
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+    // 大图多核时按条带并行编码
+    Jpeg_Strips *js = _jpeg_strips_open(out, width, height, pixelBytes, quality, 0);
+    int threads = js ? pool_threads() : 1;
+    int ret;
+
+    if (js)
     {
-        jsampRow[0] = (JSAMPROW)&rgb[cinfo.next_scanline * rowSize];
-        jpeg_write_scanlines(&cinfo, jsampRow, 1);
+        _jpeg_strips_write(js, rgb, height);
+        ret = _jpeg_strips_close(js);
     }
+    else
+        ret = _jpeg_compress(out, rgb, width, height, pixelBytes, quality, 0);
+    if (ret != 0)
+        return -1;
 
-    jpeg_finish_compress(&cinfo);
-    jpeg_destroy_compress(&cinfo);
-    fclose(fp);
+    zoom_stats_stage(stats, ZS_ENCODE, tick);
+    zoom_stats_rows(stats, 0, height);
+    zoom_stats_threads(stats, threads);
     return 0;
 }
 
+int jpeg_create(char *outFile, unsigned char *rgb, int width, int height, int pixelBytes, int quality)
+{
+    Jpeg_Out out;
+    int ret;
+
+    // 数据流IO准备
+    if (_jpeg_out_file(&out, outFile) != 0)
+    {
+        fprintf(stderr, "jpeg_create: can't open %s\n", outFile);
+        return -1;
+    }
+    ret = _jpeg_createTo(&out, rgb, width, height, pixelBytes, quality);
+    _jpeg_out_close(&out);
+    return ret;
+}
+
+/*
+ *  生成 jpeg 图片数据到内存
+ *  参数: 同 jpeg_create
+ *      jpg: 返回jpeg数据指针 !! 用完记得free()释放 !!
+ *      jpgSize: 返回jpeg数据字节数
+ *  返回: 0成功 -1失败
+ */
+int jpeg_createMem(unsigned char **jpg, int *jpgSize, unsigned char *rgb, int width, int height, int pixelBytes, int quality)
+{
+    Jpeg_Out out;
+    int ret;
+
+    if (!jpg || !jpgSize)
+        return -1;
+    _jpeg_out_mem(&out, jpg, jpgSize);
+    ret = _jpeg_createTo(&out, rgb, width, height, pixelBytes, quality);
+    _jpeg_out_close(&out);
+    return ret;
+}
+
 /*
  *  行处理模式
  *  参数: 同上
  *  返回: 行处理指针,NULL失败
  */
-Jpeg_Private *jpeg_createLine(char *outFile, int width, int height, int pixelBytes, int quality)
+static Jpeg_Private *_jpeg_createLineTo(Jpeg_Private *jp, int width, int height, int pixelBytes, int quality)
 {
-    Jpeg_Private *jp = (Jpeg_Private *)calloc(1, sizeof(Jpeg_Private));
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+    jmp_buf jump;
 
-    // 数据流IO准备
-    if ((jp->fp = fopen(outFile, "wb")) == NULL)
+    jp->rowMax = height;
+    jp->rowSize = width * pixelBytes;
+    jp->rw = 1;
+    jp->open = 1;
+
+    // 大图多核时按条带并行编码, 攒满一组条带(每线程一条)编码一次
+    jp->strips = _jpeg_strips_open(&jp->out, width, height, pixelBytes, quality, 1);
+    if (jp->strips)
     {
-        fprintf(stderr, "jpeg_createLine: can't open %s\n", outFile);
+        zoom_stats_threads(stats, pool_threads());
+        return jp;
+    }
+
+    // 复用本线程的编码器, 出错时跳回这里返回失败
+    jp->codec = _jpeg_codec_get(1);
+    jp->codec->jerr.jump = &jump;
+    if (setjmp(jump))
+    {
+        _jpeg_codec_put(jp->codec);
+        _jpeg_out_close(&jp->out);
         free(jp);
         return NULL;
     }
 
-    // Initialize the JPEG decompression object with default error handling.
-    jp->cinfo.err = jpeg_std_error(&jp->jerr);
-    jpeg_create_compress(&jp->cinfo);
-
-    // 传递文件流
-    jpeg_stdio_dest(&jp->cinfo, jp->fp);
+    // 传递输出目标
+    _jpeg_out_attach(&jp->codec->cinfo, &jp->out);
 
     // 压缩参数设置
-    jp->cinfo.image_width = width;
-    jp->cinfo.image_height = height;
-    jp->cinfo.input_components = pixelBytes;
-    jp->cinfo.in_color_space = JCS_RGB; //压缩格式
-    jpeg_set_defaults(&jp->cinfo);
+    jp->codec->cinfo.image_width = width;
+    jp->codec->cinfo.image_height = height;
+    jp->codec->cinfo.input_components = pixelBytes;
+    jp->codec->cinfo.in_color_space = JPEG_COLOR_SPACE(pixelBytes); //压缩格式
+    jpeg_set_defaults(&jp->codec->cinfo);
 
     // 设置压缩质量0~100,越大、文件越大、处理越久
-    jpeg_set_quality(&jp->cinfo, quality, TRUE);
+    jpeg_set_quality(&jp->codec->cinfo, quality, TRUE);
 
     // 开始压缩
-    jpeg_start_compress(&jp->cinfo, TRUE);
+    jpeg_start_compress(&jp->codec->cinfo, TRUE);
+    jp->codec->jerr.jump = NULL;
 
-    jp->rowMax = height;
-    jp->rowSize = width * pixelBytes;
-
-    // 写标志
-    jp->rw = 1;
+    zoom_stats_stage(stats, ZS_ENCODE, tick);
+    zoom_stats_threads(stats, 1);
     return jp;
 }
 
+Jpeg_Private *jpeg_createLine(char *outFile, int width, int height, int pixelBytes, int quality)
+{
+    Jpeg_Private *jp = (Jpeg_Private *)calloc(1, sizeof(Jpeg_Private));
+
+    // 数据流IO准备
+    if (_jpeg_out_file(&jp->out, outFile) != 0)
+    {
+        fprintf(stderr, "jpeg_createLine: can't open %s\n", outFile);
+        free(jp);
+        return NULL;
+    }
+    return _jpeg_createLineTo(jp, width, height, pixelBytes, quality);
+}
+
+/*
+ *  行处理模式(输出到内存)
+ *  参数: 同 jpeg_createMem, jpg、jpgSize 在写完最后一行(或 jpeg_closeLine)时返回
+ *  返回: 行处理指针,NULL失败
+ */
+Jpeg_Private *jpeg_createLineMem(unsigned char **jpg, int *jpgSize, int width, int height, int pixelBytes, int quality)
+{
+    Jpeg_Private *jp;
+
+    if (!jpg || !jpgSize)
+        return NULL;
+    jp = (Jpeg_Private *)calloc(1, sizeof(Jpeg_Private));
+    _jpeg_out_mem(&jp->out, jpg, jpgSize);
+    return _jpeg_createLineTo(jp, width, height, pixelBytes, quality);
+}
+
 /*
  *  bmp 图片数据获取
  *  参数:
@@ -133,194 +1422,368 @@ Jpeg_Private *jpeg_createLine(char *outFile, int width, int height, int pixelByt
  *      width: 返回图片宽(像素), 不接收置NULL
  *      height: 返回图片高(像素), 不接收置NULL
  *      pixelBytes: 返回图片每像素的字节数, 不接收置NULL
+ *      zm: 传入之后要缩放的倍数, 缩小时按DCT缩放解码, 返回解码后还需缩放的倍数; 按原尺寸解码置NULL
  * 
  *  返回: 图片数据指针, 已分配内存, 用完记得释放
  */
-unsigned char *jpeg_get(char *inFile, int *width, int *height, int *pixelBytes)
+static unsigned char *_jpeg_getFrom(Jpeg_Src *src, int *width, int *height, int *pixelBytes, float *zm)
 {
-    FILE *fp;
-    int offset, rowSize;
-    unsigned char *retRgb;
+    int offset, rowSize, rows;
+    unsigned char *volatile retRgb = NULL;
     JSAMPROW jsampRow[1];
-    struct jpeg_error_mgr jerr;
-    struct jpeg_decompress_struct dinfo;
-
-    // 数据流IO准备
-    if ((fp = fopen(inFile, "rb")) == NULL)
+    jmp_buf jump;
+    Jpeg_Restart *jr;
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+    // 复用本线程的解码器, 出错时跳回这里返回失败
+    Jpeg_Codec *codec = _jpeg_codec_get(0);
+    j_decompress_ptr dinfo = &codec->dinfo;
+
+    codec->jerr.jump = &jump;
+    if (setjmp(jump))
     {
-        fprintf(stderr, "jpeg_get: can't open %s\n", inFile);
+        _jpeg_codec_put(codec);
+        free(retRgb);
         return NULL;
     }
 
-    // Initialize the JPEG decompression object with default error handling.
-    dinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_decompress(&dinfo);
-
-    // 传递文件流
-    jpeg_stdio_src(&dinfo, fp);
+    // 传递输入数据
+    _jpeg_src_attach(dinfo, src);
     // 解析文件头
-    if (jpeg_read_header(&dinfo, FALSE) != JPEG_HEADER_OK)
+    if (jpeg_read_header(dinfo, FALSE) != JPEG_HEADER_OK)
     {
         //失败
         fprintf(stderr, "jpeg_get: jpeg_read_header failed \r\n");
-        jpeg_destroy_decompress(&dinfo);
-        fclose(fp);
+        _jpeg_codec_put(codec);
         return NULL;
     }
+    // 缩小时直接解码到较小尺寸
+    if (zm && *zm > 0)
+        *zm *= _jpeg_scale(dinfo, *zm);
+    // 有重启标记的大图多核时按条带并行解码
+    jr = _jpeg_restart_open(src, dinfo, 0);
+    if (jr)
+    {
+        if (width)
+            *width = jr->width;
+        if (height)
+            *height = jr->height;
+        if (pixelBytes)
+            *pixelBytes = jr->pixelBytes;
+        retRgb = (unsigned char *)calloc((long)jr->height * jr->rowSize + 1, 1);
+        zoom_stats_bytes(stats, (long)jr->height * jr->rowSize + 1);
+        rows = _jpeg_restart_read(jr, retRgb, jr->height);
+        _jpeg_restart_close(jr);
+        if (rows == (int)dinfo->output_height)
+        {
+            zoom_stats_rows(stats, rows, 0);
+            _jpeg_codec_put(codec);
+            zoom_stats_stage(stats, ZS_DECODE, tick);
+            zoom_stats_threads(stats, pool_threads());
+            return retRgb;
+        }
+        // 失败(数据有误等)时按单线程重新解码
+        free(retRgb);
+        retRgb = NULL;
+    }
     // 开始解压
-    if (jpeg_start_decompress(&dinfo) == FALSE)
+    if (jpeg_start_decompress(dinfo) == FALSE)
     {
         //失败
         fprintf(stderr, "jpeg_get: jpeg_start_decompress failed \r\n");
-        jpeg_finish_decompress(&dinfo);
-        jpeg_destroy_decompress(&dinfo);
-        fclose(fp);
+        _jpeg_codec_put(codec);
         return NULL;
     }
 
     // 得到图片基本参数
     if (width)
-        *width = dinfo.output_width;
+        *width = dinfo->output_width;
     if (height)
-        *height = dinfo.output_height;
+        *height = dinfo->output_height;
     if (pixelBytes)
-        *pixelBytes = dinfo.output_components;
+        *pixelBytes = dinfo->output_components;
 
     // 计算图片RGB数据大小,并分配内存
     retRgb = (unsigned char *)calloc(
-        dinfo.output_width * dinfo.output_height * dinfo.output_components + 1, 1);
+        dinfo->output_width * dinfo->output_height * dinfo->output_components + 1, 1);
+    zoom_stats_bytes(stats, dinfo->output_width * dinfo->output_height * dinfo->output_components + 1);
 
     // Process data
     offset = 0;
-    rowSize = dinfo.output_width * dinfo.output_components;
+    rowSize = dinfo->output_width * dinfo->output_components;
 
     // 按行读取解压数据
-    while (dinfo.output_scanline < dinfo.output_height)
+    while (dinfo->output_scanline < dinfo->output_height)
     {
         jsampRow[0] = (JSAMPROW)&retRgb[offset];
-        jpeg_read_scanlines(&dinfo, jsampRow, 1); //读取一行数据
+        jpeg_read_scanlines(dinfo, jsampRow, 1); //读取一行数据
         offset += rowSize;
     }
 
-    jpeg_finish_decompress(&dinfo);
-    jpeg_destroy_decompress(&dinfo);
-    fclose(fp);
+    jpeg_finish_decompress(dinfo);
+    zoom_stats_rows(stats, dinfo->output_height, 0);
+    _jpeg_codec_put(codec);
+    zoom_stats_stage(stats, ZS_DECODE, tick);
+    zoom_stats_threads(stats, 1);
     return retRgb;
 }
 
+unsigned char *jpeg_get(char *inFile, int *width, int *height, int *pixelBytes, float *zm)
+{
+    Jpeg_Src src;
+    unsigned char *retRgb;
+
+    // 数据流IO准备
+    if (_jpeg_src_file(&src, inFile) != 0)
+    {
+        fprintf(stderr, "jpeg_get: can't open %s\n", inFile);
+        return NULL;
+    }
+    retRgb = _jpeg_getFrom(&src, width, height, pixelBytes, zm);
+    _jpeg_src_close(&src);
+    return retRgb;
+}
+
+/*
+ *  内存中的 jpeg 图片数据获取
+ *  参数: 同 jpeg_get
+ *      jpg, jpgSize: jpeg数据及字节数
+ *  返回: 图片数据指针, 已分配内存, 用完记得释放
+ */
+unsigned char *jpeg_getMem(const unsigned char *jpg, int jpgSize, int *width, int *height, int *pixelBytes, float *zm)
+{
+    Jpeg_Src src;
+
+    if (!jpg || jpgSize < 1)
+        return NULL;
+    _jpeg_src_mem(&src, jpg, jpgSize);
+    return _jpeg_getFrom(&src, width, height, pixelBytes, zm);
+}
+
 /*
  *  行处理模式
  *  参数: 同上
  *  返回: 行处理指针,NULL失败
  */
-Jpeg_Private *jpeg_getLine(char *inFile, int *width, int *height, int *pixelBytes)
+static Jpeg_Private *_jpeg_getLineFrom(Jpeg_Private *jp, int *width, int *height, int *pixelBytes, float *zm)
 {
-    Jpeg_Private *jp = (Jpeg_Private *)calloc(1, sizeof(Jpeg_Private));
-
-    // 数据流IO准备
-    if ((jp->fp = fopen(inFile, "rb")) == NULL)
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+    jmp_buf jump;
+
+    // 复用本线程的解码器, 出错时跳回这里返回失败
+    jp->codec = _jpeg_codec_get(0);
+    jp->codec->jerr.jump = &jump;
+    if (setjmp(jump))
     {
-        fprintf(stderr, "jpeg_getLine: can't open %s\n", inFile);
+        if (jp->restart)
+            _jpeg_restart_close(jp->restart);
+        _jpeg_codec_put(jp->codec);
+        _jpeg_src_close(&jp->src);
         free(jp);
         return NULL;
     }
 
-    // Initialize the JPEG decompression object with default error handling.
-    jp->dinfo.err = jpeg_std_error(&jp->jerr);
-    jpeg_create_decompress(&jp->dinfo);
-
-    // 传递文件流
-    jpeg_stdio_src(&jp->dinfo, jp->fp);
+    // 传递输入数据
+    _jpeg_src_attach(&jp->codec->dinfo, &jp->src);
     // 解析文件头
-    if (jpeg_read_header(&jp->dinfo, TRUE) != JPEG_HEADER_OK)
+    if (jpeg_read_header(&jp->codec->dinfo, TRUE) != JPEG_HEADER_OK)
     {
         //失败
         fprintf(stderr, "jpeg_getLine: jpeg_read_header failed \r\n");
-        jpeg_destroy_decompress(&jp->dinfo);
-        fclose(jp->fp);
+        _jpeg_codec_put(jp->codec);
+        _jpeg_src_close(&jp->src);
         free(jp);
         return NULL;
     }
-    // 开始解压
-    if (jpeg_start_decompress(&jp->dinfo) == FALSE)
+    // 缩小时直接解码到较小尺寸
+    if (zm && *zm > 0)
+        *zm *= _jpeg_scale(&jp->codec->dinfo, *zm);
+    // 有重启标记的大图多核时按条带并行解码, 否则开始解压
+    jp->restart = _jpeg_restart_open(&jp->src, &jp->codec->dinfo, 1);
+    if (!jp->restart && jpeg_start_decompress(&jp->codec->dinfo) == FALSE)
     {
         //失败
         fprintf(stderr, "jpeg_getLine: jpeg_start_decompress failed \r\n");
-        jpeg_finish_decompress(&jp->dinfo);
-        jpeg_destroy_decompress(&jp->dinfo);
-        fclose(jp->fp);
+        _jpeg_codec_put(jp->codec);
+        _jpeg_src_close(&jp->src);
+        free(jp);
+        return NULL;
+    }
+
+    jp->rowMax = jp->codec->dinfo.output_height;
+    jp->rowSize = jp->codec->dinfo.output_width * jp->codec->dinfo.output_components;
+
+    if (width)
+        *width = jp->codec->dinfo.output_width;
+    if (height)
+        *height = jp->codec->dinfo.output_height;
+    if (pixelBytes)
+        *pixelBytes = jp->codec->dinfo.output_components;
+
+    // 之后的出错由每次 jpeg_line 各自设置跳转点
+    jp->codec->jerr.jump = NULL;
+    jp->open = 1;
+    zoom_stats_stage(stats, ZS_DECODE, tick);
+    zoom_stats_threads(stats, jp->restart ? pool_threads() : 1);
+    return jp;
+}
+
+Jpeg_Private *jpeg_getLine(char *inFile, int *width, int *height, int *pixelBytes, float *zm)
+{
+    Jpeg_Private *jp = (Jpeg_Private *)calloc(1, sizeof(Jpeg_Private));
+
+    // 数据流IO准备
+    if (_jpeg_src_file(&jp->src, inFile) != 0)
+    {
+        fprintf(stderr, "jpeg_getLine: can't open %s\n", inFile);
         free(jp);
         return NULL;
     }
+    return _jpeg_getLineFrom(jp, width, height, pixelBytes, zm);
+}
 
-    jp->rowMax = jp->dinfo.output_height;
-    jp->rowSize = jp->dinfo.output_width * jp->dinfo.output_components;
+/*
+ *  行处理模式(内存中的jpeg数据, 数据在 jpeg_closeLine 之前须保持有效)
+ *  参数: 同 jpeg_getMem
+ *  返回: 行处理指针,NULL失败
+ */
+Jpeg_Private *jpeg_getLineMem(const unsigned char *jpg, int jpgSize, int *width, int *height, int *pixelBytes, float *zm)
+{
+    Jpeg_Private *jp;
 
-    if (width)
-        *width = jp->dinfo.output_width;
-    if (height)
-        *height = jp->dinfo.output_height;
-    if (pixelBytes)
-        *pixelBytes = jp->dinfo.output_components;
+    if (!jpg || jpgSize < 1)
+        return NULL;
+    jp = (Jpeg_Private *)calloc(1, sizeof(Jpeg_Private));
+    _jpeg_src_mem(&jp->src, jpg, jpgSize);
+    return _jpeg_getLineFrom(jp, width, height, pixelBytes, zm);
+}
 
-    return jp;
+//出错中止行处理: 释放编解码器和输入输出, 之后的读写都返回0
+static void _jpeg_line_abort(Jpeg_Private *jp)
+{
+    if (jp->strips)
+        _jpeg_strips_close(jp->strips);
+    if (jp->restart)
+        _jpeg_restart_close(jp->restart);
+    if (jp->codec)
+        _jpeg_codec_put(jp->codec);
+    if (jp->rw)
+        _jpeg_out_close(&jp->out);
+    else
+        _jpeg_src_close(&jp->src);
+    jp->strips = NULL;
+    jp->restart = NULL;
+    jp->codec = NULL;
+    jp->open = 0;
 }
 
 int _jpeg_createLine(Jpeg_Private *jp, unsigned char *rgbLine, int line)
 {
-    JSAMPROW jsampRow[line];
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+    JSAMPROW jsampRow[JPEG_ROWS_MAX];
+    int i, n, ret, count;
     // 行计数
-    jp->rowCount += line;
-    if (jp->rowCount > jp->rowMax)
+    if (line > jp->rowMax - jp->rowCount)
+        line = jp->rowMax - jp->rowCount;
+    // 并行编码: 行数据攒满一组时编码
+    if (jp->strips)
+    {
+        count = _jpeg_strips_write(jp->strips, rgbLine, line);
+        jp->rowCount += count;
+        if (jp->rowCount == jp->rowMax)
+        {
+            _jpeg_strips_close(jp->strips);
+            jp->strips = NULL;
+            _jpeg_out_close(&jp->out);
+            jp->open = 0;
+        }
+        zoom_stats_stage(stats, ZS_ENCODE, tick);
+        zoom_stats_rows(stats, 0, count);
+        return count;
+    }
+    // 行数据扫描,整批行指针一次交给libjpeg
+    for (count = 0; count < line; count += ret)
     {
-        line -= jp->rowCount - jp->rowMax;
-        jp->rowCount = jp->rowMax;
+        n = line - count < JPEG_ROWS_MAX ? line - count : JPEG_ROWS_MAX;
+        for (i = 0; i < n; i++)
+            jsampRow[i] = (JSAMPROW)&rgbLine[(count + i) * jp->rowSize];
+        ret = jpeg_write_scanlines(&jp->codec->cinfo, jsampRow, n);
+        if (ret < 1)
+            break;
     }
-    // 行数据扫描
-    jsampRow[0] = (JSAMPROW)rgbLine;
-    jpeg_write_scanlines(&jp->cinfo, jsampRow, line);
+    jp->rowCount += count;
     // 完毕内存回收
     if (jp->rowCount == jp->rowMax)
     {
-        jpeg_finish_compress(&jp->cinfo);
-        jpeg_destroy_compress(&jp->cinfo);
-        fclose(jp->fp);
-        jp->fp = NULL;
+        jpeg_finish_compress(&jp->codec->cinfo);
+        _jpeg_codec_put(jp->codec);
+        _jpeg_out_close(&jp->out);
+        jp->open = 0;
         // printf("end of _jpeg_createLine \r\n");
     }
-    return line;
+    zoom_stats_stage(stats, ZS_ENCODE, tick);
+    zoom_stats_rows(stats, 0, count);
+    return count;
 }
 
 int _jpeg_getLine(Jpeg_Private *jp, unsigned char *rgbLine, int line)
 {
-    JSAMPROW jsampRow[1];
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+    JSAMPROW jsampRow[JPEG_ROWS_MAX];
+    int i, n, ret, count;
     // 行计数
-    jp->rowCount += line;
-    if (jp->rowCount > jp->rowMax)
+    if (line > jp->rowMax - jp->rowCount)
+        line = jp->rowMax - jp->rowCount;
+    // 并行解码: 缓冲读完时解码下一组, 出错时提前结束
+    if (jp->restart)
+    {
+        count = _jpeg_restart_read(jp->restart, rgbLine, line);
+        jp->rowCount += count;
+        if (jp->rowCount == jp->rowMax || count < line)
+        {
+            _jpeg_restart_close(jp->restart);
+            jp->restart = NULL;
+            _jpeg_codec_put(jp->codec);
+            _jpeg_src_close(&jp->src);
+            jp->open = 0;
+        }
+        zoom_stats_stage(stats, ZS_DECODE, tick);
+        zoom_stats_rows(stats, count, 0);
+        return count;
+    }
+    // 行数据扫描,jpeg_read_scanlines每次最多返回一组输出行,循环直到读满
+    for (count = 0; count < line; count += ret)
     {
-        line -= jp->rowCount - jp->rowMax;
-        jp->rowCount = jp->rowMax;
+        n = line - count < JPEG_ROWS_MAX ? line - count : JPEG_ROWS_MAX;
+        for (i = 0; i < n; i++)
+            jsampRow[i] = (JSAMPROW)&rgbLine[(count + i) * jp->rowSize];
+        ret = jpeg_read_scanlines(&jp->codec->dinfo, jsampRow, n);
+        if (ret < 1)
+            break;
     }
-    // 行数据扫描
-    jsampRow[0] = (JSAMPROW)rgbLine;
-    jpeg_read_scanlines(&jp->dinfo, jsampRow, 1);
+    jp->rowCount += count;
     // 完毕内存回收
     if (jp->rowCount == jp->rowMax)
     {
-        jpeg_finish_decompress(&jp->dinfo);
-        jpeg_destroy_decompress(&jp->dinfo);
-        fclose(jp->fp);
-        jp->fp = NULL;
+        jpeg_finish_decompress(&jp->codec->dinfo);
+        _jpeg_codec_put(jp->codec);
+        _jpeg_src_close(&jp->src);
+        jp->open = 0;
         // printf("end of _jpeg_getLine \r\n");
     }
-    return line;
+    zoom_stats_stage(stats, ZS_DECODE, tick);
+    zoom_stats_rows(stats, count, 0);
+    return count;
 }
 
 /*
  *  按行rgb数据读、写
  *  参数:
  *      jp: 行处理指针
- *      rgbLine: 一行数据量,长度为 width * height * pixelBytes
+ *      rgbLine: 行数据,一行长度为 width * pixelBytes,多行时连续存放
  *      line: 要处理的行数
  *  返回:
  *      写图片时返回剩余行数,
@@ -329,30 +1792,64 @@ int _jpeg_getLine(Jpeg_Private *jp, unsigned char *rgbLine, int line)
  */
 int jpeg_line(Jpeg_Private *jp, unsigned char *rgbLine, int line)
 {
+    jmp_buf jump;
+    int ret;
     // 参数检查
-    if (jp && jp->fp && rgbLine && line > 0)
+    if (jp && jp->open && rgbLine && line > 0)
     {
+        // 数据错误可能出现在之后的任意一次读写, 每次调用都重新设置跳转点, 出错时提前结束
+        if (jp->codec)
+        {
+            jp->codec->jerr.jump = &jump;
+            if (setjmp(jump))
+            {
+                _jpeg_line_abort(jp);
+                return 0;
+            }
+        }
         if (jp->rw)
-            return _jpeg_createLine(jp, rgbLine, line);
+            ret = _jpeg_createLine(jp, rgbLine, line);
         else
-            return _jpeg_getLine(jp, rgbLine, line);
+            ret = _jpeg_getLine(jp, rgbLine, line);
+        // 结束时编码器已归还(跳转点已清除)
+        if (jp->open && jp->codec)
+            jp->codec->jerr.jump = NULL;
+        return ret;
     }
     return 0;
 }
 
+/*
+ *  行处理模式建议的每次读写行数
+ *  返回: iMCU高度(8或16行),libjpeg按此粒度解码、编码,整批读写可减少调用次数
+ */
+int jpeg_lineBatch(Jpeg_Private *jp)
+{
+    if (!jp)
+        return 0;
+    if (jp->rw && jp->strips)
+        return jp->strips->stripRows;
+    if (jp->rw)
+        return jp->codec->cinfo.max_v_samp_factor * DCTSIZE;
+    if (jp->restart)
+        return jp->restart->stripRows;
+    return _jpeg_imcu_rows(&jp->codec->dinfo);
+}
+
 /*
  *  完毕释放指针
  */
 void jpeg_closeLine(Jpeg_Private *jp)
 {
     unsigned char *rgbLine;
+    jmp_buf jump;
     if (jp)
     {
-        //用文件指针判断流是否关闭
-        if (jp->fp)
+        //用标志判断流是否关闭
+        if (jp->open)
         {
-            //必须把行数据填充足够,否则关闭失败
-            if (jp->rowCount != jp->rowMax)
+            //写图片必须把行数据填充足够,否则关闭失败; 读图片不用读完, 直接由 jpeg_abort 中止
+            if (jp->rw && jp->rowCount != jp->rowMax)
             {
                 rgbLine = (unsigned char *)calloc(jp->rowSize, 1);
                 while (jpeg_line(jp, rgbLine, 1) == 1)
@@ -360,26 +1857,213 @@ void jpeg_closeLine(Jpeg_Private *jp)
                 free(rgbLine);
             }
             //主动关闭
-            if (jp->fp)
+            if (jp->open)
             {
-                if (jp->rw)
+                if (jp->rw && jp->strips)
+                {
+                    _jpeg_strips_close(jp->strips);
+                    _jpeg_out_close(&jp->out);
+                }
+                else if (jp->rw)
                 {
-                    jpeg_finish_compress(&jp->cinfo);
-                    jpeg_destroy_compress(&jp->cinfo);
+                    jp->codec->jerr.jump = &jump;
+                    if (setjmp(jump) == 0)
+                        jpeg_finish_compress(&jp->codec->cinfo);
+                    _jpeg_codec_put(jp->codec);
+                    _jpeg_out_close(&jp->out);
                 }
                 else
                 {
-                    jpeg_finish_decompress(&jp->dinfo);
-                    jpeg_destroy_decompress(&jp->dinfo);
+                    if (jp->restart)
+                        _jpeg_restart_close(jp->restart);
+                    _jpeg_codec_put(jp->codec);
+                    _jpeg_src_close(&jp->src);
                 }
-                fclose(jp->fp);
             }
         }
-        jp->fp = NULL;
+        jp->open = 0;
         free(jp);
     }
 }
 
+//缩放: 输入、输出已准备好, 返回: 0成功 -1失败
+static int _jpeg_zoomIo(Jpeg_Src *in, Jpeg_Out *out, float zoom, int quality)
+{
+    // 复用本线程的解码器、编码器
+    Jpeg_Codec *jpIn = _jpeg_codec_get(0);
+    Jpeg_Codec *jpOut = _jpeg_codec_get(1);
+    // 大图多核时按条带并行编码(不用jpOut), 有重启标记时并行解码
+    Jpeg_Strips *volatile js = NULL;
+    Jpeg_Restart *volatile jr = NULL;
+    int threads = 1, rows = 0;
+
+    //输入图片一次加载完
+    unsigned char *volatile rgbIn = NULL;
+    //输出图片整幅缩放后逐行写入
+    unsigned char *volatile rgbOut = NULL;
+    //余下倍数的最近点缩放(按 zoom_plan 的定位, 整数算出源坐标)
+    Zoom_Plan *volatile plan = NULL;
+    //公用指针
+    unsigned char *pRgb;
+    //每像素字节数(灰度图为1)
+    int pb, y;
+
+    JSAMPROW jsampRow[1];
+    jmp_buf jump;
+    int ret = -1;
+
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+
+    // 数据有误等libjpeg出错时跳回这里返回失败
+    jpIn->jerr.jump = &jump;
+    jpOut->jerr.jump = &jump;
+    if (setjmp(jump))
+        goto end;
+
+    // 解析输入图片参数
+    _jpeg_src_attach(&jpIn->dinfo, in);
+    if (jpeg_read_header(&jpIn->dinfo, FALSE) != JPEG_HEADER_OK)
+    {
+        fprintf(stderr, "jpeg_zoom: jpeg_read_header failed \r\n");
+        goto end;
+    }
+
+    // 输出尺寸按原图计算, 缩小时先按DCT缩放解码到不小于输出尺寸, 下面的逐点缩放只处理余下部分
+    jpOut->cinfo.image_width = (int)(jpIn->dinfo.image_width * zoom);
+    if (jpOut->cinfo.image_width < 1)
+        jpOut->cinfo.image_width = 1;
+    jpOut->cinfo.image_height = (int)(jpIn->dinfo.image_height * zoom);
+    if (jpOut->cinfo.image_height < 1)
+        jpOut->cinfo.image_height = 1;
+    _jpeg_scale(&jpIn->dinfo, zoom);
+
+    // 开始解码
+    jr = _jpeg_restart_open(in, &jpIn->dinfo, 0);
+    if (!jr && jpeg_start_decompress(&jpIn->dinfo) == FALSE)
+    {
+        fprintf(stderr, "jpeg_zoom: jpeg_start_decompress failed \r\n");
+        goto end;
+    }
+
+    zoom_stats_stage(stats, ZS_DECODE, tick);
+
+    // 决定输出图片参数(一定要 jpeg_start_decompress 之后再查看dinfo参数)
+    tick = zoom_stats_tick(stats);
+    pb = jpIn->dinfo.output_components;
+    js = _jpeg_strips_open(out, jpOut->cinfo.image_width, jpOut->cinfo.image_height, pb, quality, 1);
+    if (!js)
+    {
+        _jpeg_out_attach(&jpOut->cinfo, out);
+        jpOut->cinfo.input_components = pb;
+        jpOut->cinfo.in_color_space = JPEG_COLOR_SPACE(pb); //压缩格式
+        jpeg_set_defaults(&jpOut->cinfo);
+        jpeg_set_quality(&jpOut->cinfo, quality, TRUE); //压缩质量
+
+        // 开始编码
+        jpeg_start_compress(&jpOut->cinfo, TRUE);
+    }
+    zoom_stats_stage(stats, ZS_ENCODE, tick);
+
+    // 内存准备: 整幅输入、输出单独分配、用完释放(不进编解码器的内存区, 免得大图的内存一直留在线程里)
+    rgbIn = (unsigned char *)malloc((size_t)jpIn->dinfo.output_width * jpIn->dinfo.output_height * pb);
+    rgbOut = (unsigned char *)malloc((size_t)jpOut->cinfo.image_width * jpOut->cinfo.image_height * pb);
+    if (!rgbIn || !rgbOut)
+    {
+        fprintf(stderr, "jpeg_zoom: malloc failed \r\n");
+        goto end;
+    }
+    zoom_stats_bytes(stats, (long long)jpIn->dinfo.output_width * jpIn->dinfo.output_height * pb);
+    zoom_stats_bytes(stats, (long long)jpOut->cinfo.image_width * jpOut->cinfo.image_height * pb);
+
+    // 读取输入整图
+    tick = zoom_stats_tick(stats);
+    if (jr)
+    {
+        rows = _jpeg_restart_read(jr, rgbIn, jpIn->dinfo.output_height);
+        _jpeg_restart_close(jr);
+        jr = NULL;
+        threads = pool_threads();
+        // 失败(数据有误等)时按单线程重新解码
+        if (rows != (int)jpIn->dinfo.output_height)
+        {
+            rows = 0;
+            threads = 1;
+            if (jpeg_start_decompress(&jpIn->dinfo) == FALSE)
+            {
+                fprintf(stderr, "jpeg_zoom: jpeg_start_decompress failed \r\n");
+                goto end;
+            }
+        }
+    }
+    pRgb = rgbIn;
+    while (rows == 0 && jpIn->dinfo.output_scanline < jpIn->dinfo.output_height)
+    {
+        jsampRow[0] = (JSAMPROW)pRgb;
+        jpeg_read_scanlines(&jpIn->dinfo, jsampRow, 1);
+        pRgb += jpIn->dinfo.output_width * pb;
+    }
+    zoom_stats_stage(stats, ZS_DECODE, tick);
+
+    // 缩放: DCT缩放解码之后余下的倍数交给最近点插值的缩放计划(与 zoom() 相同的整数定位, 多线程),
+    // 缩放耗时、行数由计划自己统计
+    plan = zoom_plan_create(jpIn->dinfo.output_width, jpIn->dinfo.output_height,
+                            jpOut->cinfo.image_width, jpOut->cinfo.image_height, ZT_NEAR, pb == 1 ? ZF_GRAY : ZF_RGB);
+    if (!plan || zoom_plan_execute(plan, rgbIn, rgbOut) != 0)
+    {
+        fprintf(stderr, "jpeg_zoom: zoom failed \r\n");
+        goto end;
+    }
+
+    // 写出
+    tick = zoom_stats_tick(stats);
+    if (js)
+        _jpeg_strips_write(js, rgbOut, jpOut->cinfo.image_height);
+    else
+    {
+        for (y = 0, pRgb = rgbOut; y < (int)jpOut->cinfo.image_height; y += 1, pRgb += jpOut->cinfo.image_width * pb)
+        {
+            jsampRow[0] = (JSAMPROW)pRgb;
+            jpeg_write_scanlines(&jpOut->cinfo, jsampRow, 1);
+        }
+    }
+    zoom_stats_stage(stats, ZS_ENCODE, tick);
+
+    // 结束编解码
+    tick = zoom_stats_tick(stats);
+    // 并行解码时解码器没有开始解压, 由 jpeg_abort 复位
+    if (rows == 0)
+        jpeg_finish_decompress(&jpIn->dinfo);
+    if (js)
+    {
+        ret = _jpeg_strips_close(js);
+        js = NULL;
+        threads = pool_threads();
+    }
+    else
+    {
+        jpeg_finish_compress(&jpOut->cinfo);
+        ret = 0;
+    }
+    zoom_stats_threads(stats, threads);
+    zoom_stats_stage(stats, ZS_ENCODE, tick);
+
+end:
+
+    // 出错中途结束时释放并行编解码
+    if (jr)
+        _jpeg_restart_close(jr);
+    if (js)
+        _jpeg_strips_close(js);
+    zoom_plan_destroy(plan);
+    free(rgbIn);
+    free(rgbOut);
+    // 复位编解码器, 留给下次使用
+    _jpeg_codec_put(jpIn);
+    _jpeg_codec_put(jpOut);
+    return ret;
+}
+
 /*
  *  文件缩放
  *  参数:
@@ -389,24 +2073,8 @@ void jpeg_closeLine(Jpeg_Private *jp)
  */
 void jpeg_zoom(char *inFile, char *outFile, float zoom, int quality)
 {
-    Jpeg_Private jpIn;
-    Jpeg_Private jpOut;
-
-    //输入图片一次加载完
-    Jpeg_Rgb *rgbIn;
-    //输入图片每次写入一行
-    Jpeg_Rgb *rgbOutLine;
-    //公用指针
-    Jpeg_Rgb *pRgb;
-
-    // 缩放分度格div及其增量计数
-    float xStep, yStep, xDiv, yDiv;
-    // 根据 xStep yStep 近似后定位到源图的位置
-    int ySrc, ySrcLast;
-    // 二维for循环计数
-    int x, y;
-
-    JSAMPROW jsampRow[1];
+    Jpeg_Src in;
+    Jpeg_Out out;
 
     // 参数检查
     if (!inFile || !outFile || zoom < 0.1 || quality < 1 || quality > 100)
@@ -416,125 +2084,166 @@ void jpeg_zoom(char *inFile, char *outFile, float zoom, int quality)
     }
 
     // 数据流IO准备
-    if ((jpIn.fp = fopen(inFile, "rb")) == NULL)
+    if (_jpeg_src_file(&in, inFile) != 0)
     {
         fprintf(stderr, "jpeg_zoom: can't open %s\n", inFile);
         return;
     }
-    if ((jpOut.fp = fopen(outFile, "wb")) == NULL)
+    if (_jpeg_out_file(&out, outFile) != 0)
     {
         fprintf(stderr, "jpeg_zoom: can't open %s\n", outFile);
-        fclose(jpIn.fp);
+        _jpeg_src_close(&in);
         return;
     }
 
-    // 编解码器初始化
-    jpIn.dinfo.err = jpeg_std_error(&jpIn.jerr);
-    jpOut.cinfo.err = jpeg_std_error(&jpOut.jerr);
-    jpeg_create_decompress(&jpIn.dinfo);
-    jpeg_create_compress(&jpOut.cinfo);
+    _jpeg_zoomIo(&in, &out, zoom, quality);
 
-    // 解析输入图片参数
-    jpeg_stdio_src(&jpIn.dinfo, jpIn.fp);
-    if (jpeg_read_header(&jpIn.dinfo, FALSE) != JPEG_HEADER_OK)
-    {
-        fprintf(stderr, "jpeg_zoom: jpeg_read_header failed \r\n");
-        goto end;
-    }
+    _jpeg_out_close(&out);
+    _jpeg_src_close(&in);
+}
 
-    // 开始解码
-    if (jpeg_start_decompress(&jpIn.dinfo) == FALSE)
+/*
+ *  内存缩放
+ *  参数: 同 jpeg_zoom
+ *      jpg, jpgSize: 输入jpeg数据及字节数
+ *      jpgOut, jpgOutSize: 返回输出jpeg数据及字节数 !! 用完记得free()释放 !!
+ *  返回: 0成功 -1失败
+ */
+int jpeg_zoomMem(const unsigned char *jpg, int jpgSize, unsigned char **jpgOut, int *jpgOutSize, float zoom, int quality)
+{
+    Jpeg_Src in;
+    Jpeg_Out out;
+    int ret;
+
+    // 参数检查
+    if (!jpg || jpgSize < 1 || !jpgOut || !jpgOutSize || zoom < 0.1 || quality < 1 || quality > 100)
     {
-        fprintf(stderr, "jpeg_zoom: jpeg_start_decompress failed \r\n");
-        goto end;
+        fprintf(stderr, "jpeg_zoomMem: param error !!\n");
+        return -1;
     }
 
-    // 决定输出图片参数(一定要 jpeg_start_decompress 之后再查看dinfo参数)
-    jpeg_stdio_dest(&jpOut.cinfo, jpOut.fp);
-    jpOut.cinfo.image_width = (int)(jpIn.dinfo.output_width * zoom);
-    if (jpOut.cinfo.image_width < 1)
-        jpOut.cinfo.image_width = 1;
-    jpOut.cinfo.image_height = (int)(jpIn.dinfo.output_height * zoom);
-    if (jpOut.cinfo.image_height < 1)
-        jpOut.cinfo.image_height = 1;
-    jpOut.cinfo.input_components = jpIn.dinfo.output_components;
-    jpOut.cinfo.in_color_space = JCS_RGB; //压缩格式
-    jpeg_set_defaults(&jpOut.cinfo);
-    jpeg_set_quality(&jpOut.cinfo, quality, TRUE); //压缩质量
-
-    // 开始编码
-    jpeg_start_compress(&jpOut.cinfo, TRUE);
-
-    // 内存准备
-    rgbIn = (Jpeg_Rgb *)calloc(jpIn.dinfo.output_width * jpIn.dinfo.output_height, sizeof(Jpeg_Rgb));
-    rgbOutLine = (Jpeg_Rgb *)calloc(jpOut.cinfo.image_width, sizeof(Jpeg_Rgb));
+    _jpeg_src_mem(&in, jpg, jpgSize);
+    _jpeg_out_mem(&out, jpgOut, jpgOutSize);
+    ret = _jpeg_zoomIo(&in, &out, zoom, quality);
+    _jpeg_out_close(&out);
+    return ret;
+}
 
-    // 读取输入整图
-    pRgb = rgbIn;
-    while (jpIn.dinfo.output_scanline < jpIn.dinfo.output_height)
+//流水线缩放: 输入已按行解码打开, outFile 为NULL时输出到内存, 返回: 0成功 -1失败
+static int _jpeg_zoomPipe(Jpeg_Private *in, int width, int height, int pixelBytes, float zm, Zoom_Type zt, int quality, int depth,
+                          char *outFile, unsigned char **jpgOut, int *jpgOutSize)
+{
+    Jpeg_Private *out;
+    int widthOut = (int)(width * zm);
+    int heightOut = (int)(height * zm);
+    int ret;
+
+    // 输出尺寸与 zoom_stream 的计算一致
+    if (widthOut < 1)
+        widthOut = 1;
+    if (heightOut < 1)
+        heightOut = 1;
+    if (outFile)
+        out = jpeg_createLine(outFile, widthOut, heightOut, pixelBytes, quality);
+    else
+        out = jpeg_createLineMem(jpgOut, jpgOutSize, widthOut, heightOut, pixelBytes, quality);
+    if (!out)
     {
-        jsampRow[0] = (JSAMPROW)pRgb;
-        jpeg_read_scanlines(&jpIn.dinfo, jsampRow, 1);
-        pRgb += jpIn.dinfo.output_width;
+        jpeg_closeLine(in);
+        return -1;
     }
 
-    // 缩放准备
-    xDiv = (float)jpIn.dinfo.output_width / jpOut.cinfo.image_width;
-    yDiv = (float)jpIn.dinfo.output_height / jpOut.cinfo.image_height;
+    // 解码在读取线程、编码在写出线程, 缩放在本线程; jpeg_line 每次调用都在所在线程设置libjpeg出错的跳转点,
+    // 数据有误时返回0, 流水线随之关闭队列、各阶段提前结束
+    zoom_stream_pipeline(
+        in, out,
+        (int (*)(void *, unsigned char *, int))&jpeg_line,
+        (int (*)(void *, unsigned char *, int))&jpeg_line,
+        width, height, NULL, NULL, zm, zt,
+        pixelBytes == 1 ? ZF_GRAY : ZF_RGB, jpeg_lineBatch(in), depth);
+
+    // 输出行不足时(解码、编码失败)直接中止输出, 不再补齐空行, 按失败返回
+    ret = out->rowCount == out->rowMax ? 0 : -1;
+    if (ret != 0 && out->open)
+        _jpeg_line_abort(out);
+    jpeg_closeLine(in);
+    jpeg_closeLine(out);
+    return ret;
+}
 
-    // 开始缩放
-    jsampRow[0] = (JSAMPROW)rgbOutLine; // 用于写jpeg行数据
-    for (y = 0, yStep = 0, ySrcLast = -1; y < jpOut.cinfo.image_height; y += 1, yStep += yDiv)
+/*
+ *  流水线文件缩放
+ *  参数: 同 jpeg_zoom
+ *      zt: 缩放方式
+ *      depth: 各阶段之间的队列长度(批数),传0使用默认4批
+ */
+void jpeg_zoomPipeline(char *inFile, char *outFile, float zoom, Zoom_Type zt, int quality, int depth)
+{
+    Jpeg_Private *in;
+    int width, height, pixelBytes;
+
+    // 参数检查
+    if (!inFile || !outFile || zoom < 0.1 || quality < 1 || quality > 100)
     {
-        //最近y值
-        ySrc = (int)(yStep);
-        //同行比对,避免重复的行赋值
-        if (ySrc != ySrcLast)
-        {
-            //更新比对值
-            ySrcLast = ySrc;
-            //避免下面for循环中重复该乘法
-            ySrc *= jpIn.dinfo.output_width;
-            //行像素遍历
-            for (x = 0, xStep = 0; x < jpOut.cinfo.image_width; x += 1, xStep += xDiv)
-            {
-                rgbOutLine[x] = rgbIn[ySrc + (int)(xStep)];
-            }
-        }
-        //写入一行数据
-        jpeg_write_scanlines(&jpOut.cinfo, jsampRow, 1);
+        fprintf(stderr, "jpeg_zoomPipeline: param error !!\n");
+        return;
     }
 
-    // 内存
-    free(rgbIn);
-    free(rgbOutLine);
-
-    // 结束编解码
-    jpeg_finish_decompress(&jpIn.dinfo);
-    jpeg_finish_compress(&jpOut.cinfo);
+    // 按行解码(缩小时按DCT缩放解码, zoom 返回余下的缩放倍数)
+    in = jpeg_getLine(inFile, &width, &height, &pixelBytes, &zoom);
+    if (!in)
+        return;
+    _jpeg_zoomPipe(in, width, height, pixelBytes, zoom, zt, quality, depth, outFile, NULL, NULL);
+}
 
-end:
+/*
+ *  流水线内存缩放
+ *  参数: 同 jpeg_zoomPipeline, jpg 等同 jpeg_zoomMem
+ *  返回: 0成功 -1失败
+ */
+int jpeg_zoomPipelineMem(const unsigned char *jpg, int jpgSize, unsigned char **jpgOut, int *jpgOutSize, float zoom, Zoom_Type zt, int quality, int depth)
+{
+    Jpeg_Private *in;
+    int width, height, pixelBytes;
 
-    // 销毁编解码器
-    jpeg_destroy_decompress(&jpIn.dinfo);
-    jpeg_destroy_compress(&jpOut.cinfo);
+    // 参数检查
+    if (!jpg || jpgSize < 1 || !jpgOut || !jpgOutSize || zoom < 0.1 || quality < 1 || quality > 100)
+    {
+        fprintf(stderr, "jpeg_zoomPipelineMem: param error !!\n");
+        return -1;
+    }
 
-    fclose(jpOut.fp);
-    fclose(jpIn.fp);
+    *jpgOut = NULL;
+    *jpgOutSize = 0;
+    in = jpeg_getLineMem(jpg, jpgSize, &width, &height, &pixelBytes, &zoom);
+    if (!in)
+        return -1;
+    if (_jpeg_zoomPipe(in, width, height, pixelBytes, zoom, zt, quality, depth, NULL, jpgOut, jpgOutSize) != 0)
+    {
+        free(*jpgOut);
+        *jpgOut = NULL;
+        *jpgOutSize = 0;
+        return -1;
+    }
+    return 0;
 }
 
 //固定放大2.5倍,且要求输入图像宽高为5的整数倍
 void jpeg_zoom2(char *inFile, char *outFile, int quality)
 {
-    Jpeg_Private jpIn;
-    Jpeg_Private jpOut;
+    Jpeg_Codec *jpIn;
+    Jpeg_Codec *jpOut;
+    Jpeg_Src in;
+    Jpeg_Out out;
 
     //输入图片一次加载完
-    Jpeg_Rgb *rgbIn;
+    unsigned char *rgbIn;
     //输入图片每次写入一行
-    Jpeg_Rgb *rgbOutLine;
+    unsigned char *rgbOutLine;
     //公用指针
-    Jpeg_Rgb *pRgb, *pRgbTar;
+    unsigned char *pRgb, *pRgbTar;
+    //每像素字节数(灰度图为1)
+    int pb;
 
     // 二维for循环计数
     int xDist;
@@ -549,68 +2258,67 @@ void jpeg_zoom2(char *inFile, char *outFile, int quality)
     }
 
     // 数据流IO准备
-    if ((jpIn.fp = fopen(inFile, "rb")) == NULL)
+    if (_jpeg_src_file(&in, inFile) != 0)
     {
         fprintf(stderr, "jpeg_zoom: can't open %s\n", inFile);
         return;
     }
-    if ((jpOut.fp = fopen(outFile, "wb")) == NULL)
+    if (_jpeg_out_file(&out, outFile) != 0)
     {
         fprintf(stderr, "jpeg_zoom: can't open %s\n", outFile);
-        fclose(jpIn.fp);
+        _jpeg_src_close(&in);
         return;
     }
 
-    // 编解码器初始化
-    jpIn.dinfo.err = jpeg_std_error(&jpIn.jerr);
-    jpOut.cinfo.err = jpeg_std_error(&jpOut.jerr);
-    jpeg_create_decompress(&jpIn.dinfo);
-    jpeg_create_compress(&jpOut.cinfo);
+    // 复用本线程的解码器、编码器
+    jpIn = _jpeg_codec_get(0);
+    jpOut = _jpeg_codec_get(1);
 
     // 解析输入图片参数
-    jpeg_stdio_src(&jpIn.dinfo, jpIn.fp);
-    if (jpeg_read_header(&jpIn.dinfo, FALSE) != JPEG_HEADER_OK)
+    _jpeg_src_attach(&jpIn->dinfo, &in);
+    if (jpeg_read_header(&jpIn->dinfo, FALSE) != JPEG_HEADER_OK)
     {
         fprintf(stderr, "jpeg_zoom: jpeg_read_header failed \r\n");
         goto end;
     }
 
     // 开始解码
-    if (jpeg_start_decompress(&jpIn.dinfo) == FALSE)
+    if (jpeg_start_decompress(&jpIn->dinfo) == FALSE)
     {
         fprintf(stderr, "jpeg_zoom: jpeg_start_decompress failed \r\n");
         goto end;
     }
 
     // 决定输出图片参数(一定要 jpeg_start_decompress 之后再查看dinfo参数)
-    jpeg_stdio_dest(&jpOut.cinfo, jpOut.fp);
-    jpOut.cinfo.image_width = (int)(jpIn.dinfo.output_width * 2.5);
-    jpOut.cinfo.image_height = (int)(jpIn.dinfo.output_height * 2.5);
-    jpOut.cinfo.input_components = jpIn.dinfo.output_components;
-    jpOut.cinfo.in_color_space = JCS_RGB; //压缩格式
-    jpeg_set_defaults(&jpOut.cinfo);
-    jpeg_set_quality(&jpOut.cinfo, quality, TRUE); //压缩质量
+    _jpeg_out_attach(&jpOut->cinfo, &out);
+    jpOut->cinfo.image_width = (int)(jpIn->dinfo.output_width * 2.5);
+    jpOut->cinfo.image_height = (int)(jpIn->dinfo.output_height * 2.5);
+    jpOut->cinfo.input_components = jpIn->dinfo.output_components;
+    jpOut->cinfo.in_color_space = JPEG_COLOR_SPACE(jpIn->dinfo.output_components); //压缩格式
+    jpeg_set_defaults(&jpOut->cinfo);
+    jpeg_set_quality(&jpOut->cinfo, quality, TRUE); //压缩质量
 
     // 开始编码
-    jpeg_start_compress(&jpOut.cinfo, TRUE);
+    jpeg_start_compress(&jpOut->cinfo, TRUE);
 
     // 内存准备
-    rgbIn = (Jpeg_Rgb *)calloc(jpIn.dinfo.output_width * jpIn.dinfo.output_height, sizeof(Jpeg_Rgb));
-    rgbOutLine = (Jpeg_Rgb *)calloc(jpOut.cinfo.image_width, sizeof(Jpeg_Rgb));
+    pb = jpIn->dinfo.output_components;
+    rgbIn = (unsigned char *)calloc(jpIn->dinfo.output_width * jpIn->dinfo.output_height, pb);
+    rgbOutLine = (unsigned char *)calloc(jpOut->cinfo.image_width, pb);
 
     // 读取输入整图
     pRgb = rgbIn;
-    while (jpIn.dinfo.output_scanline < jpIn.dinfo.output_height)
+    while (jpIn->dinfo.output_scanline < jpIn->dinfo.output_height)
     {
         jsampRow[0] = (JSAMPROW)pRgb;
-        jpeg_read_scanlines(&jpIn.dinfo, jsampRow, 1);
-        pRgb += jpIn.dinfo.output_width;
+        jpeg_read_scanlines(&jpIn->dinfo, jsampRow, 1);
+        pRgb += jpIn->dinfo.output_width * pb;
     }
 
     // 开始缩放
     jsampRow[0] = (JSAMPROW)rgbOutLine; // 用于写jpeg行数据
     pRgb = rgbIn;
-    pRgbTar = rgbIn + (jpIn.dinfo.output_width * jpIn.dinfo.output_height);
+    pRgbTar = rgbIn + (jpIn->dinfo.output_width * jpIn->dinfo.output_height * pb);
     do
     {
         //拷贝一行数据
@@ -618,37 +2326,41 @@ void jpeg_zoom2(char *inFile, char *outFile, int quality)
         do
         {
             // step += div, div = 0.4, step = 0.0/0.4/0.8, 即原图复用3次这个点
-            rgbOutLine[xDist++] = *pRgb;
-            rgbOutLine[xDist++] = *pRgb;
-            rgbOutLine[xDist++] = *pRgb++;
+            memcpy(&rgbOutLine[xDist++ * pb], pRgb, pb);
+            memcpy(&rgbOutLine[xDist++ * pb], pRgb, pb);
+            memcpy(&rgbOutLine[xDist++ * pb], pRgb, pb);
+            pRgb += pb;
             // step += div, div = 0.4, step = 1.2/1.6, 即原图复用2次这个点
-            rgbOutLine[xDist++] = *pRgb;
-            rgbOutLine[xDist++] = *pRgb++;
+            memcpy(&rgbOutLine[xDist++ * pb], pRgb, pb);
+            memcpy(&rgbOutLine[xDist++ * pb], pRgb, pb);
+            pRgb += pb;
         }
-        while (xDist < jpOut.cinfo.image_width);
+        while (xDist < jpOut->cinfo.image_width);
 
         //写3行数据 step += div, div = 0.4, step = 0.0/0.4/0.8, 即原图复用3次该行
-        jpeg_write_scanlines(&jpOut.cinfo, jsampRow, 1);
-        jpeg_write_scanlines(&jpOut.cinfo, jsampRow, 1);
-        jpeg_write_scanlines(&jpOut.cinfo, jsampRow, 1);
+        jpeg_write_scanlines(&jpOut->cinfo, jsampRow, 1);
+        jpeg_write_scanlines(&jpOut->cinfo, jsampRow, 1);
+        jpeg_write_scanlines(&jpOut->cinfo, jsampRow, 1);
 
         //拷贝一行数据
         xDist = 0;
         do
         {
             // step += div, div = 0.4, step = 0.0/0.4/0.8, 即原图复用3次这个点
-            rgbOutLine[xDist++] = *pRgb;
-            rgbOutLine[xDist++] = *pRgb;
-            rgbOutLine[xDist++] = *pRgb++;
+            memcpy(&rgbOutLine[xDist++ * pb], pRgb, pb);
+            memcpy(&rgbOutLine[xDist++ * pb], pRgb, pb);
+            memcpy(&rgbOutLine[xDist++ * pb], pRgb, pb);
+            pRgb += pb;
             // step += div, div = 0.4, step = 1.2/1.6, 即原图复用2次这个点
-            rgbOutLine[xDist++] = *pRgb;
-            rgbOutLine[xDist++] = *pRgb++;
+            memcpy(&rgbOutLine[xDist++ * pb], pRgb, pb);
+            memcpy(&rgbOutLine[xDist++ * pb], pRgb, pb);
+            pRgb += pb;
         }
-        while (xDist < jpOut.cinfo.image_width);
+        while (xDist < jpOut->cinfo.image_width);
 
         //写2行数据 step += div, div = 0.4, step = 1.2/1.6, 即原图复用2次该行
-        jpeg_write_scanlines(&jpOut.cinfo, jsampRow, 1);
-        jpeg_write_scanlines(&jpOut.cinfo, jsampRow, 1);
+        jpeg_write_scanlines(&jpOut->cinfo, jsampRow, 1);
+        jpeg_write_scanlines(&jpOut->cinfo, jsampRow, 1);
     }
     while (pRgb < pRgbTar);
 
@@ -657,15 +2369,274 @@ void jpeg_zoom2(char *inFile, char *outFile, int quality)
     free(rgbOutLine);
 
     // 结束编解码
-    jpeg_finish_decompress(&jpIn.dinfo);
-    jpeg_finish_compress(&jpOut.cinfo);
+    jpeg_finish_decompress(&jpIn->dinfo);
+    jpeg_finish_compress(&jpOut->cinfo);
+
+end:
+
+    // 复位编解码器, 留给下次使用
+    _jpeg_codec_put(jpIn);
+    _jpeg_codec_put(jpOut);
+
+    _jpeg_out_close(&out);
+    _jpeg_src_close(&in);
+}
+
+//yuv直通: 一个分量的整幅平面及iMCU行缓冲
+typedef struct
+{
+    unsigned char *data; //整幅平面, 每行 width 字节
+    int width, height;
+    unsigned char *strip; //iMCU行缓冲, lines 行, 每行 stride 字节(整块宽度)
+    int stride, lines;
+    JSAMPROW rows[MAX_SAMP_FACTOR * DCTSIZE];
+} Jpeg_Plane;
+
+//yuv直通: 按分量的块宽、采样因子准备iMCU行缓冲
+static void _jpeg_plane_strip(Jpeg_Plane *pl, jpeg_component_info *comp)
+{
+    int i;
+    pl->stride = comp->width_in_blocks * DCTSIZE;
+    pl->lines = comp->v_samp_factor * DCTSIZE;
+    pl->strip = (unsigned char *)calloc(pl->lines, pl->stride);
+    for (i = 0; i < pl->lines; i++)
+        pl->rows[i] = (JSAMPROW)&pl->strip[i * pl->stride];
+}
+
+//yuv直通缩放: 输入、输出已准备好, 返回: 0成功 -1失败
+static int _jpeg_zoomRawIo(Jpeg_Src *in, Jpeg_Out *out, float zoom, Zoom_Type zt, int quality)
+{
+    Jpeg_Codec *jpIn;
+    Jpeg_Codec *jpOut;
+
+    //各分量的输入、输出平面
+    Jpeg_Plane planeIn[MAX_COMPONENTS];
+    Jpeg_Plane planeOut[MAX_COMPONENTS];
+    JSAMPARRAY data[MAX_COMPONENTS];
+    Zoom_Plan *plan;
+    jpeg_component_info *comp;
+    int c, i, y, sy, imcu, lines;
+    jmp_buf jump;
+    int ret = -1;
+
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+
+    // 复用本线程的解码器、编码器, 数据有误等libjpeg出错时跳回这里返回失败
+    jpIn = _jpeg_codec_get(0);
+    jpOut = _jpeg_codec_get(1);
+    memset(planeIn, 0, sizeof(planeIn));
+    memset(planeOut, 0, sizeof(planeOut));
+    jpIn->jerr.jump = &jump;
+    jpOut->jerr.jump = &jump;
+    if (setjmp(jump))
+    {
+        ret = -1;
+        goto end;
+    }
+
+    // 解析输入图片参数
+    _jpeg_src_attach(&jpIn->dinfo, in);
+    if (jpeg_read_header(&jpIn->dinfo, FALSE) != JPEG_HEADER_OK)
+    {
+        fprintf(stderr, "jpeg_zoomRaw: jpeg_read_header failed \r\n");
+        goto end;
+    }
+
+    // 只有YCbCr、灰度可以直通, 其它颜色空间走rgb(同一份输入从头重新解码)
+    if (!(jpIn->dinfo.jpeg_color_space == JCS_YCbCr && jpIn->dinfo.num_components == 3) &&
+        !(jpIn->dinfo.jpeg_color_space == JCS_GRAYSCALE && jpIn->dinfo.num_components == 1))
+    {
+        _jpeg_codec_put(jpIn);
+        _jpeg_codec_put(jpOut);
+        return _jpeg_zoomIo(in, out, zoom, quality);
+    }
+
+    // 按分量原始数据解码(不做颜色转换和上采样)
+    jpIn->dinfo.raw_data_out = TRUE;
+    if (jpeg_start_decompress(&jpIn->dinfo) == FALSE)
+    {
+        fprintf(stderr, "jpeg_zoomRaw: jpeg_start_decompress failed \r\n");
+        goto end;
+    }
+
+    // 各分量整幅平面及iMCU行缓冲
+    for (c = 0; c < jpIn->dinfo.num_components; c++)
+    {
+        comp = &jpIn->dinfo.comp_info[c];
+        planeIn[c].width = comp->downsampled_width;
+        planeIn[c].height = comp->downsampled_height;
+        planeIn[c].data = (unsigned char *)calloc(planeIn[c].width, planeIn[c].height);
+        zoom_stats_bytes(stats, (long long)planeIn[c].width * planeIn[c].height);
+        _jpeg_plane_strip(&planeIn[c], comp);
+        data[c] = planeIn[c].rows;
+    }
+
+    // 读取输入整图: 每次一个iMCU行, 只保留各分量的有效宽高
+    lines = jpIn->dinfo.max_v_samp_factor * DCTSIZE;
+    for (imcu = 0; jpIn->dinfo.output_scanline < jpIn->dinfo.output_height; imcu++)
+    {
+        if (jpeg_read_raw_data(&jpIn->dinfo, data, lines) < 1)
+            break;
+        for (c = 0; c < jpIn->dinfo.num_components; c++)
+        {
+            for (i = 0, y = imcu * planeIn[c].lines; i < planeIn[c].lines && y < planeIn[c].height; i++, y++)
+                memcpy(&planeIn[c].data[y * planeIn[c].width], planeIn[c].rows[i], planeIn[c].width);
+        }
+    }
+    zoom_stats_stage(stats, ZS_DECODE, tick);
+    zoom_stats_rows(stats, jpIn->dinfo.output_height, 0);
+
+    tick = zoom_stats_tick(stats);
+
+    // 输出图片参数: 与输入同颜色空间、同采样因子, 按分量原始数据编码
+    _jpeg_out_attach(&jpOut->cinfo, out);
+    jpOut->cinfo.image_width = (int)(jpIn->dinfo.image_width * zoom);
+    if (jpOut->cinfo.image_width < 1)
+        jpOut->cinfo.image_width = 1;
+    jpOut->cinfo.image_height = (int)(jpIn->dinfo.image_height * zoom);
+    if (jpOut->cinfo.image_height < 1)
+        jpOut->cinfo.image_height = 1;
+    jpOut->cinfo.input_components = jpIn->dinfo.num_components;
+    jpOut->cinfo.in_color_space = jpIn->dinfo.jpeg_color_space;
+    jpeg_set_defaults(&jpOut->cinfo);
+    jpeg_set_quality(&jpOut->cinfo, quality, TRUE);
+    for (c = 0; c < jpIn->dinfo.num_components; c++)
+    {
+        jpOut->cinfo.comp_info[c].h_samp_factor = jpIn->dinfo.comp_info[c].h_samp_factor;
+        jpOut->cinfo.comp_info[c].v_samp_factor = jpIn->dinfo.comp_info[c].v_samp_factor;
+    }
+    jpOut->cinfo.raw_data_in = TRUE;
+    jpeg_start_compress(&jpOut->cinfo, TRUE);
+
+    zoom_stats_stage(stats, ZS_ENCODE, tick);
+
+    // 采样因子取自输入分量信息, 结束解码时才释放
+    jpeg_finish_decompress(&jpIn->dinfo);
+
+    // 逐分量缩放(分量尺寸在 jpeg_start_compress 之后才确定)
+    for (c = 0; c < jpOut->cinfo.num_components; c++)
+    {
+        comp = &jpOut->cinfo.comp_info[c];
+        planeOut[c].width = comp->downsampled_width;
+        planeOut[c].height = comp->downsampled_height;
+        planeOut[c].data = (unsigned char *)calloc(planeOut[c].width, planeOut[c].height);
+        zoom_stats_bytes(stats, (long long)planeOut[c].width * planeOut[c].height);
+        _jpeg_plane_strip(&planeOut[c], comp);
+        data[c] = planeOut[c].rows;
+
+        plan = zoom_plan_create_plane(
+            planeIn[c].width, planeIn[c].height, planeOut[c].width, planeOut[c].height, zt, ZF_GRAY,
+            jpIn->dinfo.image_width, jpIn->dinfo.image_height, jpOut->cinfo.image_width, jpOut->cinfo.image_height);
+        zoom_plan_execute(plan, planeIn[c].data, planeOut[c].data);
+        zoom_plan_destroy(plan);
+    }
+
+    // 写出: 每次一个iMCU行, 超出有效宽高的部分重复边缘像素补满整块
+    tick = zoom_stats_tick(stats);
+    lines = jpOut->cinfo.max_v_samp_factor * DCTSIZE;
+    for (imcu = 0; jpOut->cinfo.next_scanline < jpOut->cinfo.image_height; imcu++)
+    {
+        for (c = 0; c < jpOut->cinfo.num_components; c++)
+        {
+            for (i = 0; i < planeOut[c].lines; i++)
+            {
+                sy = imcu * planeOut[c].lines + i;
+                if (sy > planeOut[c].height - 1)
+                    sy = planeOut[c].height - 1;
+                memcpy(planeOut[c].rows[i], &planeOut[c].data[sy * planeOut[c].width], planeOut[c].width);
+                memset(&planeOut[c].rows[i][planeOut[c].width], planeOut[c].rows[i][planeOut[c].width - 1],
+                       planeOut[c].stride - planeOut[c].width);
+            }
+        }
+        if (jpeg_write_raw_data(&jpOut->cinfo, data, lines) < 1)
+            break;
+    }
+    jpeg_finish_compress(&jpOut->cinfo);
+    zoom_stats_stage(stats, ZS_ENCODE, tick);
+    zoom_stats_rows(stats, 0, jpOut->cinfo.image_height);
+    ret = 0;
 
 end:
 
-    // 销毁编解码器
-    jpeg_destroy_decompress(&jpIn.dinfo);
-    jpeg_destroy_compress(&jpOut.cinfo);
+    // 内存
+    for (c = 0; c < MAX_COMPONENTS; c++)
+    {
+        free(planeIn[c].data);
+        free(planeIn[c].strip);
+        free(planeOut[c].data);
+        free(planeOut[c].strip);
+    }
+
+    // 复位编解码器, 留给下次使用
+    _jpeg_codec_put(jpIn);
+    _jpeg_codec_put(jpOut);
+    return ret;
+}
+
+/*
+ *  文件缩放(yuv直通)
+ *  参数:
+ *      inFile, outFile: 输入输出文件,类型.jpg.jpeg.JPG.JPEG
+ *      zoom: 缩放倍数,0.1到1为缩放,1.0以上放大
+ *      zt: 缩放方式
+ *      quality: 输出图片质量,1~100,越大越好,文件越大
+ *  说明: 按原始YCbCr分量数据解码、逐分量缩放后按分量数据编码, 省去rgb与YCbCr之间的两次颜色转换
+ *       和色度的上、下采样; 输出保持输入的采样因子(如4:2:0), 各分量按整幅图像的比例定位;
+ *       输入不是YCbCr或灰度(如CMYK)时改用 jpeg_zoom
+ */
+void jpeg_zoomRaw(char *inFile, char *outFile, float zoom, Zoom_Type zt, int quality)
+{
+    Jpeg_Src in;
+    Jpeg_Out out;
+
+    // 参数检查
+    if (!inFile || !outFile || zoom < 0.1 || quality < 1 || quality > 100)
+    {
+        fprintf(stderr, "jpeg_zoomRaw: param error !!\n");
+        return;
+    }
+
+    // 数据流IO准备
+    if (_jpeg_src_file(&in, inFile) != 0)
+    {
+        fprintf(stderr, "jpeg_zoomRaw: can't open %s\n", inFile);
+        return;
+    }
+    if (_jpeg_out_file(&out, outFile) != 0)
+    {
+        fprintf(stderr, "jpeg_zoomRaw: can't open %s\n", outFile);
+        _jpeg_src_close(&in);
+        return;
+    }
+
+    _jpeg_zoomRawIo(&in, &out, zoom, zt, quality);
+
+    _jpeg_out_close(&out);
+    _jpeg_src_close(&in);
+}
+
+/*
+ *  内存缩放(yuv直通)
+ *  参数: 同 jpeg_zoomRaw, jpg 等同 jpeg_zoomMem
+ *  返回: 0成功 -1失败
+ */
+int jpeg_zoomRawMem(const unsigned char *jpg, int jpgSize, unsigned char **jpgOut, int *jpgOutSize, float zoom, Zoom_Type zt, int quality)
+{
+    Jpeg_Src in;
+    Jpeg_Out out;
+    int ret;
+
+    // 参数检查
+    if (!jpg || jpgSize < 1 || !jpgOut || !jpgOutSize || zoom < 0.1 || quality < 1 || quality > 100)
+    {
+        fprintf(stderr, "jpeg_zoomRawMem: param error !!\n");
+        return -1;
+    }
 
-    fclose(jpOut.fp);
-    fclose(jpIn.fp);
-}
\ No newline at end of file
+    _jpeg_src_mem(&in, jpg, jpgSize);
+    _jpeg_out_mem(&out, jpgOut, jpgOutSize);
+    ret = _jpeg_zoomRawIo(&in, &out, zoom, zt, quality);
+    _jpeg_out_close(&out);
+    return ret;
+}
@@ -2,6 +2,15 @@
 #ifndef _JPEG_H_
 #define _JPEG_H_
 
+#include "zoom.h"
+
+// 输入文件用mmap映射后整块交给libjpeg读取, 不经过stdio缓冲;
+// 各接口的 *Mem 版本直接读写内存中的jpeg数据, 不经过文件系统;
+// 输出图像不小于1M像素且多核时(jpeg_create、jpeg_createLine、jpeg_zoom), 按MCU行对齐的水平条带多线程编码,
+// 条带之间以重启标记(RST)分隔, 为标准的基线jpeg, 解码结果与单线程编码相同
+// 输入带重启标记且不小于1M像素时(jpeg_get、jpeg_getLine、jpeg_zoom), 按重启段对齐的条带多线程解码, 结果与单线程解码相同;
+// 没有重启标记、渐进式等其它输入按单线程解码
+
 // -------------------------- 文件数据整读整写模式 --------------------------
 
 /*
@@ -11,9 +20,12 @@
  *      width: 返回图片宽(像素), 不接收置NULL
  *      height: 返回图片高(像素), 不接收置NULL
  *      pixelBytes: 返回图片每像素的字节数, 不接收置NULL
+ *      zm: 传入之后要缩放的倍数, 返回解码后还需缩放的倍数, 按原尺寸解码置NULL
+ *          缩小时按DCT缩放直接解码到原图的 1/2、1/4 或 1/8(取仍不小于目标尺寸的最小一档),
+ *          width、height 返回的是解码后的尺寸, 解码耗时和内存占用随之减少
  *  返回: 图片数据指针, 已分配内存 !! 用完记得free()释放 !!
  */
-unsigned char *jpeg_get(char *inFile, int *width, int *height, int *pixelBytes);
+unsigned char *jpeg_get(char *inFile, int *width, int *height, int *pixelBytes, float *zm);
 
 /*
  *  生成 bmp 图片
@@ -28,14 +40,31 @@ unsigned char *jpeg_get(char *inFile, int *width, int *height, int *pixelBytes);
  */
 int jpeg_create(char *outFile, unsigned char *rgb, int width, int height, int pixelBytes, int quality);
 
+/*
+ *  内存中的 jpeg 图片数据获取
+ *  参数: 同 jpeg_get
+ *      jpg, jpgSize: jpeg数据及字节数
+ *  返回: 图片数据指针, 已分配内存 !! 用完记得free()释放 !!
+ */
+unsigned char *jpeg_getMem(const unsigned char *jpg, int jpgSize, int *width, int *height, int *pixelBytes, float *zm);
+
+/*
+ *  生成 jpeg 图片数据到内存
+ *  参数: 同 jpeg_create
+ *      jpg: 返回jpeg数据指针 !! 用完记得free()释放 !!
+ *      jpgSize: 返回jpeg数据字节数
+ *  返回: 0成功 -1失败
+ */
+int jpeg_createMem(unsigned char **jpg, int *jpgSize, unsigned char *rgb, int width, int height, int pixelBytes, int quality);
+
 // -------------------------- 行数据流处理模式 --------------------------
 
 /*
  *  行处理模式
- *  参数: 同上
+ *  参数: 同上(zm 同 jpeg_get)
  *  返回: 行处理指针,NULL失败
  */
-void *jpeg_getLine(char *inFile, int *width, int *height, int *pixelBytes);
+void *jpeg_getLine(char *inFile, int *width, int *height, int *pixelBytes, float *zm);
 
 /*
  *  行处理模式
@@ -44,18 +73,39 @@ void *jpeg_getLine(char *inFile, int *width, int *height, int *pixelBytes);
  */
 void *jpeg_createLine(char *outFile, int width, int height, int pixelBytes, int quality);
 
+/*
+ *  行处理模式(内存中的jpeg数据)
+ *  参数: 同 jpeg_getMem, jpg 在 jpeg_closeLine 之前须保持有效
+ *  返回: 行处理指针,NULL失败
+ */
+void *jpeg_getLineMem(const unsigned char *jpg, int jpgSize, int *width, int *height, int *pixelBytes, float *zm);
+
+/*
+ *  行处理模式(输出到内存)
+ *  参数: 同 jpeg_createMem, jpg、jpgSize 在写完最后一行(或 jpeg_closeLine)时返回
+ *  返回: 行处理指针,NULL失败
+ */
+void *jpeg_createLineMem(unsigned char **jpg, int *jpgSize, int width, int height, int pixelBytes, int quality);
+
 /*
  *  按行rgb数据读、写
  *  参数:
  *      jp: 行处理指针
- *      rgbLine: 行rgb数据,一行长度为width*height*pixelBytes,多行时继续加
- *      line: 要处理的行数
+ *      rgbLine: 行rgb数据,一行长度为width*pixelBytes,多行时连续存放
+ *      line: 要处理的行数,一次处理多行(如 jpeg_lineBatch 返回的行数)可减少libjpeg调用开销
  *  返回:
  *      写图片时返回成功写入行,
  *      读图片时返回实际读取行数,
+ *      数据有误等出错时返回0并提前结束(之后的调用都返回0)
  */
 int jpeg_line(void *jp, unsigned char *rgbLine, int line);
 
+/*
+ *  行处理模式建议的每次读写行数
+ *  返回: iMCU高度(8或16行, 并行编解码时为一个条带的行数),可作为 jpeg_line 及 zoom_stream 的批量行数
+ */
+int jpeg_lineBatch(void *jp);
+
 /*
  *  完毕释放指针
  */
@@ -67,12 +117,56 @@ void jpeg_closeLine(void *jp);
  *  文件缩放
  *  参数:
  *      inFile, outFile: 输入输出文件,类型.jpg.jpeg.JPG.JPEG
- *      zoom: 缩放倍数,0.1到1为缩放,1.0以上放大
+ *      zoom: 缩放倍数,0.1到1为缩放,1.0以上放大(缩小时先按DCT缩放解码)
  *      quality: 输出图片质量,1~100,越大越好,文件越大
+ *  说明: 整幅解码, DCT缩放解码之后余下的倍数按最近点插值的缩放计划处理(同 zoom_plan_create), 再整幅编码
  */
 void jpeg_zoom(char *inFile, char *outFile, float zoom, int quality);
 
+/*
+ *  内存缩放
+ *  参数: 同 jpeg_zoom
+ *      jpg, jpgSize: 输入jpeg数据及字节数
+ *      jpgOut, jpgOutSize: 返回输出jpeg数据及字节数 !! 用完记得free()释放 !!
+ *  返回: 0成功 -1失败
+ */
+int jpeg_zoomMem(const unsigned char *jpg, int jpgSize, unsigned char **jpgOut, int *jpgOutSize, float zoom, int quality);
+
+/*
+ *  流水线文件缩放: 解码、缩放、编码分别在3个线程中同时进行(见 zoom_stream_pipeline), 多核时用时约为各阶段中最慢的一个
+ *  参数: 同 jpeg_zoom
+ *      zt: 缩放方式
+ *      depth: 解码与缩放、缩放与编码之间的队列长度(批数, 一批为 jpeg_lineBatch 行),传0使用默认4批
+ *  说明: 按行解码、编码, 内存占用由队列长度决定, 与图像高度无关(jpeg_zoom 整幅解码);
+ *       缩小时先按DCT缩放解码, 输出尺寸按解码后的尺寸乘余下的倍数计算, 可能与 jpeg_zoom 相差1像素
+ */
+void jpeg_zoomPipeline(char *inFile, char *outFile, float zoom, Zoom_Type zt, int quality, int depth);
+
+/*
+ *  流水线内存缩放
+ *  参数: 同 jpeg_zoomPipeline, jpg 等同 jpeg_zoomMem
+ *  返回: 0成功 -1失败
+ */
+int jpeg_zoomPipelineMem(const unsigned char *jpg, int jpgSize, unsigned char **jpgOut, int *jpgOutSize, float zoom, Zoom_Type zt, int quality, int depth);
+
 //固定放大2.5倍,且要求输入图像宽高为5的整数倍
 void jpeg_zoom2(char *inFile, char *outFile, int quality);
 
+/*
+ *  文件缩放(yuv直通)
+ *  参数: 同 jpeg_zoom
+ *      zt: 缩放方式
+ *  说明: 按原始YCbCr分量数据解码、逐分量缩放后按分量数据编码, 省去rgb与YCbCr之间的两次颜色转换
+ *       和色度的上、下采样; 输出保持输入的采样因子(如4:2:0), 各分量按整幅图像的比例定位;
+ *       输入不是YCbCr或灰度(如CMYK)时改用 jpeg_zoom
+ */
+void jpeg_zoomRaw(char *inFile, char *outFile, float zoom, Zoom_Type zt, int quality);
+
+/*
+ *  内存缩放(yuv直通)
+ *  参数: 同 jpeg_zoomRaw, jpg 等同 jpeg_zoomMem
+ *  返回: 0成功 -1失败
+ */
+int jpeg_zoomRawMem(const unsigned char *jpg, int jpgSize, unsigned char **jpgOut, int *jpgOutSize, float zoom, Zoom_Type zt, int quality);
+
 #endif
@@ -1,17 +1,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include "jpeg.h"
 #include "zoom.h"
+#include "batch.h"
+#include "stats.h"
+#include "trace.h"
 
 /*
- *  模式选择:
- *      0: 使用 jpeg_zoom 缩放(临近点插值)
- *      1: 使用 jpeg + zoom 流模式缩放(临近点插值、双线性插值)
- *      2: 使用 jpeg + zoom 整图加载多线程处理模式(临近点插值、双线性插值)
+ *  模式选择(第一个参数):
+ *      无: 使用 jpeg_zoom 缩放(临近点插值)
+ *      -s: 使用 jpeg + zoom 流模式缩放(临近点插值、双线性插值、双三次、lanczos3、区域平均)
+ *      -w: 使用 jpeg + zoom 整图加载多线程处理模式(临近点插值、双线性插值、双三次、lanczos3、区域平均)
+ *      -b: 批量模式, 见 batch_main()
  */
-#define TEST_MODE 0
 
 #include <sys/time.h>
 long getTickUs(void)
@@ -24,19 +30,162 @@ long getTickUs(void)
 void help(char **argv)
 {
     printf(
-        "Usage: %s [file: .jpg] [zoom: 0.0~1.0~max] [type: 0/near(default) 1/linear]\r\n"
-        "Example: %s ./in.jpg 3\r\n",
-        argv[0], argv[0]);
+        "Usage: %s [-s stream / -w whole image] [file: .jpg] [zoom: 0.0~1.0~max] [type: 0/near(default) 1/linear 2/cubic 3/lanczos3 4/area]\r\n"
+        "Example: %s ./in.jpg 3 (jpeg_zoom, near only) / %s -s ./in.jpg 0.5 1\r\n"
+        "Batch: %s -b [outDir] [zoom] [type] [input: .jpg / dir / @list.txt / - (names from stdin) ...]\r\n"
+        "Example: find ./imgs -name '*.jpg' | %s -b ./thumbs 0.1 4\r\n"
+        "Trace: ZOOM_TRACE=trace.json %s ... (open in chrome://tracing or ui.perfetto.dev)\r\n",
+        argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
 }
 
-#if(TEST_MODE == 0) // 使用 jpeg_zoom 缩放
+// -------------------------- 批量模式 --------------------------
 
-int main(int argc, char **argv)
+//输入文件列表
+typedef struct
+{
+    char **name;
+    int count, size;
+} Batch_List;
+
+static void batch_add(Batch_List *list, const char *name)
+{
+    if (list->count == list->size)
+    {
+        list->size = list->size ? list->size * 2 : 256;
+        list->name = (char **)realloc(list->name, list->size * sizeof(char *));
+    }
+    list->name[list->count++] = strdup(name);
+}
+
+//文件名后缀为 .jpg .jpeg (不分大小写)
+static int batch_isJpeg(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    return dot && (strcasecmp(dot, ".jpg") == 0 || strcasecmp(dot, ".jpeg") == 0);
+}
+
+//每行一个文件名(列表文件或stdin), 去掉行尾换行, 跳过空行
+static void batch_addLines(Batch_List *list, FILE *fp)
+{
+    char line[1024];
+    int len;
+    while (fgets(line, sizeof(line), fp))
+    {
+        len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = 0;
+        if (len > 0)
+            batch_add(list, line);
+    }
+}
+
+//目录下的jpeg文件(不进入子目录)
+static void batch_addDir(Batch_List *list, const char *dir)
+{
+    char path[1024];
+    struct dirent *ent;
+    DIR *dp = opendir(dir);
+    if (!dp)
+    {
+        fprintf(stderr, "batch: can't open %s\n", dir);
+        return;
+    }
+    while ((ent = readdir(dp)))
+    {
+        if (batch_isJpeg(ent->d_name))
+        {
+            snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+            batch_add(list, path);
+        }
+    }
+    closedir(dp);
+}
+
+static void batch_addInput(Batch_List *list, const char *input)
+{
+    struct stat st;
+    FILE *fp;
+    if (strcmp(input, "-") == 0)
+        batch_addLines(list, stdin);
+    else if (input[0] == '@')
+    {
+        if ((fp = fopen(input + 1, "r")) == NULL)
+        {
+            fprintf(stderr, "batch: can't open %s\n", input + 1);
+            return;
+        }
+        batch_addLines(list, fp);
+        fclose(fp);
+    }
+    else if (stat(input, &st) == 0 && S_ISDIR(st.st_mode))
+        batch_addDir(list, input);
+    else
+        batch_add(list, input);
+}
+
+//每个文件的处理结果
+static void batch_report(void *obj, int index, int status, int width, int height)
+{
+    Batch_List *list = (Batch_List *)obj;
+    static const char *err[] = {"ok", "read failed", "zoom failed", "write failed", "same name, skipped"};
+    if (status == ZB_OK)
+        printf("[ok] %s / %dx%d \r\n", list->name[index], width, height);
+    else
+        printf("[%s] %s \r\n", err[-status], list->name[index]);
+}
+
+int batch_main(int argc, char **argv)
 {
     long tickUs1, tickUs2;
+    Batch_List list = {0};
+    //缩放倍数: 0~1缩小,等于1不变,大于1放大
+    float zm;
+    //缩放方式: 默认使用最近插值
+    Zoom_Type zt = ZT_NEAR;
+    int i, ok;
+    //传参检查
+    if (argc < 4)
+    {
+        help(argv);
+        return 0;
+    }
+    zm = atof(argv[3]);
+    if (argc > 4)
+        zt = atoi(argv[4]);
+    //输入: 文件、目录、列表文件, 没有时从stdin读取文件名
+    for (i = 5; i < argc; i++)
+        batch_addInput(&list, argv[i]);
+    if (argc < 6)
+        batch_addInput(&list, "-");
+    //输出目录
+    mkdir(argv[2], 0755);
+    printf("batch: %d files / output %s / zoom %.2f / type %d \r\n", list.count, argv[2], zm, zt);
+    //用时
+    tickUs1 = getTickUs();
+    ok = zoom_batch(list.name, list.count, argv[2], zm, zt, 75, &batch_report, &list);
+    //用时
+    tickUs2 = getTickUs();
+    printf("batch: %d/%d ok / total time %.3fms / %.1f files/s \r\n",
+           ok, list.count, (float)(tickUs2 - tickUs1) / 1000,
+           tickUs2 > tickUs1 ? list.count * 1000000.0 / (tickUs2 - tickUs1) : 0.0);
+    //内存回收
+    for (i = 0; i < list.count; i++)
+        free(list.name[i]);
+    free(list.name);
+    return ok == list.count ? 0 : 1;
+}
+
+// -------------------------- 单张缩放 --------------------------
+
+//使用 jpeg_zoom 缩放
+int zoom_main(int argc, char **argv)
+{
+    long tickUs1, tickUs2;
+    //分阶段统计
+    Zoom_Stats stats = {0};
     //缩放倍数: 0~1缩小,等于1不变,大于1放大
     float zm = 1.0;
-    printf("mode 0 \r\n");
+    printf("mode: jpeg_zoom \r\n");
     //传参检查
     if (argc < 3)
     {
@@ -47,20 +196,26 @@ int main(int argc, char **argv)
     zm = atof(argv[2]);
     //用时
     tickUs1 = getTickUs();
+    zoom_stats_begin(&stats);
     //开始缩放
     jpeg_zoom(argv[1], "./out.jpg", zm, 75);
     // jpeg_zoom2(argv[1], "./out.jpg", 75);
+    // jpeg_zoomRaw(argv[1], "./out.jpg", zm, ZT_LINEAR, 75);
+    // jpeg_zoomPipeline(argv[1], "./out.jpg", zm, ZT_NEAR, 75, 0);
     //用时
+    zoom_stats_end();
     tickUs2 = getTickUs();
     printf("total time: %.3fms \r\n", (float)(tickUs2 - tickUs1) / 1000);
+    zoom_stats_print(&stats);
     return 0;
 }
 
-#elif(TEST_MODE == 1) //使用 jpeg + zoom 流模式缩放
-
-int main(int argc, char **argv)
+//使用 jpeg + zoom 流模式缩放
+int stream_main(int argc, char **argv)
 {
     long tickUs1, tickUs2, tickUs3, tickUs4;
+    //分阶段统计
+    Zoom_Stats stats = {0};
     void *jpSrc = NULL, *jpDist = NULL;
     //输入图像参数
     int width = 0, height = 0, pb = 3;
@@ -70,7 +225,7 @@ int main(int argc, char **argv)
     float zm = 1.0;
     //缩放方式: 默认使用最近插值
     Zoom_Type zt = ZT_NEAR;
-    printf("mode 1 \r\n");
+    printf("mode: stream \r\n");
     //传参检查
     if (argc < 3)
     {
@@ -79,15 +234,16 @@ int main(int argc, char **argv)
     }
     //用时
     tickUs1 = getTickUs();
+    zoom_stats_begin(&stats);
     //缩放倍数
     zm = atof(argv[2]);
     //缩放方式
     if (argc > 3)
         zt = atoi(argv[3]);
-    //解文件
-    jpSrc = jpeg_getLine(argv[1], &width, &height, &pb);
-    printf("input: %s / %dx%dx%d bytes / zoom %.2f / type %d \r\n",
-           argv[1], width, height, pb, zm, zt);
+    printf("input: %s / zoom %.2f / type %d \r\n", argv[1], zm, zt);
+    //解文件(缩小时按DCT缩放解码, zm 返回余下的缩放倍数)
+    jpSrc = jpeg_getLine(argv[1], &width, &height, &pb, &zm);
+    printf("decode: %dx%dx%d bytes / zoom %.2f \r\n", width, height, pb, zm);
     //输出流准备
     if (jpSrc)
         jpDist = jpeg_createLine("./out.jpg", (int)(width * zm), (int)(height * zm), pb, 75);
@@ -98,7 +254,8 @@ int main(int argc, char **argv)
     {
         zoom_stream(
             jpSrc, jpDist, &jpeg_line, &jpeg_line,
-            width, height, &outWidth, &outHeight, zm, zt);
+            width, height, &outWidth, &outHeight, zm, zt,
+            pb == 1 ? ZF_GRAY : ZF_RGB, jpeg_lineBatch(jpSrc));
     }
     //用时
     tickUs3 = getTickUs();
@@ -106,19 +263,22 @@ int main(int argc, char **argv)
     jpeg_closeLine(jpSrc);
     jpeg_closeLine(jpDist);
     //用时
+    zoom_stats_end();
     tickUs4 = getTickUs();
     printf("output: out.jpg / %dx%dx%d bytes / zoom time %.3fms / total time %.3fms\r\n",
            outWidth, outHeight, pb,
            (float)(tickUs3 - tickUs2) / 1000,
            (float)(tickUs4 - tickUs1) / 1000);
+    zoom_stats_print(&stats);
     return 0;
 }
 
-#elif(TEST_MODE == 2) // 使用 jpeg + zoom 整图加载多线程处理模式
-
-int main(int argc, char **argv)
+//使用 jpeg + zoom 整图加载多线程处理模式
+int whole_main(int argc, char **argv)
 {
     long tickUs1, tickUs2, tickUs3, tickUs4;
+    //分阶段统计
+    Zoom_Stats stats = {0};
     //输入图像参数
     unsigned char *map = NULL;
     int width = 0, height = 0, pb = 3;
@@ -129,7 +289,7 @@ int main(int argc, char **argv)
     float zm = 1.0;
     //缩放方式: 默认使用最近插值
     Zoom_Type zt = ZT_NEAR;
-    printf("mode 2 \r\n");
+    printf("mode: whole \r\n");
     if (argc < 3)
     {
         help(argv);
@@ -137,20 +297,21 @@ int main(int argc, char **argv)
     }
     //用时
     tickUs1 = getTickUs();
+    zoom_stats_begin(&stats);
     //缩放倍数
     zm = atof(argv[2]);
     //缩放方式
     if (argc > 3)
         zt = atoi(argv[3]);
-    //解文件
-    map = jpeg_get(argv[1], &width, &height, &pb);
-    printf("input: %s / %dx%dx%d bytes / zoom %.2f / type %d \r\n",
-           argv[1], width, height, pb, zm, zt);
+    printf("input: %s / zoom %.2f / type %d \r\n", argv[1], zm, zt);
+    //解文件(缩小时按DCT缩放解码, zm 返回余下的缩放倍数)
+    map = jpeg_get(argv[1], &width, &height, &pb, &zm);
+    printf("decode: %dx%dx%d bytes / zoom %.2f \r\n", width, height, pb, zm);
     //用时
     tickUs2 = getTickUs();
     //缩放
     if (map)
-        outMap = zoom(map, width, height, &outWidth, &outHeight, zm, zt);
+        outMap = zoom(map, width, height, &outWidth, &outHeight, zm, zt, pb == 1 ? ZF_GRAY : ZF_RGB);
     //用时
     tickUs3 = getTickUs();
     //输出文件
@@ -158,11 +319,13 @@ int main(int argc, char **argv)
     {
         jpeg_create("./out.jpg", outMap, outWidth, outHeight, pb, 75);
         //用时
+        zoom_stats_end();
         tickUs4 = getTickUs();
         printf("output: out.jpg / %dx%dx%d bytes / zoom time %.3fms / total time %.3fms\r\n",
                outWidth, outHeight, pb,
                (float)(tickUs3 - tickUs2) / 1000,
                (float)(tickUs4 - tickUs1) / 1000);
+        zoom_stats_print(&stats);
     }
     else
         printf("Error: zoom failed !!\r\n");
@@ -175,4 +338,27 @@ int main(int argc, char **argv)
     return 0;
 }
 
-#endif
\ No newline at end of file
+int main(int argc, char **argv)
+{
+    //环境变量 ZOOM_TRACE 指定时间线输出文件(chrome://tracing 或 ui.perfetto.dev 打开)
+    char *trace = getenv("ZOOM_TRACE");
+    int ret;
+
+    if (trace)
+        zoom_trace_begin(0);
+    //批量模式
+    if (argc > 1 && strcmp(argv[1], "-b") == 0)
+        ret = batch_main(argc, argv);
+    //流模式、整图模式: 去掉模式参数, 其余参数同 jpeg_zoom 模式
+    else if (argc > 1 && (strcmp(argv[1], "-s") == 0 || strcmp(argv[1], "-w") == 0))
+    {
+        int stream = argv[1][1] == 's';
+        argv[1] = argv[0];
+        ret = stream ? stream_main(argc - 1, argv + 1) : whole_main(argc - 1, argv + 1);
+    }
+    else
+        ret = zoom_main(argc, argv);
+    if (trace)
+        printf("trace: %d events -> %s \r\n", zoom_trace_end(trace), trace);
+    return ret;
+}
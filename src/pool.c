@@ -0,0 +1,156 @@
+/*
+ *  常驻线程池
+ *  任务序号在锁内分配, 完成计数到达任务数时用条件变量唤醒调用者, 不做轮询等待
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/sysinfo.h> // get_nprocs() 获取有效cpu 核心数
+
+#include "pool.h"
+#include "stats.h"
+
+typedef struct Pool_Job
+{
+    void (*callback)(void *, int);
+    void *obj;
+    int count;  // 任务数
+    int next;   // 下一个待领取的序号
+    int finish; // 已完成任务数
+    pthread_cond_t done;
+    struct Pool_Job *link; // 队列中的下一组任务
+} Pool_Job;
+
+static pthread_once_t _pool_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t _pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _pool_wake = PTHREAD_COND_INITIALIZER;
+static Pool_Job *_pool_queue = NULL;
+static int _pool_threads = 1;
+static int _pool_limit = 0;
+
+//领取一个任务序号(需持锁),领完最后一个序号时移出队列
+static int _pool_take(Pool_Job *job)
+{
+    Pool_Job **pp;
+    int index = job->next++;
+    if (job->next == job->count)
+    {
+        for (pp = &_pool_queue; *pp; pp = &(*pp)->link)
+        {
+            if (*pp == job)
+            {
+                *pp = job->link;
+                break;
+            }
+        }
+    }
+    return index;
+}
+
+//执行一个任务并计数(需持锁,执行期间释放锁)
+static void _pool_exec(Pool_Job *job, int index)
+{
+    pthread_mutex_unlock(&_pool_lock);
+    job->callback(job->obj, index);
+    pthread_mutex_lock(&_pool_lock);
+    if (++job->finish == job->count)
+        pthread_cond_signal(&job->done);
+}
+
+static void *_pool_worker(void *arg)
+{
+    Pool_Job *job;
+    pthread_mutex_lock(&_pool_lock);
+    while (1)
+    {
+        while (!_pool_queue)
+            pthread_cond_wait(&_pool_wake, &_pool_lock);
+        job = _pool_queue;
+        _pool_exec(job, _pool_take(job));
+    }
+    return NULL;
+}
+
+static void _pool_init(void)
+{
+    pthread_t th;
+    pthread_attr_t attr;
+    int i, ret;
+
+    //禁用线程同步,工作线程常驻
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    //调用线程也参与执行,少抛一个线程
+    for (i = 1; i < get_nprocs(); i++)
+    {
+        ret = pthread_create(&th, &attr, &_pool_worker, NULL);
+        if (ret != 0)
+        {
+            printf("pool_init: pthread_create failed !! %s\r\n", strerror(ret));
+            break;
+        }
+        _pool_threads += 1;
+    }
+    pthread_attr_destroy(&attr);
+}
+
+int pool_threads(void)
+{
+    pthread_once(&_pool_once, &_pool_init);
+    if (_pool_limit > 0 && _pool_limit < _pool_threads)
+        return _pool_limit;
+    return _pool_threads;
+}
+
+void pool_limit(int threads)
+{
+    _pool_limit = threads > 0 ? threads : 0;
+}
+
+void pool_run(void (*callback)(void *, int), void *obj, int count)
+{
+    Pool_Job **pp;
+    Pool_Job job = {
+        .callback = callback,
+        .obj = obj,
+        .count = count,
+    };
+    Zoom_Stats *st;
+    long long tick;
+    int i;
+
+    if (count < 1)
+        return;
+
+    //单任务或单核,直接在当前线程执行
+    if (count == 1 || pool_threads() < 2)
+    {
+        for (i = 0; i < count; i++)
+            callback(obj, i);
+        return;
+    }
+
+    pthread_cond_init(&job.done, NULL);
+    pthread_mutex_lock(&_pool_lock);
+
+    //排到队尾,唤醒工作线程
+    for (pp = &_pool_queue; *pp; pp = &(*pp)->link)
+        ;
+    *pp = &job;
+    pthread_cond_broadcast(&_pool_wake);
+
+    //调用线程也领取任务,避免嵌套调用时所有线程都在等待
+    while (job.next < job.count)
+        _pool_exec(&job, _pool_take(&job));
+
+    //等待其它线程手上的任务完成
+    st = zoom_stats_current();
+    tick = zoom_stats_tick(st);
+    while (job.finish < job.count)
+        pthread_cond_wait(&job.done, &_pool_lock);
+    zoom_stats_stage(st, ZS_POOL, tick);
+
+    pthread_mutex_unlock(&_pool_lock);
+    pthread_cond_destroy(&job.done);
+}
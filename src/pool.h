@@ -0,0 +1,31 @@
+/*
+ *  常驻线程池(首次使用时创建, 之后所有调用者共用)
+ */
+#ifndef _POOL_H_
+#define _POOL_H_
+
+/*
+ *  并行执行一组任务
+ *  参数:
+ *      callback: 任务函数, 函数原型 void callback(void *obj, int index)
+ *      obj: 用户私有参数, 在调用callback时传回给用户
+ *      count: 任务数, index 为 0 ~ count - 1, 每个序号只执行一次
+ *  说明: 调用线程也参与执行, 全部任务完成后才返回;
+ *       可被多个线程同时调用, 也可在任务函数中嵌套调用
+ */
+void pool_run(void (*callback)(void *, int), void *obj, int count);
+
+/*
+ *  返回: 参与并行的线程数(工作线程 + 调用线程), 即cpu可用核心数
+ */
+int pool_threads(void);
+
+/*
+ *  限制参与并行的线程数(如性能测试时按不同线程数对比)
+ *  参数:
+ *      threads: 1 ~ cpu核心数, 传0取消限制
+ *  说明: 只影响之后创建的缩放计划和数据流, 工作线程本身常驻不变
+ */
+void pool_limit(int threads);
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ *  分阶段耗时、计数统计
+ *  统计结构按线程绑定, 各函数入口取一次当前结构, 未绑定时不做任何统计
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "stats.h"
+
+static __thread Zoom_Stats *_stats_current = NULL;
+
+static const char *_stats_names[ZS_STAGES] = {
+    "prepare",
+    "decode",
+    "resample",
+    "encode",
+    "read wait",
+    "write wait",
+    "pool wait",
+};
+
+void zoom_stats_begin(Zoom_Stats *st)
+{
+    _stats_current = st;
+}
+
+Zoom_Stats *zoom_stats_end(void)
+{
+    Zoom_Stats *st = _stats_current;
+    _stats_current = NULL;
+    return st;
+}
+
+Zoom_Stats *zoom_stats_current(void)
+{
+    return _stats_current;
+}
+
+long long zoom_stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+const char *zoom_stats_name(Zoom_Stage stage)
+{
+    if (stage < 0 || stage >= ZS_STAGES)
+        return "unknown";
+    return _stats_names[stage];
+}
+
+void zoom_stats_print(const Zoom_Stats *st)
+{
+    int i;
+    if (!st)
+        return;
+    for (i = 0; i < ZS_STAGES; i++)
+    {
+        if (st->ns[i] > 0)
+            printf("  %-10s: %.3fms \r\n", _stats_names[i], st->ns[i] / 1e6);
+    }
+    printf("  rows      : %lld in / %lld out \r\n", st->rowsIn, st->rowsOut);
+    printf("  memory    : %.1fKB \r\n", st->bytes / 1024.0);
+    printf("  threads   : %d \r\n", st->threads);
+}
@@ -0,0 +1,115 @@
+/*
+ *  分阶段耗时、计数统计(可选)
+ *  调用线程用 zoom_stats_begin() 绑定统计结构后, 其间调用的 zoom、zoom_stream*、jpeg_* 函数把各阶段耗时累加进来;
+ *  未绑定时每次调用只多一次线程变量判断, 不取时间也不计数; 时间线记录(trace.h)打开时各阶段同时记为事件
+ */
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include "trace.h"
+
+//统计阶段
+typedef enum
+{
+    ZS_PREPARE = 0, //缩放准备: 定位表、系数表、线程私有缓存、输出缓冲
+    ZS_DECODE,      //jpeg解码(含文件头解析)
+    ZS_RESAMPLE,    //缩放计算(单线程数据流不含回调等待; 多线程时为调用线程从分发到全部完成的时间, 与各项等待重叠)
+    ZS_ENCODE,      //jpeg编码
+    ZS_READ,        //数据流等待源数据回调 srcRead/srcBorrow 的时间(源为jpeg_line时与 ZS_DECODE 重叠)
+    ZS_WRITE,       //数据流等待输出回调 distWrite 的时间(输出为jpeg_line时与 ZS_ENCODE 重叠)
+    ZS_POOL,        //线程池: 调用线程做完能领取的任务后等待其它线程的时间
+    ZS_STAGES,
+} Zoom_Stage;
+
+typedef struct
+{
+    long long ns[ZS_STAGES]; //各阶段累计纳秒
+    long long rowsIn;        //读入、解码的源图像行数
+    long long rowsOut;       //输出、编码的行数
+    long long bytes;         //分配的内存字节数(缓冲、系数表、输出图像、编解码器图像内存)
+    int threads;             //参与计算的最多线程数
+} Zoom_Stats;
+
+/*
+ *  开始统计: 绑定到调用线程, 之后本线程调用的缩放、编解码函数累加到 st(不清零, 需要时先memset)
+ *  说明: 多线程任务由调用线程代为统计, 工作线程上的回调等待也记入同一结构
+ */
+void zoom_stats_begin(Zoom_Stats *st);
+
+/*
+ *  结束统计, 解除绑定
+ *  返回: zoom_stats_begin() 绑定的结构, 未绑定返回NULL
+ */
+Zoom_Stats *zoom_stats_end(void);
+
+/*
+ *  阶段名称, 如 "decode"
+ */
+const char *zoom_stats_name(Zoom_Stage stage);
+
+/*
+ *  打印统计结果(一行一项)
+ */
+void zoom_stats_print(const Zoom_Stats *st);
+
+// -------------------------- 内部使用 --------------------------
+
+/*
+ *  返回: 调用线程绑定的统计结构, 未绑定返回NULL(各函数入口取一次, 之后只判断这个指针)
+ */
+Zoom_Stats *zoom_stats_current(void);
+
+/*
+ *  返回: 单调时钟纳秒
+ */
+long long zoom_stats_now(void);
+
+//阶段计时起点, 未统计也未记录时间线时不取时间(返回0)
+static inline long long zoom_stats_tick(Zoom_Stats *st)
+{
+    return (st || zoom_trace_on()) ? zoom_stats_now() : 0;
+}
+
+//累加耗时(不记录时间线事件, 用于扣除了其它阶段的耗时)
+static inline void zoom_stats_add(Zoom_Stats *st, Zoom_Stage stage, long long ns)
+{
+    if (st)
+        __atomic_fetch_add(&st->ns[stage], ns, __ATOMIC_RELAXED);
+}
+
+//累加从 tick 到现在的耗时, 并记为时间线事件(可在任意线程调用)
+static inline void zoom_stats_stage(Zoom_Stats *st, Zoom_Stage stage, long long tick)
+{
+    long long now;
+    if (tick)
+    {
+        now = zoom_stats_now();
+        zoom_stats_add(st, stage, now - tick);
+        if (zoom_trace_on())
+            zoom_trace_event(zoom_stats_name(stage), -1, tick, now);
+    }
+}
+
+static inline void zoom_stats_rows(Zoom_Stats *st, long long rowsIn, long long rowsOut)
+{
+    if (st)
+    {
+        __atomic_fetch_add(&st->rowsIn, rowsIn, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&st->rowsOut, rowsOut, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void zoom_stats_bytes(Zoom_Stats *st, long long bytes)
+{
+    if (st)
+        __atomic_fetch_add(&st->bytes, bytes, __ATOMIC_RELAXED);
+}
+
+//记录参与线程数(取最大)
+static inline void zoom_stats_threads(Zoom_Stats *st, int threads)
+{
+    if (st && st->threads < threads)
+        st->threads = threads;
+}
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ *  时间线记录
+ *  每个线程第一次记录时分配自己的事件缓冲并用CAS挂到全局链表, 之后只写自己的缓冲;
+ *  缓冲不随记录结束释放, 下次开始记录时由所属线程清空后继续使用
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "stats.h"
+
+// 每个线程默认最多记录的事件数
+#define TRACE_EVENTS_DEFAULT 65536
+
+typedef struct
+{
+    const char *name;
+    int arg;
+    long long begin, end;
+} Trace_Event;
+
+//线程的事件缓冲
+typedef struct Trace_Buf
+{
+    struct Trace_Buf *next;
+    int tid;     //轨道序号(按第一次记录的先后)
+    int session; //缓冲内容所属的记录序号, 与当前不同时先清空
+    int size, count, dropped;
+    Trace_Event *events;
+} Trace_Buf;
+
+int _zoom_trace_on = 0;
+
+static int _trace_session = 0;
+static int _trace_size = TRACE_EVENTS_DEFAULT;
+static long long _trace_begin = 0;
+static int _trace_tids = 0;
+static Trace_Buf *_trace_list = NULL;
+static __thread Trace_Buf *_trace_buf = NULL;
+
+int zoom_trace_begin(int events)
+{
+    if (zoom_trace_on())
+        return -1;
+    _trace_size = events > 0 ? events : TRACE_EVENTS_DEFAULT;
+    _trace_session += 1;
+    _trace_begin = zoom_stats_now();
+    __atomic_store_n(&_zoom_trace_on, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+//调用线程的缓冲, 第一次记录时创建并登记
+static Trace_Buf *_trace_thread_buf(void)
+{
+    Trace_Buf *b = _trace_buf;
+    if (!b)
+    {
+        b = (Trace_Buf *)calloc(1, sizeof(Trace_Buf));
+        if (!b)
+            return NULL;
+        b->tid = __atomic_add_fetch(&_trace_tids, 1, __ATOMIC_RELAXED);
+        b->next = __atomic_load_n(&_trace_list, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&_trace_list, &b->next, b, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+        _trace_buf = b;
+    }
+    //新的一次记录: 清空, 容量不同时重新分配
+    if (b->session != _trace_session)
+    {
+        if (b->size != _trace_size)
+        {
+            free(b->events);
+            b->events = (Trace_Event *)malloc(_trace_size * sizeof(Trace_Event));
+            b->size = b->events ? _trace_size : 0;
+        }
+        b->count = b->dropped = 0;
+        b->session = _trace_session;
+    }
+    return b;
+}
+
+void zoom_trace_event(const char *name, int arg, long long begin, long long end)
+{
+    Trace_Buf *b;
+    Trace_Event *e;
+
+    if (!zoom_trace_on() || !(b = _trace_thread_buf()))
+        return;
+    if (b->count == b->size)
+    {
+        b->dropped += 1;
+        return;
+    }
+    e = &b->events[b->count++];
+    e->name = name;
+    e->arg = arg;
+    e->begin = begin;
+    e->end = end;
+}
+
+int zoom_trace_end(const char *path)
+{
+    Trace_Buf *b;
+    Trace_Event *e;
+    FILE *fp;
+    int i, total = 0, dropped = 0, first = 1;
+
+    if (!zoom_trace_on())
+        return -1;
+    __atomic_store_n(&_zoom_trace_on, 0, __ATOMIC_RELEASE);
+
+    fp = fopen(path, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "zoom_trace_end: can't open %s\n", path);
+        return -1;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (b = __atomic_load_n(&_trace_list, __ATOMIC_ACQUIRE); b; b = b->next)
+    {
+        if (b->session != _trace_session)
+            continue;
+        //轨道名: 结束记录的线程为调用线程
+        fprintf(fp, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+                first ? "" : ",", b->tid, b == _trace_buf ? "caller" : "thread", b->tid);
+        first = 0;
+        for (i = 0; i < b->count; i++)
+        {
+            e = &b->events[i];
+            fprintf(fp, ",\n{\"name\": \"%s\", \"cat\": \"zoom\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                    e->name, b->tid, (e->begin - _trace_begin) / 1000.0, (e->end - e->begin) / 1000.0);
+            if (e->arg >= 0)
+                fprintf(fp, ", \"args\": {\"n\": %d}", e->arg);
+            fprintf(fp, "}");
+        }
+        total += b->count;
+        dropped += b->dropped;
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    if (dropped > 0)
+        fprintf(stderr, "zoom_trace_end: %d events dropped, buffer full\n", dropped);
+    return total;
+}
@@ -0,0 +1,45 @@
+/*
+ *  时间线记录(可选), 输出 Chrome/Perfetto 的 trace json(chrome://tracing 或 ui.perfetto.dev 打开)
+ *  每个线程一条轨道: 分块计算、数据流任务、回调等待、线程池等待、jpeg编解码各阶段;
+ *  每个线程写自己的事件缓冲, 记录时不加锁, 只有线程第一次记录时登记一次缓冲
+ */
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+/*
+ *  开始记录
+ *  参数:
+ *      events: 每个线程最多记录的事件数, 传0使用默认65536, 记满后丢弃(输出时报告丢弃数)
+ *  返回: 0成功 -1已在记录
+ */
+int zoom_trace_begin(int events);
+
+/*
+ *  结束记录并写出json
+ *  参数:
+ *      path: 输出文件路径
+ *  返回: 写出的事件数, -1失败
+ *  说明: 须在被记录的缩放、编解码调用都返回之后调用
+ */
+int zoom_trace_end(const char *path);
+
+// -------------------------- 内部使用 --------------------------
+
+extern int _zoom_trace_on;
+
+//是否在记录
+static inline int zoom_trace_on(void)
+{
+    return __atomic_load_n(&_zoom_trace_on, __ATOMIC_RELAXED);
+}
+
+/*
+ *  记录调用线程的一段事件
+ *  参数:
+ *      name: 事件名(须为常量字符串, 输出时才读取)
+ *      arg: 附加数值(如分块序号、起始行), 小于0不输出
+ *      begin, end: zoom_stats_now() 取得的起止时间
+ */
+void zoom_trace_event(const char *name, int arg, long long begin, long long end);
+
+#endif
@@ -1,491 +1,2331 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 #include <math.h>
 #include <pthread.h>
-#include <sys/sysinfo.h> // get_nprocs() 获取有效cpu 核心数
+#include <unistd.h> // sysconf() 获取L2缓存大小
 
 #include "zoom.h"
+#include "zoom_kernel.h"
+#include "pool.h"
+#include "stats.h"
 
-// 原版计算方式
-#define LINEAR1(p11, p12, p21, p22, le, re, ue, de) \
-(unsigned char)((p11 * re + p12 * le) * de + (p21 * re + p22 * le) * ue)
+// 卷积滤波(双三次、lanczos)定点精度: 权重Q14, 水平滤波结果保留Q7
+#define ZOOM_F_BITS 14
+#define ZOOM_H_BITS 7
 
-// 简化版,用re替换le后
-#define LINEAR2(p11, p12, p21, p22, re, ue, de) \
-(unsigned char)((p12 + re * (p11 - p12)) * de + (p22 + re * (p21 - p22)) * ue)
+// 数据流默认每批读写的行数(与libjpeg的iMCU高度8或16对齐最合适), 并行数据流每个任务也处理这么多输出行
+#define ZOOM_BATCH_LINES 8
 
-// 选择一种计算方式
-// #define LINEAR(p11, p12, p21, p22, le, re, ue, de) LINEAR1(p11, p12, p21, p22, le, re, ue, de)
-#define LINEAR(p11, p12, p21, p22, le, re, ue, de) LINEAR2(p11, p12, p21, p22, re, ue, de)
+// 流水线数据流默认的队列长度(批数)
+#define ZOOM_PIPE_DEPTH 4
 
+// 有理数倍率 p/q 的识别范围(2、3、1.5、2.5、0.5、0.25、2/3 等)
+#define ZOOM_RATIO_P 8
+#define ZOOM_RATIO_Q 4
+
+// 分块执行: 取不到L2缓存大小时按256KB估算, 每线程至少分到4块以便均衡, 块高不少于8行(换块要重新准备缓存行)
+#define ZOOM_L2_DEFAULT (256 * 1024)
+#define ZOOM_TILE_PER_THREAD 4
+#define ZOOM_TILE_MIN_H 8
+#define ZOOM_TILE_ALIGN 16
+
+// 区域平均权重精度Q12, 水平、垂直两次加权后累加值最大 255 << 24, 32位无符号不溢出
+#define ZOOM_A_BITS 12
+
+//卷积滤波系数表(行或列, 每种几何尺寸计算一次)
+typedef struct
+{
+    int taps;      //每个输出点的抽头数
+    int *start;    //每个输出点第一个抽头对应的源序号, 抽头序号连续且不越界
+    short *weight; //每个输出点taps个权重(Q14), 和为 1 << ZOOM_F_BITS
+} Zoom_Filter;
+
+//卷积滤波的线程私有缓存: 最近taps行源图像的水平滤波结果, 每行源图像只做一次水平滤波
+typedef struct
+{
+    int *rows;  //taps行, 每行 widthOut * 通道数 个值
+    int *rowOf; //每个缓存行对应的源行号, -1 为空
+    int **win;  //当前输出行用到的taps行
+} Zoom_Scratch;
+
+//区域平均的线程私有缓存: 最近一行源图像的水平加权和, 及输出行累加值
+typedef struct
+{
+    unsigned int *hrow;
+    int hrowOf;
+    unsigned int *acc;
+} Zoom_Area;
+
+//双线性、最近点插值纵向放大时的线程私有缓存: 每行源图像只做一次水平插值, 相同的输出行直接拷贝
+typedef struct
+{
+    unsigned short *rows; //双线性: 2行水平插值结果(Q8), 每行 widthOut * 通道数 个值, 第sy行存放在 sy % 2
+    int rowOf[2];         //每个缓存行对应的源行号, -1 为空
+    unsigned char *out;   //最近点: 最近一次输出行
+    int outOf;            //out对应的源行号, -1 为空
+} Zoom_Hcache;
+
+//获取源图像第sy行数据的指针
+typedef unsigned char *(*Zoom_Line)(void *obj, int sy);
+
+//数据流源图像行读取: 按批调用srcRead, 两个批缓冲轮流读入, 当前批的前一行仍在另一个缓冲中
+typedef struct
+{
+    void *obj;
+    int (*srcRead)(void *, unsigned char *, int);
+    unsigned char *buf[2]; //各 batch 行
+    int first[2];          //缓冲第0行对应的源行号
+    int rows[2];           //缓冲中有效行数
+    int cur;               //最近读入的缓冲
+    int rowSize;           //每行字节数
+    int height, batch;
+    int end; //源数据已读完(或读取失败)
+} Zoom_Src;
+
+//数据流源图像行借用: 直接读取用户内存中的行, 最近借出的2行
+typedef struct
+{
+    void *obj;
+    unsigned char *(*srcBorrow)(void *, int);
+    void (*srcRelease)(void *, int);
+    int sy[2]; //sy[0] < sy[1], -1为空
+    unsigned char *row[2];
+    unsigned char *blank; //借用失败且没有可沿用的行时使用
+} Zoom_Borrow;
+
+//按像素格式特化的卷积滤波、区域平均行函数(通道数为编译期常量, 见 _zoom_pixel)
+typedef struct
+{
+    int bpp; //每像素字节数(通道数)
+    //水平滤波、区域平均水平求和: 输出第x0~x1-1点
+    void (*filter_h)(const Zoom_Filter *f, const unsigned char *line, int *out, int x0, int x1);
+    void (*area_h)(const Zoom_Filter *f, const unsigned char *line, unsigned int *out, int x0, int x1);
+    //垂直滤波: count为通道值个数
+    void (*filter_v)(const short *w, int taps, int **win, unsigned char *out, int count);
+} Zoom_Pixel;
+
+typedef struct Zoom_Info Zoom_Info;
+struct Zoom_Info
+{
+    //输入输出图像信息
+    unsigned char *rgb;
+    int width, height;
+    unsigned char *rgbOut;
+    int widthOut, heightOut;
+    //像素格式及每像素字节数(通道数)
+    Zoom_Format zf;
+    int bpp;
+    const Zoom_Pixel *pixel;
+    //列、行定位比例: 输出坐标 * num / den 为源坐标, 为0时取 源尺寸 / 输出尺寸(yuv色度平面按亮度的比例定位)
+    int xNum, xDen, yNum, yDen;
+    //行、列定位表(每次调用计算一次,避免逐像素浮点运算)
+    Zoom_Step *xTable, *yTable;
+    //列定位表为有理数倍率时的重复模式,NULL不使用
+    Zoom_Ratio *xRatio;
+    //行、列卷积系数表(双三次、lanczos、区域平均)
+    Zoom_Filter *xFilter, *yFilter;
+    //行处理内核
+    const Zoom_Kernel *kernel;
+    //输出一行的第x0~x1-1点: worker为线程序号,用于选择私有缓存, out为输出行起点, line(obj, sy)获取源图像行
+    void (*row)(Zoom_Info *info, int worker, int y, int x0, int x1, unsigned char *out, Zoom_Line line, void *obj);
+    //每个线程私有的缓存(卷积滤波、区域平均、横向插值)
+    Zoom_Scratch *scratch;
+    Zoom_Area *area;
+    Zoom_Hcache *hcache;
+};
+
+//线程待处理的分块序号范围[head, tail), 空闲线程从剩余最多的线程尾部取走一半
+typedef struct
+{
+    int head, tail;
+} Zoom_Queue;
+
+//缩放计划: 同一几何尺寸反复缩放时, 定位表、系数表、缓存和分块只准备一次
+struct Zoom_Plan
+{
+    Zoom_Info info;
+    Zoom_Type zt;
+    //分块: 块宽、块高(输出像素), 每行块数, 总块数(按行优先编号)
+    int tileW, tileH;
+    int tilesX, tiles;
+    //参与线程数及各自的分块队列
+    int threads;
+    Zoom_Queue *queue;
+    pthread_mutex_t lock;
+};
+
+//分配内存(清零), 统计时计入分配字节数
+static void *_zoom_calloc(size_t count, size_t size)
+{
+    zoom_stats_bytes(zoom_stats_current(), (long long)count * size);
+    return calloc(count, size);
+}
+
+/*
+ *  识别有理数倍率: 输出尺寸正好是源尺寸的 p/q 倍(src * p == dist * q, 如 jpeg_zoom2 的 5/2)
+ *  返回: 1是(p、q为最简分数, 优先取最小的q) 0否
+ *  说明: 只认整除的尺寸, 此时 i * src / dist 每p点严格重复, 重复模式与定位表逐点一致;
+ *       仅取整后接近 p/q 的尺寸(如 7->3)不算, 仍按定位表处理
+ */
+static int _zoom_ratio(int src, int dist, int *p, int *q)
+{
+    int a, b, x, y, t;
+    for (b = 1; b <= ZOOM_RATIO_Q; b++)
+    {
+        for (a = 1; a <= ZOOM_RATIO_P; a++)
+        {
+            //最简分数
+            for (x = a, y = b; y; t = x % y, x = y, y = t)
+                ;
+            if (x == 1 && (long long)src * a == (long long)dist * b)
+            {
+                *p = a;
+                *q = b;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ *  生成行或列的定位表
+ *  参数:
+ *      src: 源图像宽(或高)
+ *      dist: 输出图像宽(或高)
+ *      num, den: 定位比例, 一般即 src、dist
+ *  返回: dist个元素的定位表 !! 用完记得free() !!
+ *  说明: 输出第i点对应源图像坐标 i * num / den, 以Q16定点数一次算出,
+ *       不做浮点累加, 宽图也不会因误差累积取错源像素
+ */
+static Zoom_Step *_zoom_step_table(int src, int dist, int num, int den)
+{
+    Zoom_Step *table = (Zoom_Step *)_zoom_calloc(dist, sizeof(Zoom_Step));
+    long long pos;
+    int i;
+
+    for (i = 0; i < dist; i++)
+    {
+        pos = ((long long)i * num << ZOOM_FIX_BITS) / den;
+        table[i].i1 = (int)(pos >> ZOOM_FIX_BITS);
+        table[i].w = (int)(pos >> (ZOOM_FIX_BITS - ZOOM_W_BITS)) & (ZOOM_W_ONE - 1);
+        //有小数部分时才需要右(下)侧点,等效于原来的 ceil()
+        if (pos & ((1 << ZOOM_FIX_BITS) - 1))
+            table[i].i2 = table[i].i1 + 1;
+        else
+            table[i].i2 = table[i].i1;
+        if (table[i].i2 >= src)
+            table[i].i2 = src - 1;
+        if (table[i].i1 >= src)
+            table[i].i1 = src - 1;
+    }
+    return table;
+}
+
+//双三次卷积核(Keys, a = -0.5)
+static double _zoom_cubic(double x)
+{
+    x = fabs(x);
+    if (x < 1)
+        return (1.5 * x - 2.5) * x * x + 1;
+    if (x < 2)
+        return ((-0.5 * x + 2.5) * x - 4) * x + 2;
+    return 0;
+}
+
+//lanczos3 卷积核
+static double _zoom_lanczos3(double x)
+{
+    x = fabs(x);
+    if (x < 1e-8)
+        return 1;
+    if (x < 3)
+        return 3 * sin(M_PI * x) * sin(M_PI * x / 3) / (M_PI * M_PI * x * x);
+    return 0;
+}
+
+/*
+ *  生成行或列的卷积系数表
+ *  参数:
+ *      src: 源图像宽(或高)
+ *      dist: 输出图像宽(或高)
+ *      num, den: 定位比例, 一般即 src、dist
+ *      zt: ZT_CUBIC 或 ZT_LANCZOS3
+ *  返回: 系数表, 用 _zoom_filter_release() 释放
+ *  说明: 按像素中心对齐, 缩小时卷积核按倍数展宽以覆盖所有源像素;
+ *       越界的抽头权重并到边缘像素上, 使抽头始终落在源图像内
+ */
+static Zoom_Filter *_zoom_filter_table(int src, int dist, int num, int den, Zoom_Type zt)
+{
+    Zoom_Filter *f = (Zoom_Filter *)_zoom_calloc(1, sizeof(Zoom_Filter));
+    double (*kernel)(double) = (zt == ZT_CUBIC) ? &_zoom_cubic : &_zoom_lanczos3;
+    double support = (zt == ZT_CUBIC) ? 2 : 3;
+    double scale = (double)num / den;
+    double fscale = scale > 1 ? scale : 1;
+    double center, sum, *w;
+    int i, j, left, raw, start, pos, total, max;
+    short *wq;
+
+    //缩小时展宽卷积核
+    support *= fscale;
+    raw = (int)ceil(support * 2) + 1;
+    f->taps = raw < src ? raw : src;
+    f->start = (int *)_zoom_calloc(dist, sizeof(int));
+    f->weight = (short *)_zoom_calloc(dist * f->taps, sizeof(short));
+    w = (double *)_zoom_calloc(f->taps, sizeof(double));
+
+    for (i = 0; i < dist; i++)
+    {
+        center = (i + 0.5) * scale - 0.5;
+        left = (int)floor(center - support) + 1;
+        start = left;
+        if (start > src - f->taps)
+            start = src - f->taps;
+        if (start < 0)
+            start = 0;
+        f->start[i] = start;
+
+        //原始抽头,越界的并到边缘像素
+        memset(w, 0, f->taps * sizeof(double));
+        for (j = 0, sum = 0; j < raw; j++)
+        {
+            pos = left + j;
+            if (pos < 0)
+                pos = 0;
+            else if (pos > src - 1)
+                pos = src - 1;
+            w[pos - start] += kernel((left + j - center) / fscale);
+            sum += kernel((left + j - center) / fscale);
+        }
+
+        //归一化并转定点,舍入误差补到最大的权重上
+        wq = &f->weight[i * f->taps];
+        for (j = total = max = 0; j < f->taps; j++)
+        {
+            wq[j] = (short)floor(w[j] / sum * (1 << ZOOM_F_BITS) + 0.5);
+            total += wq[j];
+            if (wq[j] > wq[max])
+                max = j;
+        }
+        wq[max] += (1 << ZOOM_F_BITS) - total;
+    }
+
+    free(w);
+    return f;
+}
+
+//区域平均: 覆盖 [begin, end) 的源像素序号范围(以 den 为单位长度), 超出源图像的部分算在边缘像素上
+static void _zoom_area_span(long long begin, long long end, int src, int den, int *first, int *last)
+{
+    *first = (int)(begin / den);
+    *last = (int)((end - 1) / den);
+    if (*last > src - 1)
+        *last = src - 1;
+    if (*first > *last)
+        *first = *last;
+}
+
+/*
+ *  生成行或列的区域平均系数表
+ *  参数:
+ *      src: 源图像宽(或高)
+ *      dist: 输出图像宽(或高)
+ *      num, den: 定位比例, 一般即 src、dist
+ *  返回: 系数表(权重Q12), 用 _zoom_filter_release() 释放
+ *  说明: 输出第i点覆盖源图像 [i * num / den, (i + 1) * num / den), 按覆盖长度加权,
+ *       权重由累计覆盖长度取整相减得到, 每个输出点的权重和正好为 1 << ZOOM_A_BITS
+ */
+static Zoom_Filter *_zoom_area_table(int src, int dist, int num, int den)
+{
+    Zoom_Filter *f = (Zoom_Filter *)_zoom_calloc(1, sizeof(Zoom_Filter));
+    long long begin, end, a, b;
+    int i, j, first, last;
+    short *w;
+
+    //覆盖源像素最多的输出点决定抽头数(以 den 为单位长度,全程整数)
+    for (i = 0; i < dist; i++)
+    {
+        _zoom_area_span((long long)i * num, (long long)(i + 1) * num, src, den, &first, &last);
+        if (last - first + 1 > f->taps)
+            f->taps = last - first + 1;
+    }
+    f->start = (int *)_zoom_calloc(dist, sizeof(int));
+    f->weight = (short *)_zoom_calloc(dist * f->taps, sizeof(short));
+
+    for (i = 0; i < dist; i++)
+    {
+        begin = (long long)i * num;
+        end = begin + num;
+        _zoom_area_span(begin, end, src, den, &first, &last);
+        f->start[i] = first < src - f->taps ? first : src - f->taps;
+        w = &f->weight[i * f->taps + first - f->start[i]];
+        for (j = first; j <= last; j++)
+        {
+            a = (long long)j * den;
+            b = (j == last) ? end : a + den;
+            a = (a > begin ? a : begin) - begin;
+            b = (b < end ? b : end) - begin;
+            *w++ = (short)((b << ZOOM_A_BITS) / num - (a << ZOOM_A_BITS) / num);
+        }
+    }
+    return f;
+}
+
+static void _zoom_filter_release(Zoom_Filter *f)
+{
+    if (f)
+    {
+        free(f->start);
+        free(f->weight);
+        free(f);
+    }
+}
+
+//从第x0点开始使用重复模式: x0须是整组的起点, 源图像行相应后移shift点
+static const Zoom_Ratio *_zoom_ratio_at(Zoom_Info *info, int x0, int *shift)
+{
+    if (!info->xRatio || x0 % info->xRatio->group)
+        return NULL;
+    *shift = x0 / info->xRatio->group * info->xRatio->step;
+    return info->xRatio;
+}
+
+//行处理内核调用(输出行第x0~x1-1点): 有理数倍率时先用重复模式版本处理整组输出点,余下部分用通用版本
+static void _zoom_linear_line(Zoom_Info *info, unsigned char *out, const unsigned char *line1, const unsigned char *line2, int wy, int x0, int x1)
+{
+    const int n = info->bpp;
+    int s = 0;
+    const Zoom_Ratio *r = info->kernel->linear_ratio ? _zoom_ratio_at(info, x0, &s) : NULL;
+    int x = x0 + (r ? info->kernel->linear_ratio(out + x0 * n, line1 + s * n, line2 + s * n, r, x1 - x0, info->width - s, wy) : 0);
+    info->kernel->linear(out + x * n, line1, line2, info->xTable + x, x1 - x, info->width, wy);
+}
+static void _zoom_near_line(Zoom_Info *info, unsigned char *out, const unsigned char *line1, int x0, int x1)
+{
+    const int n = info->bpp;
+    int s = 0;
+    const Zoom_Ratio *r = info->kernel->near_ratio ? _zoom_ratio_at(info, x0, &s) : NULL;
+    int x = x0 + (r ? info->kernel->near_ratio(out + x0 * n, line1 + s * n, r, x1 - x0, info->width - s) : 0);
+    info->kernel->near(out + x * n, line1, info->xTable + x, x1 - x, info->width);
+}
+static void _zoom_linear_h_line(Zoom_Info *info, unsigned short *out, const unsigned char *line1, int x0, int x1)
+{
+    const int n = info->bpp;
+    int s = 0;
+    const Zoom_Ratio *r = info->kernel->linear_h_ratio ? _zoom_ratio_at(info, x0, &s) : NULL;
+    int x = x0 + (r ? info->kernel->linear_h_ratio(out + x0 * n, line1 + s * n, r, x1 - x0, info->width - s) : 0);
+    info->kernel->linear_h(out + x * n, line1, info->xTable + x, x1 - x, info->width);
+}
+
+//双线性插值: 输出第y行
+static void _zoom_row_linear(Zoom_Info *info, int worker, int y, int x0, int x1, unsigned char *out, Zoom_Line line, void *obj)
+{
+    //上下2个相邻点: 序号及权重查表
+    Zoom_Step *yt = &info->yTable[y];
+    //按行号从小到大获取上下两行(数据流借用源数据行时按此顺序借出)
+    unsigned char *line1 = line(obj, yt->i1);
+    unsigned char *line2 = line(obj, yt->i2);
+    //行像素遍历
+    _zoom_linear_line(info, out, line1, line2, yt->w, x0, x1);
+}
+
+//最近点插值: 输出第y行(最近y值查表,效果相当于floor),行像素遍历拷贝最近点
+static void _zoom_row_near(Zoom_Info *info, int worker, int y, int x0, int x1, unsigned char *out, Zoom_Line line, void *obj)
+{
+    _zoom_near_line(info, out, line(obj, info->yTable[y].i1), x0, x1);
+}
+
+//纵向放大时相邻输出行共用源图像行,使用水平插值缓存
+static int _zoom_hcache_use(Zoom_Info *info, Zoom_Type zt)
+{
+    return (zt == ZT_NEAR || zt == ZT_LINEAR) && info->heightOut > info->height;
+}
+
+static void _zoom_hcache_init(Zoom_Hcache *hc, Zoom_Info *info)
+{
+    hc->rows = (unsigned short *)_zoom_calloc(2 * info->widthOut * info->bpp, sizeof(unsigned short));
+    hc->rowOf[0] = hc->rowOf[1] = -1;
+    hc->out = (unsigned char *)_zoom_calloc(info->widthOut, info->bpp);
+    hc->outOf = -1;
+}
+
+static void _zoom_hcache_release(Zoom_Hcache *hc)
+{
+    free(hc->rows);
+    free(hc->out);
+}
+
+//源图像第sy行的水平插值结果,不在缓存中时计算一次
+static unsigned short *_zoom_hcache_row(Zoom_Info *info, Zoom_Hcache *hc, int sy, int x0, int x1, Zoom_Line line, void *obj)
+{
+    unsigned short *h = &hc->rows[(sy & 1) * info->widthOut * info->bpp];
+    if (hc->rowOf[sy & 1] != sy)
+    {
+        _zoom_linear_h_line(info, h, line(obj, sy), x0, x1);
+        hc->rowOf[sy & 1] = sy;
+    }
+    return h;
+}
+
+//双线性插值(纵向放大): 输出第y行,只做两行缓存结果的垂直插值
+static void _zoom_row_linear_cache(Zoom_Info *info, int worker, int y, int x0, int x1, unsigned char *out, Zoom_Line line, void *obj)
+{
+    Zoom_Hcache *hc = &info->hcache[worker];
+    Zoom_Step *yt = &info->yTable[y];
+    unsigned short *h1 = _zoom_hcache_row(info, hc, yt->i1, x0, x1, line, obj);
+    //下方行权重为0时不需要下方行
+    unsigned short *h2 = yt->w ? _zoom_hcache_row(info, hc, yt->i2, x0, x1, line, obj) : h1;
+    const int n = info->bpp;
+    info->kernel->linear_v(out + x0 * n, h1 + x0 * n, h2 + x0 * n, (x1 - x0) * n, yt->w);
+}
+
+//最近点插值(纵向放大): 与上一输出行同一源行时直接拷贝
+static void _zoom_row_near_cache(Zoom_Info *info, int worker, int y, int x0, int x1, unsigned char *out, Zoom_Line line, void *obj)
+{
+    Zoom_Hcache *hc = &info->hcache[worker];
+    int sy = info->yTable[y].i1;
+    if (hc->outOf != sy)
+    {
+        _zoom_near_line(info, hc->out, line(obj, sy), x0, x1);
+        hc->outOf = sy;
+    }
+    memcpy(out + x0 * info->bpp, hc->out + x0 * info->bpp, (x1 - x0) * info->bpp);
+}
+
+static void _zoom_scratch_init(Zoom_Scratch *sc, Zoom_Info *info)
+{
+    int taps = info->yFilter->taps;
+    sc->rows = (int *)_zoom_calloc(taps * info->widthOut * info->bpp, sizeof(int));
+    sc->rowOf = (int *)_zoom_calloc(taps, sizeof(int));
+    sc->win = (int **)_zoom_calloc(taps, sizeof(int *));
+    memset(sc->rowOf, 0xFF, taps * sizeof(int));
+}
+
+static void _zoom_scratch_release(Zoom_Scratch *sc)
+{
+    free(sc->rows);
+    free(sc->rowOf);
+    free(sc->win);
+}
+
+//水平滤波一行源图像,结果保留Q7(n为通道数,由 _ZOOM_PIXEL(n) 按常量展开)
+static inline void _zoom_filter_h_n(const Zoom_Filter *f, const unsigned char *line, int *out, int x0, int x1, const int n)
+{
+    const int shift = ZOOM_F_BITS - ZOOM_H_BITS;
+    const short *w = &f->weight[x0 * f->taps];
+    const unsigned char *p;
+    int x, t, s0, s1, s2, s3;
+
+    for (x = x0, out += x0 * n; x < x1; x += 1, out += n)
+    {
+        p = &line[f->start[x] * n];
+        s0 = s1 = s2 = s3 = 0;
+#define _SUM(c) s##c += p[c] * *w
+        for (t = 0; t < f->taps; t += 1, w += 1, p += n)
+            ZOOM_EACH(n, _SUM);
+#undef _SUM
+#define _OUT(c) out[c] = (s##c + (1 << (shift - 1))) >> shift
+        ZOOM_EACH(n, _OUT);
+#undef _OUT
+    }
+}
+
+//垂直滤波taps行水平滤波结果的第i个通道值(负瓣可能越界,需截断到0~255)
+static inline int _zoom_filter_v1(const short *w, int taps, int **win, int i)
+{
+    const int shift = ZOOM_F_BITS + ZOOM_H_BITS;
+    int t, v;
+    for (t = v = 0; t < taps; t += 1)
+        v += win[t][i] * w[t];
+    v = (v + (1 << (shift - 1))) >> shift;
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+//垂直滤波,输出一行count个通道值(与通道数无关)
+static void _zoom_filter_v(const short *w, int taps, int **win, unsigned char *out, int count)
+{
+    int i;
+    for (i = 0; i < count; i += 1)
+        out[i] = _zoom_filter_v1(w, taps, win, i);
+}
+
+//垂直滤波(预乘rgba): 颜色值不能超过不透明度, 负瓣造成的越界截断到不透明度
+static void _zoom_filter_v_pm(const short *w, int taps, int **win, unsigned char *out, int count)
+{
+    int i, c, a, v;
+    for (i = 0; i < count; i += 4)
+    {
+        a = _zoom_filter_v1(w, taps, win, i + 3);
+        for (c = 0; c < 3; c++)
+        {
+            v = _zoom_filter_v1(w, taps, win, i + c);
+            out[i + c] = v < a ? v : a;
+        }
+        out[i + 3] = a;
+    }
+}
+
+//卷积滤波: 输出第y行,用到的taps行源图像不在缓存中的先做水平滤波,再垂直滤波
+static void _zoom_row_filter(Zoom_Info *info, int worker, int y, int x0, int x1, unsigned char *out, Zoom_Line line, void *obj)
+{
+    Zoom_Scratch *sc = &info->scratch[worker];
+    int taps = info->yFilter->taps;
+    int rowSize = info->widthOut * info->bpp;
+    int t, sy, slot;
+
+    for (t = 0, sy = info->yFilter->start[y]; t < taps; t += 1, sy += 1)
+    {
+        slot = sy % taps;
+        if (sc->rowOf[slot] != sy)
+        {
+            info->pixel->filter_h(info->xFilter, line(obj, sy), &sc->rows[slot * rowSize], x0, x1);
+            sc->rowOf[slot] = sy;
+        }
+        sc->win[t] = &sc->rows[slot * rowSize + x0 * info->bpp];
+    }
+    info->pixel->filter_v(&info->yFilter->weight[y * taps], taps, sc->win, out + x0 * info->bpp, (x1 - x0) * info->bpp);
+}
+
+static void _zoom_area_init(Zoom_Area *ar, Zoom_Info *info)
+{
+    ar->hrow = (unsigned int *)_zoom_calloc(info->widthOut * info->bpp, sizeof(unsigned int));
+    ar->hrowOf = -1;
+    ar->acc = (unsigned int *)_zoom_calloc(info->widthOut * info->bpp, sizeof(unsigned int));
+}
+
+static void _zoom_area_release(Zoom_Area *ar)
+{
+    free(ar->hrow);
+    free(ar->acc);
+}
+
+//按缩放方式为count个线程(或任务)准备私有缓存
+static void _zoom_cache_init(Zoom_Info *info, Zoom_Type zt, int count)
+{
+    int i;
+    if (zt == ZT_CUBIC || zt == ZT_LANCZOS3)
+    {
+        info->scratch = (Zoom_Scratch *)_zoom_calloc(count, sizeof(Zoom_Scratch));
+        for (i = 0; i < count; i++)
+            _zoom_scratch_init(&info->scratch[i], info);
+    }
+    else if (zt == ZT_AREA)
+    {
+        info->area = (Zoom_Area *)_zoom_calloc(count, sizeof(Zoom_Area));
+        for (i = 0; i < count; i++)
+            _zoom_area_init(&info->area[i], info);
+    }
+    else if (_zoom_hcache_use(info, zt))
+    {
+        info->hcache = (Zoom_Hcache *)_zoom_calloc(count, sizeof(Zoom_Hcache));
+        for (i = 0; i < count; i++)
+            _zoom_hcache_init(&info->hcache[i], info);
+    }
+}
+
+static void _zoom_cache_release(Zoom_Info *info, int count)
+{
+    int i;
+    for (i = 0; info->scratch && i < count; i++)
+        _zoom_scratch_release(&info->scratch[i]);
+    for (i = 0; info->area && i < count; i++)
+        _zoom_area_release(&info->area[i]);
+    for (i = 0; info->hcache && i < count; i++)
+        _zoom_hcache_release(&info->hcache[i]);
+    free(info->scratch);
+    free(info->area);
+    free(info->hcache);
+    info->scratch = NULL;
+    info->area = NULL;
+    info->hcache = NULL;
+}
+
+//水平加权求和一行源图像(n为通道数,由 _ZOOM_PIXEL(n) 按常量展开)
+static inline void _zoom_area_h_n(const Zoom_Filter *f, const unsigned char *line, unsigned int *out, int x0, int x1, const int n)
+{
+    const short *w = &f->weight[x0 * f->taps];
+    const unsigned char *p;
+    int x, t, s0, s1, s2, s3;
+
+    for (x = x0, out += x0 * n; x < x1; x += 1, out += n)
+    {
+        p = &line[f->start[x] * n];
+        s0 = s1 = s2 = s3 = 0;
+#define _SUM(c) s##c += p[c] * *w
+        for (t = 0; t < f->taps; t += 1, w += 1, p += n)
+            ZOOM_EACH(n, _SUM);
+#undef _SUM
+#define _OUT(c) out[c] = s##c
+        ZOOM_EACH(n, _OUT);
+#undef _OUT
+    }
+}
+
+//输出行累加值转像素(count为通道值个数)
+static void _zoom_area_out(const unsigned int *acc, unsigned char *out, int count)
+{
+    int i;
+    for (i = 0; i < count; i += 1)
+        out[i] = (acc[i] + (1u << (ZOOM_A_BITS * 2 - 1))) >> (ZOOM_A_BITS * 2);
+}
+
+//区域平均: 输出第y行,覆盖到的源图像行逐行累加(与上一输出行共用的边界行不重复水平求和)
+static void _zoom_row_area(Zoom_Info *info, int worker, int y, int x0, int x1, unsigned char *out, Zoom_Line line, void *obj)
+{
+    Zoom_Area *ar = &info->area[worker];
+    const short *wy = &info->yFilter->weight[y * info->yFilter->taps];
+    int begin = x0 * info->bpp, count = x1 * info->bpp;
+    int t, i, sy;
+
+    memset(ar->acc + begin, 0, (count - begin) * sizeof(unsigned int));
+    for (t = 0, sy = info->yFilter->start[y]; t < info->yFilter->taps; t += 1, sy += 1)
+    {
+        if (wy[t] == 0)
+            continue;
+        if (ar->hrowOf != sy)
+        {
+            info->pixel->area_h(info->xFilter, line(obj, sy), ar->hrow, x0, x1);
+            ar->hrowOf = sy;
+        }
+        for (i = begin; i < count; i += 1)
+            ar->acc[i] += ar->hrow[i] * wy[t];
+    }
+    _zoom_area_out(ar->acc + begin, out + begin, count - begin);
+}
+
+#define _ZOOM_PIXEL(n) \
+static void _zoom_filter_h##n(const Zoom_Filter *f, const unsigned char *line, int *out, int x0, int x1) \
+{ \
+    _zoom_filter_h_n(f, line, out, x0, x1, n); \
+} \
+static void _zoom_area_h##n(const Zoom_Filter *f, const unsigned char *line, unsigned int *out, int x0, int x1) \
+{ \
+    _zoom_area_h_n(f, line, out, x0, x1, n); \
+}
+
+_ZOOM_PIXEL(1)
+_ZOOM_PIXEL(2)
+_ZOOM_PIXEL(3)
+_ZOOM_PIXEL(4)
+
+//各像素格式: bgr与rgb、rgbx与rgba的通道各自独立计算, 共用同一套函数; 预乘rgba只在有负瓣的卷积滤波时不同
+static const Zoom_Pixel _zoom_pixel[] = {
+    [ZF_RGB] = {3, &_zoom_filter_h3, &_zoom_area_h3, &_zoom_filter_v},
+    [ZF_BGR] = {3, &_zoom_filter_h3, &_zoom_area_h3, &_zoom_filter_v},
+    [ZF_GRAY] = {1, &_zoom_filter_h1, &_zoom_area_h1, &_zoom_filter_v},
+    [ZF_RGBX] = {4, &_zoom_filter_h4, &_zoom_area_h4, &_zoom_filter_v},
+    [ZF_RGBA] = {4, &_zoom_filter_h4, &_zoom_area_h4, &_zoom_filter_v},
+    [ZF_RGBA_PM] = {4, &_zoom_filter_h4, &_zoom_area_h4, &_zoom_filter_v_pm},
+    [ZF_UV] = {2, &_zoom_filter_h2, &_zoom_area_h2, &_zoom_filter_v},
+};
+
+/*
+ *  每像素字节数
+ *  返回: 1~4, 0不支持的格式
+ */
+int zoom_format_bytes(Zoom_Format zf)
+{
+    if ((int)zf < 0 || (int)zf >= (int)(sizeof(_zoom_pixel) / sizeof(_zoom_pixel[0])))
+        return 0;
+    return _zoom_pixel[zf].bpp;
+}
+
+//设置像素格式, 返回: 0成功 -1不支持的格式
+static int _zoom_format(Zoom_Info *info, Zoom_Format zf)
+{
+    if (zoom_format_bytes(zf) < 1)
+    {
+        fprintf(stderr, "zoom: unsupported pixel format %d !!\n", zf);
+        return -1;
+    }
+    info->zf = zf;
+    info->pixel = &_zoom_pixel[zf];
+    info->bpp = info->pixel->bpp;
+    return 0;
+}
+
+//按缩放方式准备定位表或卷积系数表
+static void _zoom_tables(Zoom_Info *info, Zoom_Type zt)
+{
+    int p, q;
+
+    //未指定定位比例时按 源尺寸 / 输出尺寸
+    if (!info->xDen)
+    {
+        info->xNum = info->width;
+        info->xDen = info->widthOut;
+    }
+    if (!info->yDen)
+    {
+        info->yNum = info->height;
+        info->yDen = info->heightOut;
+    }
+
+    if (zt == ZT_CUBIC || zt == ZT_LANCZOS3)
+    {
+        info->xFilter = _zoom_filter_table(info->width, info->widthOut, info->xNum, info->xDen, zt);
+        info->yFilter = _zoom_filter_table(info->height, info->heightOut, info->yNum, info->yDen, zt);
+        info->row = &_zoom_row_filter;
+    }
+    else if (zt == ZT_AREA)
+    {
+        info->xFilter = _zoom_area_table(info->width, info->widthOut, info->xNum, info->xDen);
+        info->yFilter = _zoom_area_table(info->height, info->heightOut, info->yNum, info->yDen);
+        info->row = &_zoom_row_area;
+    }
+    else
+    {
+        info->xTable = _zoom_step_table(info->width, info->widthOut, info->xNum, info->xDen);
+        info->yTable = _zoom_step_table(info->height, info->heightOut, info->yNum, info->yDen);
+        info->kernel = zoom_kernel(info->bpp);
+        //有理数倍率且内核支持时,生成列方向的重复模式
+        if ((info->kernel->linear_ratio || info->kernel->near_ratio) && _zoom_ratio(info->xNum, info->xDen, &p, &q))
+        {
+            info->xRatio = (Zoom_Ratio *)_zoom_calloc(1, sizeof(Zoom_Ratio));
+            if (zoom_ratio_init(info->xRatio, info->xTable, info->widthOut, p, q, info->bpp) != 0)
+            {
+                free(info->xRatio);
+                info->xRatio = NULL;
+            }
+        }
+        if (_zoom_hcache_use(info, zt))
+            info->row = (zt == ZT_LINEAR) ? &_zoom_row_linear_cache : &_zoom_row_near_cache;
+        else
+            info->row = (zt == ZT_LINEAR) ? &_zoom_row_linear : &_zoom_row_near;
+    }
+}
+
+static void _zoom_tables_release(Zoom_Info *info)
+{
+    free(info->xTable);
+    free(info->yTable);
+    free(info->xRatio);
+    _zoom_filter_release(info->xFilter);
+    _zoom_filter_release(info->yFilter);
+}
+
+//整图模式: 获取源图像第sy行
+static unsigned char *_zoom_line_image(void *obj, int sy)
+{
+    Zoom_Info *info = (Zoom_Info *)obj;
+    return &info->rgb[(long)sy * info->width * info->bpp];
+}
+
+/*
+ *  数据流模式: 获取源图像第sy行
+ *  按需向后读入, 每次调用srcRead读一批行到另一个缓冲, 行数据原地使用不再挪动;
+ *  各行处理函数请求的行号只会比已请求过的最大行号小1以内, 所以上一批仍可访问即可
+ */
+static unsigned char *_zoom_line_src(void *obj, int sy)
+{
+    Zoom_Src *src = (Zoom_Src *)obj;
+    Zoom_Stats *stats;
+    long long tick;
+    int cur = src->cur;
+    int n;
+
+    while (sy >= src->first[cur] + src->rows[cur] && !src->end)
+    {
+        //读入新的一批到另一个缓冲
+        n = src->height - src->first[cur] - src->rows[cur];
+        if (n > src->batch)
+            n = src->batch;
+        if (n > 0)
+        {
+            stats = zoom_stats_current();
+            tick = zoom_stats_tick(stats);
+            n = src->srcRead(src->obj, src->buf[!cur], n);
+            zoom_stats_stage(stats, ZS_READ, tick);
+            zoom_stats_rows(stats, n > 0 ? n : 0, 0);
+        }
+        if (n < 1)
+        {
+            src->end = 1;
+            break;
+        }
+        src->first[!cur] = src->first[cur] + src->rows[cur];
+        src->rows[!cur] = n < src->batch ? n : src->batch;
+        src->cur = cur = !cur;
+    }
+
+    if (sy >= src->first[cur] + src->rows[cur])
+    {
+        //读取失败时沿用最后读到的一行
+        if (src->rows[cur] > 0)
+            return &src->buf[cur][(src->rows[cur] - 1) * src->rowSize];
+        return src->buf[cur];
+    }
+    if (sy >= src->first[cur])
+        return &src->buf[cur][(sy - src->first[cur]) * src->rowSize];
+    if (sy >= src->first[!cur] && sy < src->first[!cur] + src->rows[!cur])
+        return &src->buf[!cur][(sy - src->first[!cur]) * src->rowSize];
+    return src->buf[cur];
+}
+
+/*
+ *  数据流模式(借用源数据行): 获取源图像第sy行
+ *  请求的行号最多回退1行, 所以只留最近借出的2行, 更早的行归还
+ */
+static unsigned char *_zoom_line_borrow(void *obj, int sy)
+{
+    Zoom_Borrow *bw = (Zoom_Borrow *)obj;
+    Zoom_Stats *stats;
+    unsigned char *row;
+    long long tick;
+
+    if (sy == bw->sy[1])
+        return bw->row[1];
+    if (sy == bw->sy[0])
+        return bw->row[0];
+
+    stats = zoom_stats_current();
+    tick = zoom_stats_tick(stats);
+
+    //更早的一行不会再用到,先归还再借新的一行
+    if (bw->sy[0] >= 0 && bw->srcRelease)
+        bw->srcRelease(bw->obj, bw->sy[0]);
+    bw->sy[0] = bw->sy[1];
+    bw->row[0] = bw->row[1];
+    bw->sy[1] = -1;
+    bw->row[1] = NULL;
+
+    //借用失败时沿用最近借到的一行
+    row = bw->srcBorrow(bw->obj, sy);
+    zoom_stats_stage(stats, ZS_READ, tick);
+    zoom_stats_rows(stats, row ? 1 : 0, 0);
+    if (!row)
+        return bw->row[0] ? bw->row[0] : bw->blank;
+    bw->sy[1] = sy;
+    bw->row[1] = row;
+    return row;
+}
+
+//清空线程私有缓存(缓存以源行号为标记,换一幅源图像后失效)
+static void _zoom_cache_reset(Zoom_Info *info, int worker)
+{
+    if (info->scratch)
+        memset(info->scratch[worker].rowOf, 0xFF, info->yFilter->taps * sizeof(int));
+    if (info->area)
+        info->area[worker].hrowOf = -1;
+    if (info->hcache)
+    {
+        info->hcache[worker].rowOf[0] = info->hcache[worker].rowOf[1] = -1;
+        info->hcache[worker].outOf = -1;
+    }
+}
+
+//输出第y行用到的源图像行范围
+static void _zoom_row_need(Zoom_Info *info, int y, int *lo, int *hi)
+{
+    if (info->yFilter)
+    {
+        *lo = info->yFilter->start[y];
+        *hi = *lo + info->yFilter->taps - 1;
+    }
+    else
+    {
+        *lo = info->yTable[y].i1;
+        *hi = info->yTable[y].i2;
+    }
+}
+
+//整图模式: 处理一个分块(换块时清空私有缓存, 缓存内容只对应上一块的列范围)
+static void _zoom_tile(Zoom_Plan *plan, int worker, int tile)
+{
+    Zoom_Info *info = &plan->info;
+    int x0 = tile % plan->tilesX * plan->tileW;
+    int x1 = x0 + plan->tileW;
+    int y = tile / plan->tilesX * plan->tileH;
+    int y1 = y + plan->tileH;
+    long long tick = zoom_trace_on() ? zoom_stats_now() : 0;
+
+    if (x1 > info->widthOut)
+        x1 = info->widthOut;
+    if (y1 > info->heightOut)
+        y1 = info->heightOut;
+
+    _zoom_cache_reset(info, worker);
+
+    //列像素遍历
+    for (; y < y1; y += 1)
+        info->row(info, worker, y, x0, x1, &info->rgbOut[(long)y * info->widthOut * info->bpp], &_zoom_line_image, info);
+
+    if (tick)
+        zoom_trace_event("tile", tile, tick, zoom_stats_now());
+}
+
+//领取一个分块: 先取自己队列的头部, 取空后从剩余最多的线程队列尾部取走一半
+static int _zoom_tile_take(Zoom_Plan *plan, int worker)
+{
+    Zoom_Queue *q = &plan->queue[worker];
+    int i, victim = -1, most = 0, tile = -1;
+
+    pthread_mutex_lock(&plan->lock);
+    if (q->head == q->tail)
+    {
+        for (i = 0; i < plan->threads; i++)
+        {
+            if (plan->queue[i].tail - plan->queue[i].head > most)
+            {
+                most = plan->queue[i].tail - plan->queue[i].head;
+                victim = i;
+            }
+        }
+        if (victim >= 0)
+        {
+            q->tail = plan->queue[victim].tail;
+            q->head = plan->queue[victim].tail -= (most + 1) / 2;
+        }
+    }
+    if (q->head < q->tail)
+        tile = q->head++;
+    pthread_mutex_unlock(&plan->lock);
+    return tile;
+}
+
+//整图模式: 一个线程池任务(一个线程)反复领取分块直到全部完成
+static void _zoom_tile_task(Zoom_Plan *plan, int worker)
+{
+    int tile;
+    while ((tile = _zoom_tile_take(plan, worker)) >= 0)
+        _zoom_tile(plan, worker, tile);
+}
+
+/*
+ *  分块尺寸: 块宽使一个输出行用到的源图像行片段、私有缓存行和输出行片段不超过L2的一半,
+ *  多线程时再按每线程至少 ZOOM_TILE_PER_THREAD 块切分行, 输出行数不够分时继续切分列
+ *  块宽对齐到有理数倍率的整组(使块内仍走重复模式内核)或16点
+ */
+static void _zoom_tile_size(Zoom_Plan *plan)
+{
+    Zoom_Info *info = &plan->info;
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    int align = info->xRatio ? info->xRatio->group : ZOOM_TILE_ALIGN;
+    int taps = info->yFilter ? info->yFilter->taps : 2;
+    int col, tileW, rowsY, want;
+
+    if (l2 <= 0)
+        l2 = ZOOM_L2_DEFAULT;
+
+    //每个输出列的字节数: 源图像(按横向倍率折算)、输出、私有缓存
+    col = (taps * ((info->width + info->widthOut - 1) / info->widthOut) + 1) * info->bpp;
+    if (info->scratch)
+        col += taps * info->bpp * sizeof(int);
+    else if (info->area)
+        col += 2 * info->bpp * sizeof(unsigned int);
+    else if (info->hcache)
+        col += 2 * info->bpp * sizeof(unsigned short);
+
+    tileW = l2 / 2 / col / align * align;
+    if (tileW < align)
+        tileW = align;
+    if (tileW > info->widthOut)
+        tileW = info->widthOut;
+    plan->tilesX = (info->widthOut + tileW - 1) / tileW;
+
+    //单线程: 每列块一整列
+    if (plan->threads < 2)
+        rowsY = 1;
+    else
+    {
+        want = plan->threads * ZOOM_TILE_PER_THREAD;
+        rowsY = (want + plan->tilesX - 1) / plan->tilesX;
+        //行数不够分: 块高取下限, 改为切分更多列
+        if (rowsY > (info->heightOut + ZOOM_TILE_MIN_H - 1) / ZOOM_TILE_MIN_H)
+        {
+            rowsY = (info->heightOut + ZOOM_TILE_MIN_H - 1) / ZOOM_TILE_MIN_H;
+            plan->tilesX = (want + rowsY - 1) / rowsY;
+            tileW = (info->widthOut + plan->tilesX - 1) / plan->tilesX;
+            tileW = (tileW + align - 1) / align * align;
+            if (tileW > info->widthOut)
+                tileW = info->widthOut;
+            plan->tilesX = (info->widthOut + tileW - 1) / tileW;
+        }
+    }
+    plan->tileW = tileW;
+    plan->tileH = (info->heightOut + rowsY - 1) / rowsY;
+    plan->tiles = plan->tilesX * ((info->heightOut + plan->tileH - 1) / plan->tileH);
+}
+
+//创建缩放计划: xNum、xDen、yNum、yDen 为定位比例(见 Zoom_Info), 传0按 源尺寸 / 输出尺寸
+static Zoom_Plan *_zoom_plan_create(
+    int width, int height,
+    int widthOut, int heightOut,
+    Zoom_Type zt,
+    Zoom_Format zf,
+    int xNum, int xDen,
+    int yNum, int yDen)
+{
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+    Zoom_Plan *plan;
+    Zoom_Info *info;
+
+    //参数检查
+    if (width < 1 || height < 1 || widthOut < 1 || heightOut < 1)
+        return NULL;
+
+    plan = (Zoom_Plan *)_zoom_calloc(1, sizeof(Zoom_Plan));
+    plan->zt = zt;
+    info = &plan->info;
+    if (_zoom_format(info, zf) != 0)
+    {
+        free(plan);
+        return NULL;
+    }
+    info->width = width;
+    info->height = height;
+    info->widthOut = widthOut;
+    info->heightOut = heightOut;
+    info->xNum = xNum;
+    info->xDen = xDen;
+    info->yNum = yNum;
+    info->yDen = yDen;
+
+    //行、列定位表(或卷积系数表)及行处理内核
+    _zoom_tables(info, zt);
+
+    //多线程处理(输出图像大于320x240时), 线程池可用线程数(cpu可用核心数)
+    plan->threads = (widthOut * heightOut > 76800) ? pool_threads() : 1;
+
+    //每个线程私有的缓存
+    _zoom_cache_init(info, zt, plan->threads);
+
+    //分块及每线程的分块队列
+    _zoom_tile_size(plan);
+    plan->queue = (Zoom_Queue *)_zoom_calloc(plan->threads, sizeof(Zoom_Queue));
+    pthread_mutex_init(&plan->lock, NULL);
+
+    zoom_stats_stage(stats, ZS_PREPARE, tick);
+    return plan;
+}
+
+/*
+ *  创建缩放计划
+ *  参数:
+ *      width, height: 源图像宽、高
+ *      widthOut, heightOut: 输出图像宽、高
+ *      zt: 缩放方式
+ *      zf: 像素格式
+ *  返回: 计划指针,NULL失败 !! 用完记得zoom_plan_destroy() !!
+ */
+Zoom_Plan *zoom_plan_create(
+    int width, int height,
+    int widthOut, int heightOut,
+    Zoom_Type zt,
+    Zoom_Format zf)
+{
+    return _zoom_plan_create(width, height, widthOut, heightOut, zt, zf, 0, 0, 0, 0);
+}
+
+/*
+ *  创建子采样平面的缩放计划(如jpeg的Cb、Cr分量)
+ *  参数: 同 zoom_plan_create, width 等为该平面的尺寸
+ *      imageWidth, imageHeight: 整幅图像(全分辨率分量)的源尺寸
+ *      imageWidthOut, imageHeightOut: 整幅图像的输出尺寸
+ *  返回: 计划指针,NULL失败 !! 用完记得zoom_plan_destroy() !!
+ *  说明: 平面按整幅图像的比例定位, 而不是按平面自身取整后的尺寸, 与全分辨率分量的采样点对应关系不变
+ */
+Zoom_Plan *zoom_plan_create_plane(
+    int width, int height,
+    int widthOut, int heightOut,
+    Zoom_Type zt,
+    Zoom_Format zf,
+    int imageWidth, int imageHeight,
+    int imageWidthOut, int imageHeightOut)
+{
+    if (imageWidth < 1 || imageHeight < 1 || imageWidthOut < 1 || imageHeightOut < 1)
+        return NULL;
+    return _zoom_plan_create(width, height, widthOut, heightOut, zt, zf,
+                             imageWidth, imageWidthOut, imageHeight, imageHeightOut);
+}
+
+/*
+ *  按计划缩放一帧
+ *  参数:
+ *      plan: zoom_plan_create() 返回的计划
+ *      rgb: 源图像数据指针,按计划的像素格式排列
+ *      rgbOut: 输出图像内存,至少 widthOut * heightOut * zoom_format_bytes(zf) 字节
+ *  返回: 0成功 -1失败
+ *  说明: 同一计划不能被多个线程同时执行
+ */
+int zoom_plan_execute(Zoom_Plan *plan, unsigned char *rgb, unsigned char *rgbOut)
+{
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+    int i;
+
+    //参数检查
+    if (!plan || !rgb || !rgbOut)
+        return -1;
+
+    plan->info.rgb = rgb;
+    plan->info.rgbOut = rgbOut;
+
+    //分块按序号平均分给各线程, 先做完的线程再去取别人剩下的
+    for (i = 0; i < plan->threads; i++)
+    {
+        plan->queue[i].head = (long long)plan->tiles * i / plan->threads;
+        plan->queue[i].tail = (long long)plan->tiles * (i + 1) / plan->threads;
+    }
+
+    //普通处理
+    if (plan->threads < 2)
+        _zoom_tile_task(plan, 0);
+    //多线程处理,交给线程池,返回时各线程已处理完毕
+    else
+        pool_run((void (*)(void *, int))&_zoom_tile_task, plan, plan->threads);
+
+    zoom_stats_stage(stats, ZS_RESAMPLE, tick);
+    zoom_stats_rows(stats, plan->info.height, plan->info.heightOut);
+    zoom_stats_threads(stats, plan->threads);
+    return 0;
+}
+
+/*
+ *  释放缩放计划
+ */
+void zoom_plan_destroy(Zoom_Plan *plan)
+{
+    if (plan)
+    {
+        _zoom_cache_release(&plan->info, plan->threads);
+        pthread_mutex_destroy(&plan->lock);
+        free(plan->queue);
+        _zoom_tables_release(&plan->info);
+        free(plan);
+    }
+}
+
+/*
+ *  缩放rgb图像(双线性插值算法)
+ *  参数:
+ *      rgb: 源图像数据指针,按像素格式排列
+ *      width, height: 源图像宽、高
+ *      retWidth, retHeigt: 输出图像宽、高
+ *      zm: 缩放倍数,(0,1)小于1缩小倍数,(1,~]大于1放大倍数
+ *      zt: 缩放方式
+ *      zf: 像素格式
+ *
+ *  返回: 输出图像数据指针(与输入同格式) !! 用完记得free() !!
+ */
+unsigned char *zoom(
+    unsigned char *rgb,
+    int width, int height,
+    int *retWidth, int *retHeight,
+    float zm,
+    Zoom_Type zt,
+    Zoom_Format zf)
+{
+    Zoom_Plan *plan;
+    unsigned char *rgbOut;
+    int widthOut = (int)(width * zm);
+    int heightOut = (int)(height * zm);
+
+    //参数检查
+    if (zm <= 0 || width < 1 || height < 1)
+        return NULL;
+    if (widthOut < 1)
+        widthOut = 1;
+    if (heightOut < 1)
+        heightOut = 1;
+
+    //一次性计划
+    plan = zoom_plan_create(width, height, widthOut, heightOut, zt, zf);
+    if (!plan)
+        return NULL;
+
+    //输出图像内存准备
+    rgbOut = (unsigned char *)_zoom_calloc(widthOut * heightOut, zoom_format_bytes(zf));
+    zoom_plan_execute(plan, rgb, rgbOut);
+    zoom_plan_destroy(plan);
+
+    //返回
+    if (retWidth)
+        *retWidth = widthOut;
+    if (retHeight)
+        *retHeight = heightOut;
+    return rgbOut;
+}
+
+//数据流准备: 输出行缓冲(一批), 行、列定位表(或卷积系数表)及行处理内核, 单线程缓存
+static void _zoom_stream_begin(Zoom_Info *info, Zoom_Type zt, int batch)
+{
+    info->rgbOut = (unsigned char *)_zoom_calloc(batch * info->widthOut, info->bpp);
+    _zoom_tables(info, zt);
+    _zoom_cache_init(info, zt, 1);
+}
+
+static void _zoom_stream_end(Zoom_Info *info)
+{
+    _zoom_cache_release(info, 1);
+    _zoom_tables_release(info);
+    free(info->rgbOut);
+}
+
+//单线程数据流计时起点: wait 返回此时的回调等待累计
+static long long _zoom_stream_tick(Zoom_Stats *stats, long long *wait)
+{
+    if (!stats)
+        return 0;
+    *wait = stats->ns[ZS_READ] + stats->ns[ZS_WRITE];
+    return zoom_stats_now();
+}
+
+//单线程数据流的缩放计算时间: 总耗时减去期间的回调等待(时间线上只有各次回调等待)
+static void _zoom_stream_resample(Zoom_Stats *stats, long long tick, long long wait)
+{
+    if (stats)
+        zoom_stats_add(stats, ZS_RESAMPLE, zoom_stats_now() - tick - (stats->ns[ZS_READ] + stats->ns[ZS_WRITE] - wait));
+}
+
+//数据流: 输出第y行到批缓冲(rows为缓冲中已有行数), 攒满一批或到最后一行时写出, 返回: 0写出结束(失败) 1继续
+static int _zoom_stream_row(
+    Zoom_Info *info, int y, int *rows, int batch,
+    Zoom_Line line, void *obj,
+    void *objDist,
+    int (*distWrite)(void *, unsigned char *, int))
+{
+    Zoom_Stats *stats;
+    long long tick;
+    int ret = 1;
+
+    info->row(info, 0, y, 0, info->widthOut, &info->rgbOut[*rows * info->widthOut * info->bpp], line, obj);
+    if (++*rows == batch || y == info->heightOut - 1)
+    {
+        stats = zoom_stats_current();
+        tick = zoom_stats_tick(stats);
+        ret = distWrite(objDist, info->rgbOut, *rows) > 0;
+        zoom_stats_stage(stats, ZS_WRITE, tick);
+        zoom_stats_rows(stats, 0, *rows);
+        *rows = 0;
+    }
+    return ret;
+}
+
+//数据流: 按行获取源图像逐行缩放, 输出行攒满一批写出一次
+static void _zoom_stream_run(
+    Zoom_Info *info, Zoom_Type zt,
+    Zoom_Line line, void *obj,
+    void *objDist,
+    int (*distWrite)(void *, unsigned char *, int),
+    int batch)
+{
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+    long long wait = 0;
+    int y, rows = 0;
+
+    _zoom_stream_begin(info, zt, batch);
+    zoom_stats_stage(stats, ZS_PREPARE, tick);
+
+    //开始缩放
+    tick = _zoom_stream_tick(stats, &wait);
+    for (y = 0; y < info->heightOut; y += 1)
+    {
+        //写出返回0(如编码出错)时不再缩放余下的行
+        if (!_zoom_stream_row(info, y, &rows, batch, line, obj, objDist, distWrite))
+            break;
+    }
+    _zoom_stream_resample(stats, tick, wait);
+    zoom_stats_threads(stats, 1);
+
+    //内内回收
+    _zoom_stream_end(info);
+}
+
+/*
+ *  数据流处理(为避免大张图片占用巨大内存空间)
+ *  参数:
+ *      obj: 用户私有参数,在调用下面回调函数时传回给用户
+ *      srcRead: 源图片行数据读取回调函数
+ *             : 函数原型 int srcRead(void *obj, unsigned char *rgbLine, int line)
+ *      distWrite: 输出图片行数据回调函数
+ *             : 函数原型 int distWrite(void *obj, unsigned char *rgbLine, int line)
+ *      zf: 像素格式, 读写的行数据都按此排列
+ *      batch: 每次回调读写的最多行数,传0使用默认8行
+ *  说明: 关于回调函数的返回,返回成功读写行数,返回0结束
+ */
+void zoom_stream(
+    void *objSrc, void *objDist,
+    int (*srcRead)(void *, unsigned char *, int),
+    int (*distWrite)(void *, unsigned char *, int),
+    int width, int height,
+    int *retWidth, int *retHeight,
+    float zm,
+    Zoom_Type zt,
+    Zoom_Format zf,
+    int batch)
+{
+    Zoom_Src src = {
+        .obj = objSrc,
+        .srcRead = srcRead,
+        .height = height,
+    };
+    Zoom_Info info = {
+        .width = width,
+        .height = height,
+        .widthOut = (int)(width * zm),
+        .heightOut = (int)(height * zm),
+    };
+
+    //参数检查
+    if (zm <= 0 || width < 1 || height < 1 || _zoom_format(&info, zf) != 0)
+        return;
+    if (info.widthOut < 1)
+        info.widthOut = 1;
+    if (info.heightOut < 1)
+        info.heightOut = 1;
+    if (batch < 1)
+        batch = ZOOM_BATCH_LINES;
+
+    //输入流,行缓冲内存准备(两批)
+    src.batch = batch;
+    src.rowSize = width * info.bpp;
+    src.buf[0] = (unsigned char *)_zoom_calloc(batch, src.rowSize);
+    src.buf[1] = (unsigned char *)_zoom_calloc(batch, src.rowSize);
+
+    //开始缩放
+    _zoom_stream_run(&info, zt, &_zoom_line_src, &src, objDist, distWrite, batch);
+
+    //返回
+    if (retWidth)
+        *retWidth = info.widthOut;
+    if (retHeight)
+        *retHeight = info.heightOut;
+
+    //内内回收
+    free(src.buf[0]);
+    free(src.buf[1]);
+}
+
+/*
+ *  数据流处理(借用源数据行, 源数据已在内存中时免拷贝)
+ *  参数: 同 zoom_stream
+ *      srcBorrow: 借出源图片第sy行数据指针,行数据在原处读取
+ *             : 函数原型 unsigned char *srcBorrow(void *obj, int sy), 返回NULL异常
+ *      srcRelease: 归还第sy行,不需要时传NULL
+ *             : 函数原型 void srcRelease(void *obj, int sy)
+ */
+void zoom_stream_borrow(
+    void *objSrc, void *objDist,
+    unsigned char *(*srcBorrow)(void *, int),
+    void (*srcRelease)(void *, int),
+    int (*distWrite)(void *, unsigned char *, int),
+    int width, int height,
+    int *retWidth, int *retHeight,
+    float zm,
+    Zoom_Type zt,
+    Zoom_Format zf,
+    int batch)
+{
+    Zoom_Borrow bw = {
+        .obj = objSrc,
+        .srcBorrow = srcBorrow,
+        .srcRelease = srcRelease,
+        .sy = {-1, -1},
+    };
+    Zoom_Info info = {
+        .width = width,
+        .height = height,
+        .widthOut = (int)(width * zm),
+        .heightOut = (int)(height * zm),
+    };
+    int i;
+
+    //参数检查
+    if (zm <= 0 || width < 1 || height < 1 || _zoom_format(&info, zf) != 0)
+        return;
+    if (info.widthOut < 1)
+        info.widthOut = 1;
+    if (info.heightOut < 1)
+        info.heightOut = 1;
+    if (batch < 1)
+        batch = ZOOM_BATCH_LINES;
+
+    bw.blank = (unsigned char *)_zoom_calloc(width, info.bpp);
+
+    //开始缩放
+    _zoom_stream_run(&info, zt, &_zoom_line_borrow, &bw, objDist, distWrite, batch);
+
+    //归还剩下的行
+    for (i = 0; i < 2; i++)
+    {
+        if (bw.sy[i] >= 0 && srcRelease)
+            srcRelease(objSrc, bw.sy[i]);
+    }
+
+    //返回
+    if (retWidth)
+        *retWidth = info.widthOut;
+    if (retHeight)
+        *retHeight = info.heightOut;
+
+    //内内回收
+    free(bw.blank);
+}
+
+//并行数据流的共享状态(除源图像行和输出缓冲的内容外,都在lock内访问)
 typedef struct
 {
-    unsigned char r, g, b;
-} Zoom_Rgb;
+    Zoom_Info *info;
+    void *objSrc, *objDist;
+    int (*srcRead)(void *, unsigned char *, int);
+    int (*distWrite)(void *, unsigned char *, int);
+    //源图像行环形缓冲,第sy行存放在 sy % ringLines
+    unsigned char *ring;
+    int ringLines;
+    int readLine; //已读入行数
+    int readEnd;  //源数据已读完
+    int reading;  //有线程正在读取
+    int abort;    //读取或写出失败, 余下的任务不再计算、写出
+    //输出任务: 每个任务连续batch行, 按任务序号轮流使用slots个输出缓冲
+    int batch;
+    unsigned char *outBuf;
+    int slots, runs;
+    int *slotState; //0/空闲 1/计算中 2/待写出
+    int nextRun;    //下一个待计算的任务
+    int writeRun;   //下一个待写出的任务
+    int writing;    //有线程正在写出
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    Zoom_Stats *stats; //调用线程绑定的统计, 工作线程上的回调等待也记入
+} Zoom_Stream;
 
-typedef struct
+//并行数据流: 获取源图像第sy行
+static unsigned char *_zoom_line_ring(void *obj, int sy)
 {
-    //输入输出图像信息
-    Zoom_Rgb *rgb;
-    int width, height;
-    Zoom_Rgb *rgbOut;
-    int widthOut, heightOut;
-    //多线程
-    int lineDiv;
-    int threadCount;
-    int threadFinsh;
-} Zoom_Info;
-
-//抛线程工具
-static void new_thread(void *obj, void *callback)
-{
-    pthread_t th;
-    pthread_attr_t attr;
-    int ret;
-    //禁用线程同步,线程运行结束后自动释放
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-    //抛出线程
-    ret = pthread_create(&th, &attr, callback, (void *)obj);
-    if (ret != 0)
-        printf("new_thread failed !! %s\r\n", strerror(ret));
-    //attr destroy
-    pthread_attr_destroy(&attr);
-}
-
-void _zoom_linear(Zoom_Info *info)
-{
-    float floorX, floorY, ceilX, ceilY;
-    float errUp, errDown, errLeft, errRight;
-    int x1, x2, y1, y2;
-    float xStep, yStep, xDiv, yDiv;
-    int x, y;
-    int offsetOut, offset11, offset12, offset21, offset22;
-
-    //多线程
-    int startLine, endLine;
-    //多线程,获得自己处理行信息
-    startLine = info->lineDiv * (info->threadCount++);
-    endLine = startLine + info->lineDiv;
-    if (endLine > info->heightOut)
-        endLine = info->heightOut;
-
-    //步宽计算(注意谁除以谁,这里表示的是在输出图像上每跳动一行、列等价于源图像跳过的行、列量)
-    xDiv = (float)info->width / info->widthOut;
-    yDiv = (float)info->height / info->heightOut;
+    Zoom_Stream *st = (Zoom_Stream *)obj;
+    return &st->ring[(sy % st->ringLines) * st->info->width * st->info->bpp];
+}
 
-    //列像素遍历
-    for (y = startLine, yStep = startLine * yDiv,
-        offsetOut = startLine * info->widthOut;
-         y < endLine; y += 1, yStep += yDiv)
-    {
-        //上下2个相邻点: 距离计算
-        floorY = floor(yStep);
-        ceilY = ceil(yStep);
-        errUp = yStep - floorY;
-        errDown = 1 - errUp;
-
-        //上下2个相邻点: 序号
-        y1 = (int)floorY;
-        y2 = (int)ceilY;
-        if (y2 == info->height)
-            y2 -= 1;
-
-        //避免下面for循环中重复该乘法
-        y1 *= info->width;
-        y2 *= info->width;
-
-        //行像素遍历
-        for (x = 0, xStep = 0; x < info->widthOut; x += 1, xStep += xDiv, offsetOut += 1)
+//输出任务run用到的源图像行范围
+static void _zoom_run_need(Zoom_Stream *st, int run, int *lo, int *hi)
+{
+    int y1 = (run + 1) * st->batch;
+    if (y1 > st->info->heightOut)
+        y1 = st->info->heightOut;
+    _zoom_row_need(st->info, run * st->batch, lo, hi);
+    _zoom_row_need(st->info, y1 - 1, &y1, hi);
+}
+
+/*
+ *  并行数据流的工作线程
+ *  每个线程都可以做3件事: 按顺序写出算好的任务、计算源数据已就绪的任务、读取源数据,
+ *  同一时刻只有一个线程读、一个线程写, 线程池只有1个线程时也能独自完成全部工作
+ */
+static void _zoom_stream_worker(Zoom_Stream *st, int worker)
+{
+    Zoom_Info *info = st->info;
+    int rowSize = info->widthOut * info->bpp;
+    unsigned char *out;
+    long long tick;
+    int run, slot, y, y0, y1, lo, hi, n, ret;
+
+    pthread_mutex_lock(&st->lock);
+    while (st->writeRun < st->runs && !st->abort)
+    {
+        //按顺序写出(优先,以腾出输出缓冲)
+        run = st->writeRun;
+        slot = run % st->slots;
+        if (!st->writing && st->slotState[slot] == 2)
         {
-            //左右2个相邻点: 距离计算
-            floorX = floor(xStep);
-            ceilX = ceil(xStep);
-            errLeft = xStep - floorX;
-            errRight = 1 - errLeft;
-
-            //左右2个相邻点: 序号
-            x1 = (int)floorX;
-            x2 = (int)ceilX;
-            if (x2 == info->width)
-                x2 -= 1;
-
-            //双线性插值
-            offset11 = x1 + y1;
-            offset12 = x2 + y1;
-            offset21 = x1 + y2;
-            offset22 = x2 + y2;
-            info->rgbOut[offsetOut].r = LINEAR(
-                info->rgb[offset11].r, info->rgb[offset12].r,
-                info->rgb[offset21].r, info->rgb[offset22].r,
-                errLeft, errRight, errUp, errDown);
-            info->rgbOut[offsetOut].g = LINEAR(
-                info->rgb[offset11].g, info->rgb[offset12].g,
-                info->rgb[offset21].g, info->rgb[offset22].g,
-                errLeft, errRight, errUp, errDown);
-            info->rgbOut[offsetOut].b = LINEAR(
-                info->rgb[offset11].b, info->rgb[offset12].b,
-                info->rgb[offset21].b, info->rgb[offset22].b,
-                errLeft, errRight, errUp, errDown);
+            st->writing = 1;
+            pthread_mutex_unlock(&st->lock);
+            y0 = run * st->batch;
+            y1 = y0 + st->batch < info->heightOut ? y0 + st->batch : info->heightOut;
+            out = &st->outBuf[slot * st->batch * rowSize];
+            tick = zoom_stats_tick(st->stats);
+            ret = st->distWrite(st->objDist, out, y1 - y0);
+            zoom_stats_stage(st->stats, ZS_WRITE, tick);
+            zoom_stats_rows(st->stats, 0, y1 - y0);
+            pthread_mutex_lock(&st->lock);
+            if (ret < 1)
+                st->abort = 1;
+            st->slotState[slot] = 0;
+            st->writeRun += 1;
+            st->writing = 0;
+            pthread_cond_broadcast(&st->cond);
+            continue;
+        }
+
+        //计算: 输出缓冲空闲且源数据已就绪(读取失败时不会就绪, 不用环形缓冲中未读入的行)
+        run = st->nextRun;
+        slot = run % st->slots;
+        if (run < st->runs && st->slotState[slot] == 0)
+        {
+            _zoom_run_need(st, run, &lo, &hi);
+            if (st->readLine > hi || st->readEnd)
+            {
+                st->slotState[slot] = 1;
+                st->nextRun += 1;
+                pthread_mutex_unlock(&st->lock);
+                y0 = run * st->batch;
+                y1 = y0 + st->batch < info->heightOut ? y0 + st->batch : info->heightOut;
+                out = &st->outBuf[slot * st->batch * rowSize];
+                tick = zoom_trace_on() ? zoom_stats_now() : 0;
+                for (y = y0; y < y1; y += 1, out += rowSize)
+                    info->row(info, worker, y, 0, info->widthOut, out, &_zoom_line_ring, st);
+                if (tick)
+                    zoom_trace_event("rows", y0, tick, zoom_stats_now());
+                pthread_mutex_lock(&st->lock);
+                st->slotState[slot] = 2;
+                pthread_cond_broadcast(&st->cond);
+                continue;
+            }
+        }
+
+        //读取: 只覆盖待写出的最早任务也不再需要的行
+        _zoom_run_need(st, st->writeRun, &lo, &hi);
+        if (!st->reading && !st->readEnd && st->readLine < lo + st->ringLines)
+        {
+            st->reading = 1;
+            y = st->readLine;
+            //一批连续行: 不跨过环形缓冲末尾, 不覆盖仍需要的行
+            n = lo + st->ringLines - y;
+            if (n > st->batch)
+                n = st->batch;
+            if (n > st->ringLines - y % st->ringLines)
+                n = st->ringLines - y % st->ringLines;
+            if (n > info->height - y)
+                n = info->height - y;
+            pthread_mutex_unlock(&st->lock);
+            tick = zoom_stats_tick(st->stats);
+            ret = st->srcRead(st->objSrc, _zoom_line_ring(st, y), n);
+            zoom_stats_stage(st->stats, ZS_READ, tick);
+            zoom_stats_rows(st->stats, ret > 0 ? ret : 0, 0);
+            pthread_mutex_lock(&st->lock);
+            //读取失败不是图像结束: 余下的任务缺少源数据, 全部中止
+            if (ret > 0)
+                st->readLine += ret < n ? ret : n;
+            else
+                st->abort = 1;
+            if (st->readLine == info->height)
+                st->readEnd = 1;
+            st->reading = 0;
+            pthread_cond_broadcast(&st->cond);
+            continue;
         }
-    }
 
-    //多线程,处理完成行数
-    info->threadFinsh++;
+        pthread_cond_wait(&st->cond, &st->lock);
+    }
+    pthread_mutex_unlock(&st->lock);
 }
 
-void _zoom_linear_stream(
-    Zoom_Info *info,
+/*
+ *  多线程数据流处理
+ *  参数: 同 zoom_stream, batch 同时也是每个并行任务处理的输出行数
+ *      ringLines: 源图像行环形缓冲的行数,传0自动选择(不足一个任务所需时自动加大)
+ *  说明: 源数据按顺序读入环形缓冲, 输出行按任务分给线程池并行计算, 再按顺序写出;
+ *       回调函数不会被同时调用, 但可能在不同线程中调用; 内存占用由环形缓冲决定, 与图像高度无关;
+ *       srcRead 未读完或 distWrite 返回0(出错)时, 余下的任务不再计算、写出
+ */
+void zoom_stream_parallel(
     void *objSrc, void *objDist,
     int (*srcRead)(void *, unsigned char *, int),
-    int (*distWrite)(void *, unsigned char *, int))
+    int (*distWrite)(void *, unsigned char *, int),
+    int width, int height,
+    int *retWidth, int *retHeight,
+    float zm,
+    Zoom_Type zt,
+    Zoom_Format zf,
+    int batch,
+    int ringLines)
 {
-    float floorX, floorY, ceilX, ceilY;
-    float errUp, errDown, errLeft, errRight;
-    int x1, x2, y2;
-    float xStep, yStep, xDiv, yDiv;
-    int x, y;
+    Zoom_Stream st = {
+        .objSrc = objSrc,
+        .objDist = objDist,
+        .srcRead = srcRead,
+        .distWrite = distWrite,
+        .stats = zoom_stats_current(),
+    };
+    Zoom_Info info = {
+        .width = width,
+        .height = height,
+        .widthOut = (int)(width * zm),
+        .heightOut = (int)(height * zm),
+    };
+    long long tick = zoom_stats_tick(st.stats);
+    int threads, run, lo, hi, span;
+
+    //参数检查
+    if (zm <= 0 || width < 1 || height < 1 || _zoom_format(&info, zf) != 0)
+        return;
+    if (info.widthOut < 1)
+        info.widthOut = 1;
+    if (info.heightOut < 1)
+        info.heightOut = 1;
 
-    //当前读取行数
-    int readLine = 0;
-    //两行数据的指针,对应y1,y2来使用
-    Zoom_Rgb *line1 = &info->rgb[0];
-    Zoom_Rgb *line2 = &info->rgb[info->width];
-    Zoom_Rgb *lineX;
+    //行、列定位表(或卷积系数表)及行处理内核,每个线程私有的缓存
+    _zoom_tables(&info, zt);
+    threads = pool_threads();
+    _zoom_cache_init(&info, zt, threads);
+    st.info = &info;
 
-    //步宽计算(注意谁除以谁,这里表示的是在输出图像上每跳动一行、列等价于源图像跳过的行、列量)
-    xDiv = (float)info->width / info->widthOut;
-    yDiv = (float)info->height / info->heightOut;
+    //环形缓冲至少容纳2个任务所需的源图像行,且一个任务之外还能整批读入
+    st.batch = batch > 0 ? batch : ZOOM_BATCH_LINES;
+    st.runs = (info.heightOut + st.batch - 1) / st.batch;
+    for (run = span = 0; run < st.runs; run++)
+    {
+        _zoom_run_need(&st, run, &lo, &hi);
+        if (hi - lo + 1 > span)
+            span = hi - lo + 1;
+    }
+    st.ringLines = ringLines > span * 2 ? ringLines : span * 2;
+    if (st.ringLines < span + st.batch)
+        st.ringLines = span + st.batch;
+    if (st.ringLines > height)
+        st.ringLines = height;
+    st.ring = (unsigned char *)_zoom_calloc(st.ringLines * width, info.bpp);
 
-    //读取新1行数据
-    srcRead(objSrc, (unsigned char *)line2, 1);
-    //填充满2行
-    memcpy(line1, line2, info->width * 3);
+    //每个线程2个输出缓冲,计算与写出交替进行
+    st.slots = threads * 2;
+    st.outBuf = (unsigned char *)_zoom_calloc(st.slots * st.batch * info.widthOut, info.bpp);
+    st.slotState = (int *)_zoom_calloc(st.slots, sizeof(int));
 
-    //列像素遍历
-    for (y = 0, yStep = 0 * yDiv; y < info->heightOut; y += 1, yStep += yDiv)
-    {
-        //上下2个相邻点: 距离计算
-        floorY = floor(yStep);
-        ceilY = ceil(yStep);
-        errUp = yStep - floorY;
-        errDown = 1 - errUp;
-
-        //上下2个相邻点: 序号
-        // y1 = (int)floorY;
-        y2 = (int)ceilY;
-        if (y2 == info->height)
-            y2 -= 1;
-
-        //读取足够的行数据(移动info->rgb中的行数据到能覆盖y1,y2所在行)
-        while (readLine < y2)
-        {
-            //后面数据往前挪
-            lineX = line1;
-            line1 = line2;
-            line2 = lineX;
-            //读取新一行数据
-            if (srcRead(objSrc, (unsigned char *)line2, 1) == 1)
-                readLine += 1;
-            else
-                break;
-        }
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.cond, NULL);
+    zoom_stats_stage(st.stats, ZS_PREPARE, tick);
 
-        // printf("y1 %d y2 %d - readLine %d \r\n", y1, y2, readLine);
+    //开始缩放,返回时全部行已写出
+    tick = zoom_stats_tick(st.stats);
+    pool_run((void (*)(void *, int))&_zoom_stream_worker, &st, threads);
+    zoom_stats_stage(st.stats, ZS_RESAMPLE, tick);
+    zoom_stats_threads(st.stats, threads);
 
-        //行像素遍历
-        for (x = 0, xStep = 0; x < info->widthOut; x += 1, xStep += xDiv)
-        {
-            //左右2个相邻点: 距离计算
-            floorX = floor(xStep);
-            ceilX = ceil(xStep);
-            errLeft = xStep - floorX;
-            errRight = 1 - errLeft;
-
-            //左右2个相邻点: 序号
-            x1 = (int)floorX;
-            x2 = (int)ceilX;
-            if (x2 == info->width)
-                x2 -= 1;
-
-            //双线性插值
-            info->rgbOut[x].r = LINEAR(
-                    line1[x1].r, line1[x2].r,
-                    line2[x1].r, line2[x2].r,
-                    errLeft, errRight, errUp, errDown);
-            info->rgbOut[x].g = LINEAR(
-                    line1[x1].g, line1[x2].g,
-                    line2[x1].g, line2[x2].g,
-                    errLeft, errRight, errUp, errDown);
-            info->rgbOut[x].b = LINEAR(
-                    line1[x1].b, line1[x2].b,
-                    line2[x1].b, line2[x2].b,
-                    errLeft, errRight, errUp, errDown);
-        }
+    pthread_mutex_destroy(&st.lock);
+    pthread_cond_destroy(&st.cond);
 
-        //输出一行数据
-        distWrite(objDist, (unsigned char *)info->rgbOut, 1);
+    //返回
+    if (retWidth)
+        *retWidth = info.widthOut;
+    if (retHeight)
+        *retHeight = info.heightOut;
+
+    //内内回收
+    _zoom_cache_release(&info, threads);
+    _zoom_tables_release(&info);
+    free(st.ring);
+    free(st.outBuf);
+    free(st.slotState);
+}
+
+// -------------------------- 流水线数据流 --------------------------
+// 读取、缩放、写出各占一个线程, 之间用有界的批队列衔接: 读取线程调用srcRead放入输入队列,
+// 调用线程按 zoom_stream 取出缩放后放入输出队列, 写出线程取出调用distWrite; 队列满、空时等待
+
+//流水线的批队列: depth个槽各存一批行, 一个线程放入、另一个线程取出
+typedef struct
+{
+    unsigned char *buf;
+    int *lines;    //各槽的行数
+    int depth;     //槽数
+    int slotSize;  //每槽字节数
+    int put, get;  //已放入、已取出的批数, 槽序号为对 depth 取余
+    int end;       //放入方结束
+    int stop;      //取出方结束, 放入方不用再等空槽
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} Zoom_Fifo;
+
+static int _zoom_fifo_init(Zoom_Fifo *q, int depth, int slotSize)
+{
+    memset(q, 0, sizeof(Zoom_Fifo));
+    q->buf = (unsigned char *)_zoom_calloc(depth, slotSize);
+    q->lines = (int *)calloc(depth, sizeof(int));
+    if (!q->buf || !q->lines)
+    {
+        free(q->buf);
+        free(q->lines);
+        return -1;
     }
+    q->depth = depth;
+    q->slotSize = slotSize;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+    return 0;
 }
 
-void _zoom_near(Zoom_Info *info)
+static void _zoom_fifo_release(Zoom_Fifo *q)
 {
-    int xSrc, ySrc;
-    float xStep, yStep, xDiv, yDiv;
-    int x, y, offset;
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->cond);
+    free(q->buf);
+    free(q->lines);
+}
 
-    //多线程
-    int startLine, endLine;
-    //多线程,获得自己处理行信息
-    startLine = info->lineDiv * (info->threadCount++);
-    endLine = startLine + info->lineDiv;
-    if (endLine > info->heightOut)
-        endLine = info->heightOut;
+//放入方: 等待空槽, 返回NULL时取出方已结束
+static unsigned char *_zoom_fifo_slot(Zoom_Fifo *q)
+{
+    unsigned char *slot = NULL;
+    pthread_mutex_lock(&q->lock);
+    while (!q->stop && q->put - q->get == q->depth)
+        pthread_cond_wait(&q->cond, &q->lock);
+    if (!q->stop)
+        slot = &q->buf[(long)(q->put % q->depth) * q->slotSize];
+    pthread_mutex_unlock(&q->lock);
+    return slot;
+}
 
-    //步宽计算(注意谁除以谁,这里表示的是在输出图像上每跳动一行、列等价于源图像跳过的行、列量)
-    xDiv = (float)info->width / info->widthOut;
-    yDiv = (float)info->height / info->heightOut;
+//放入方: 放入 _zoom_fifo_slot 取得的槽中的lines行, lines<1为结束
+static void _zoom_fifo_put(Zoom_Fifo *q, int lines)
+{
+    pthread_mutex_lock(&q->lock);
+    if (lines > 0)
+        q->lines[q->put++ % q->depth] = lines;
+    else
+        q->end = 1;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
 
-    //列像素遍历
-    for (y = startLine, yStep = startLine * yDiv,
-        offset = startLine * info->widthOut;
-         y < endLine; y += 1, yStep += yDiv)
-    {
-        //最近y值
-#if 0
-        ySrc = (int)round(yStep);
-        if (ySrc == info->height)
-            ySrc -= 1;
-#else
-        //直接类型转换可以提升速度,效果相当于floor
-        ySrc = (int)(yStep);
-#endif
-
-        //避免下面for循环中重复该乘法
-        ySrc *= info->width;
-
-        //行像素遍历
-        for (x = 0, xStep = 0; x < info->widthOut; x += 1, xStep += xDiv)
-        {
-            //最近x值
-#if 0
-            xSrc = (int)round(xStep);
-            if (xSrc == info->width)
-                xSrc -= 1;
-#else
-            //直接类型转换可以提升速度,效果相当于floor
-            xSrc = (int)(xStep);
-#endif
-            //拷贝最近点
-            info->rgbOut[offset++] = info->rgb[ySrc + xSrc];
-        }
+//取出方: 等待最早的一批(用完调用 _zoom_fifo_done), 返回NULL时已全部取完或已中止
+static unsigned char *_zoom_fifo_get(Zoom_Fifo *q, int *lines)
+{
+    unsigned char *slot = NULL;
+    pthread_mutex_lock(&q->lock);
+    while (!q->end && !q->stop && q->put == q->get)
+        pthread_cond_wait(&q->cond, &q->lock);
+    if (!q->stop && q->put > q->get)
+    {
+        slot = &q->buf[(long)(q->get % q->depth) * q->slotSize];
+        *lines = q->lines[q->get % q->depth];
     }
-
-    //多线程,处理完成行数
-    info->threadFinsh++;
+    pthread_mutex_unlock(&q->lock);
+    return slot;
 }
 
-void _zoom_near_stream(
-    Zoom_Info *info,
-    void *objSrc, void *objDist,
-    int (*srcRead)(void *, unsigned char *, int),
-    int (*distWrite)(void *, unsigned char *, int))
+//取出方: 用完最早的一批, 腾出槽; stop为1时不再取出
+static void _zoom_fifo_done(Zoom_Fifo *q, int stop)
 {
-    int xSrc, ySrc;
-    float xStep, yStep, xDiv, yDiv;
-    int x, y;
+    pthread_mutex_lock(&q->lock);
+    if (stop)
+        q->stop = 1;
+    else
+        q->get += 1;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
 
-    //当前已读取行数
-    int readLine = 0;
+typedef struct
+{
+    void *objSrc, *objDist;
+    int (*srcRead)(void *, unsigned char *, int);
+    int (*distWrite)(void *, unsigned char *, int);
+    int height, batch;
+    int rowSize, rowSizeOut;
+    Zoom_Fifo in, out;
+    int pos;           //输入队列最早一批中已交给缩放的行数
+    Zoom_Stats *stats; //调用线程绑定的统计, 读取、写出线程上的回调也记入
+} Zoom_Pipe;
 
-    //步宽计算(注意谁除以谁,这里表示的是在输出图像上每跳动一行、列等价于源图像跳过的行、列量)
-    xDiv = (float)info->width / info->widthOut;
-    yDiv = (float)info->height / info->heightOut;
+//读取或写出失败: 关闭两个队列, 其余两个阶段不再等待, 各自提前结束
+static void _zoom_pipe_abort(Zoom_Pipe *pp)
+{
+    _zoom_fifo_done(&pp->in, 1);
+    _zoom_fifo_put(&pp->in, 0);
+    _zoom_fifo_done(&pp->out, 1);
+    _zoom_fifo_put(&pp->out, 0);
+}
 
-    //读取新一行数据
-    srcRead(objSrc, (unsigned char *)info->rgb, 1);
+//读取线程: 按批调用srcRead放入输入队列, 读完或缩放不再需要时结束, 读取失败时中止流水线
+static void *_zoom_pipe_reader(void *arg)
+{
+    Zoom_Pipe *pp = (Zoom_Pipe *)arg;
+    unsigned char *slot;
+    int n, rows = 0;
 
-    //列像素遍历
-    for (y = 0, yStep = 0 * yDiv; y < info->heightOut; y += 1, yStep += yDiv)
-    {
-        //最近y值
-#if 0
-        ySrc = (int)round(yStep);
-#else
-        //直接类型转换可以提升速度,效果相当于floor
-        ySrc = (int)(yStep);
-#endif
-
-        //读取足够的行数据(移动info->rgb中的行数据到能覆盖ySrc所在行)
-        while (readLine < ySrc)
+    zoom_stats_begin(pp->stats);
+    while (rows < pp->height && (slot = _zoom_fifo_slot(&pp->in)))
+    {
+        n = pp->height - rows < pp->batch ? pp->height - rows : pp->batch;
+        n = pp->srcRead(pp->objSrc, slot, n);
+        if (n < 1)
         {
-            //读取新一行数据
-            if (srcRead(objSrc, (unsigned char *)info->rgb, 1) == 1)
-                readLine += 1;
-            else
-                break;
+            _zoom_pipe_abort(pp);
+            break;
         }
+        if (n > pp->batch)
+            n = pp->batch;
+        _zoom_fifo_put(&pp->in, n);
+        rows += n;
+    }
+    _zoom_fifo_put(&pp->in, 0);
+    zoom_stats_end();
+    return NULL;
+}
 
-        // printf("ySrc %d - readLine %d \r\n", ySrc, readLine);
+//写出线程: 按顺序取出输出队列中的批调用distWrite, 写出失败时中止流水线
+static void *_zoom_pipe_writer(void *arg)
+{
+    Zoom_Pipe *pp = (Zoom_Pipe *)arg;
+    unsigned char *slot;
+    int n;
 
-        //行像素遍历
-        for (x = 0, xStep = 0; x < info->widthOut; x += 1, xStep += xDiv)
+    zoom_stats_begin(pp->stats);
+    while ((slot = _zoom_fifo_get(&pp->out, &n)))
+    {
+        if (pp->distWrite(pp->objDist, slot, n) < 1)
         {
-            //最近x值
-#if 0
-            xSrc = (int)round(xStep);
-            if (xSrc == info->width)
-                xSrc -= 1;
-#else
-            //直接类型转换可以提升速度,效果相当于floor
-            xSrc = (int)(xStep);
-#endif
-            //拷贝最近点
-            info->rgbOut[x] = info->rgb[xSrc];
+            _zoom_pipe_abort(pp);
+            break;
         }
+        _zoom_fifo_done(&pp->out, 0);
+    }
+    zoom_stats_end();
+    return NULL;
+}
+
+//缩放(调用线程)的srcRead: 从输入队列取行
+static int _zoom_pipe_read(void *obj, unsigned char *rgbLine, int line)
+{
+    Zoom_Pipe *pp = (Zoom_Pipe *)obj;
+    unsigned char *slot;
+    int n, lines;
 
-        //输出一行数据
-        distWrite(objDist, (unsigned char *)info->rgbOut, 1);
+    slot = _zoom_fifo_get(&pp->in, &lines);
+    if (!slot)
+        return 0;
+    n = lines - pp->pos < line ? lines - pp->pos : line;
+    memcpy(rgbLine, &slot[(long)pp->pos * pp->rowSize], (long)n * pp->rowSize);
+    pp->pos += n;
+    if (pp->pos == lines)
+    {
+        pp->pos = 0;
+        _zoom_fifo_done(&pp->in, 0);
+    }
+    return n;
+}
+
+//缩放(调用线程)的distWrite: 放入输出队列, 返回0时流水线已中止
+static int _zoom_pipe_write(void *obj, unsigned char *rgbLine, int line)
+{
+    Zoom_Pipe *pp = (Zoom_Pipe *)obj;
+    unsigned char *slot;
+    int n, count;
+
+    for (count = 0; count < line; count += n)
+    {
+        n = line - count < pp->batch ? line - count : pp->batch;
+        slot = _zoom_fifo_slot(&pp->out);
+        if (!slot)
+            return 0;
+        memcpy(slot, &rgbLine[(long)count * pp->rowSizeOut], (long)n * pp->rowSizeOut);
+        _zoom_fifo_put(&pp->out, n);
     }
+    return line;
 }
 
 /*
- *  缩放rgb图像(双线性插值算法)
- *  参数:
- *      rgb: 源图像数据指针,rgb排列,3字节一像素
- *      width, height: 源图像宽、高
- *      retWidth, retHeigt: 输出图像宽、高
- *      zm: 缩放倍数,(0,1)小于1缩小倍数,(1,~]大于1放大倍数
- *      zt: 缩放方式
- *
- *  返回: 输出rgb图像数据指针 !! 用完记得free() !!
+ *  流水线数据流处理
+ *  参数: 同 zoom_stream
+ *      depth: 读取与缩放、缩放与写出之间的队列各能存放的批数,传0使用默认4批
+ *  说明: srcRead 始终在读取线程、distWrite 始终在写出线程中调用, 缩放在调用线程中进行;
+ *       srcRead 未读完或 distWrite 返回0(出错)时关闭两个队列, 三个阶段都提前结束;
+ *       内存占用为 2 * depth 批行数据, 与图像高度无关; 单核时按 zoom_stream 处理
  */
-unsigned char *zoom(
-    unsigned char *rgb,
+void zoom_stream_pipeline(
+    void *objSrc, void *objDist,
+    int (*srcRead)(void *, unsigned char *, int),
+    int (*distWrite)(void *, unsigned char *, int),
     int width, int height,
     int *retWidth, int *retHeight,
     float zm,
-    Zoom_Type zt)
+    Zoom_Type zt,
+    Zoom_Format zf,
+    int batch,
+    int depth)
 {
-    int i;
-    int outSize;
-    int threadCount;
-    int processor = 0;
-    void (*callback)(Zoom_Info *);
-
-    Zoom_Info info = {
-        .rgb = (Zoom_Rgb *)rgb,
-        .width = width,
+    Zoom_Pipe pp = {
+        .objSrc = objSrc,
+        .objDist = objDist,
+        .srcRead = srcRead,
+        .distWrite = distWrite,
         .height = height,
-        .widthOut = (int)(width * zm),
-        .heightOut = (int)(height * zm),
-        .threadCount = 0,
-        .threadFinsh = 0,
+        .stats = zoom_stats_current(),
     };
+    pthread_t reader, writer;
+    int bpp = zoom_format_bytes(zf);
+    int widthOut = (int)(width * zm);
 
     //参数检查
-    if (zm <= 0 || width < 1 || height < 1)
-        return NULL;
+    if (zm <= 0 || width < 1 || height < 1 || bpp == 0)
+        return;
+    if (widthOut < 1)
+        widthOut = 1;
+    if (batch < 1)
+        batch = ZOOM_BATCH_LINES;
+    if (depth < 1)
+        depth = ZOOM_PIPE_DEPTH;
 
-    //输出图像内存准备
-    outSize = info.widthOut * info.heightOut;
-    info.rgbOut = (Zoom_Rgb *)calloc(outSize, sizeof(Zoom_Rgb));
+    //单核时各阶段不能同时进行
+    if (pool_threads() < 2)
+    {
+        zoom_stream(objSrc, objDist, srcRead, distWrite, width, height, retWidth, retHeight, zm, zt, zf, batch);
+        return;
+    }
 
-    //缩放方式
-    if (zt == ZT_LINEAR)
-        callback = &_zoom_linear;
-    else
-        callback = &_zoom_near;
+    pp.batch = batch;
+    pp.rowSize = width * bpp;
+    pp.rowSizeOut = widthOut * bpp;
+    if (_zoom_fifo_init(&pp.in, depth, batch * pp.rowSize) != 0)
+        return;
+    if (_zoom_fifo_init(&pp.out, depth, batch * pp.rowSizeOut) != 0)
+    {
+        _zoom_fifo_release(&pp.in);
+        return;
+    }
 
-    //多线程处理(输出图像大于320x240时)
-    if (outSize > 76800)
+    //先启动写出线程(只等待输出队列), 读取线程启动失败时还没有读过源数据, 改为单线程处理
+    if (pthread_create(&writer, NULL, &_zoom_pipe_writer, &pp) != 0)
+    {
+        _zoom_fifo_release(&pp.in);
+        _zoom_fifo_release(&pp.out);
+        zoom_stream(objSrc, objDist, srcRead, distWrite, width, height, retWidth, retHeight, zm, zt, zf, batch);
+        return;
+    }
+    if (pthread_create(&reader, NULL, &_zoom_pipe_reader, &pp) != 0)
     {
-        //获取cpu可用核心数
-        processor = get_nprocs();
+        _zoom_fifo_put(&pp.out, 0);
+        pthread_join(writer, NULL);
+        _zoom_fifo_release(&pp.in);
+        _zoom_fifo_release(&pp.out);
+        zoom_stream(objSrc, objDist, srcRead, distWrite, width, height, retWidth, retHeight, zm, zt, zf, batch);
+        return;
     }
 
-    //普通处理
-    if (processor < 2)
+    //缩放: 返回时全部输出行已放入输出队列
+    zoom_stream(&pp, &pp, &_zoom_pipe_read, &_zoom_pipe_write, width, height, retWidth, retHeight, zm, zt, zf, batch);
+    zoom_stats_threads(pp.stats, 3);
+
+    //缩放用不到的源数据不再读取, 等待写出完成
+    _zoom_fifo_done(&pp.in, 1);
+    _zoom_fifo_put(&pp.out, 0);
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+
+    //内内回收
+    _zoom_fifo_release(&pp.in);
+    _zoom_fifo_release(&pp.out);
+}
+
+// -------------------------- 平面yuv --------------------------
+
+//平面yuv格式的平面数, 0不支持的格式
+static int _zoom_yuv_planes(Zoom_Yuv zy)
+{
+    if (zy == ZY_I420)
+        return 3;
+    if (zy == ZY_NV12)
+        return 2;
+    return 0;
+}
+
+//第plane个平面的宽、高(色度平面为亮度的一半,向上取整), 返回: 该平面的像素格式
+static Zoom_Format _zoom_yuv_plane(Zoom_Yuv zy, int plane, int width, int height, int *w, int *h)
+{
+    if (plane == 0)
     {
-        info.lineDiv = info.heightOut;
-        callback(&info);
+        *w = width;
+        *h = height;
+        return ZF_GRAY;
     }
-    //多线程处理
-    else
+    *w = (width + 1) / 2;
+    *h = (height + 1) / 2;
+    return zy == ZY_NV12 ? ZF_UV : ZF_GRAY;
+}
+
+/*
+ *  平面yuv一帧的字节数
+ *  返回: 0不支持的格式
+ */
+int zoom_yuv_bytes(int width, int height, Zoom_Yuv zy)
+{
+    Zoom_Format zf;
+    int i, w, h, bytes = 0;
+
+    if (width < 1 || height < 1)
+        return 0;
+    for (i = 0; i < _zoom_yuv_planes(zy); i++)
+    {
+        zf = _zoom_yuv_plane(zy, i, width, height, &w, &h);
+        bytes += w * h * zoom_format_bytes(zf);
+    }
+    return bytes;
+}
+
+//平面yuv缩放计划: 每个平面一份缩放计划
+struct Zoom_Yuv_Plan
+{
+    Zoom_Yuv zy;
+    int planes;
+    Zoom_Plan *plane[3];
+};
+
+/*
+ *  创建平面yuv缩放计划
+ *  参数: 同 zoom_plan_create
+ *      zy: 平面yuv格式
+ *  返回: 计划指针,NULL失败 !! 用完记得zoom_yuv_plan_destroy() !!
+ */
+Zoom_Yuv_Plan *zoom_yuv_plan_create(
+    int width, int height,
+    int widthOut, int heightOut,
+    Zoom_Type zt,
+    Zoom_Yuv zy)
+{
+    Zoom_Yuv_Plan *plan;
+    Zoom_Format zf;
+    int i, w, h, wo, ho;
+
+    //参数检查
+    if (width < 1 || height < 1 || widthOut < 1 || heightOut < 1)
+        return NULL;
+    if (_zoom_yuv_planes(zy) < 1)
     {
-        //每核心处理行数
-        info.lineDiv = info.heightOut / processor;
-        if (info.lineDiv < 1)
-            info.lineDiv = 1;
-        //多线程
-        for (i = threadCount = 0; i < info.heightOut; i += info.lineDiv)
+        fprintf(stderr, "zoom: unsupported yuv format %d !!\n", zy);
+        return NULL;
+    }
+
+    plan = (Zoom_Yuv_Plan *)_zoom_calloc(1, sizeof(Zoom_Yuv_Plan));
+    plan->zy = zy;
+    plan->planes = _zoom_yuv_planes(zy);
+
+    //各平面都按亮度的比例定位, 色度采样点与亮度的对应关系缩放前后不变
+    for (i = 0; i < plan->planes; i++)
+    {
+        zf = _zoom_yuv_plane(zy, i, width, height, &w, &h);
+        _zoom_yuv_plane(zy, i, widthOut, heightOut, &wo, &ho);
+        plan->plane[i] = zoom_plan_create_plane(w, h, wo, ho, zt, zf, width, height, widthOut, heightOut);
+        if (!plan->plane[i])
         {
-            new_thread(&info, callback);
-            threadCount += 1;
+            zoom_yuv_plan_destroy(plan);
+            return NULL;
         }
-        //等待各线程处理完毕
-        while (info.threadFinsh != threadCount)
-            usleep(1000);
     }
+    return plan;
+}
+
+/*
+ *  按计划缩放一帧平面yuv
+ *  参数:
+ *      plan: zoom_yuv_plan_create() 返回的计划
+ *      yuv: 源图像数据指针,各平面依次连续存放
+ *      yuvOut: 输出图像内存,至少 zoom_yuv_bytes(widthOut, heightOut, zy) 字节
+ *  返回: 0成功 -1失败
+ *  说明: 各平面依次执行, 每个平面内部按分块多线程处理; 同一计划不能被多个线程同时执行
+ */
+int zoom_yuv_plan_execute(Zoom_Yuv_Plan *plan, unsigned char *yuv, unsigned char *yuvOut)
+{
+    Zoom_Info *info;
+    int i;
+
+    //参数检查
+    if (!plan || !yuv || !yuvOut)
+        return -1;
+
+    for (i = 0; i < plan->planes; i++)
+    {
+        info = &plan->plane[i]->info;
+        zoom_plan_execute(plan->plane[i], yuv, yuvOut);
+        yuv += (long)info->width * info->height * info->bpp;
+        yuvOut += (long)info->widthOut * info->heightOut * info->bpp;
+    }
+    return 0;
+}
+
+/*
+ *  释放平面yuv缩放计划
+ */
+void zoom_yuv_plan_destroy(Zoom_Yuv_Plan *plan)
+{
+    int i;
+    if (plan)
+    {
+        for (i = 0; i < plan->planes; i++)
+            zoom_plan_destroy(plan->plane[i]);
+        free(plan);
+    }
+}
+
+/*
+ *  缩放平面yuv图像
+ *  参数: 同 zoom
+ *      yuv: 源图像数据指针,各平面依次连续存放
+ *      zy: 平面yuv格式
+ *  返回: 输出图像数据指针(与输入同格式) !! 用完记得free() !!
+ */
+unsigned char *zoom_yuv(
+    unsigned char *yuv,
+    int width, int height,
+    int *retWidth, int *retHeight,
+    float zm,
+    Zoom_Type zt,
+    Zoom_Yuv zy)
+{
+    Zoom_Yuv_Plan *plan;
+    unsigned char *yuvOut;
+    int widthOut = (int)(width * zm);
+    int heightOut = (int)(height * zm);
+
+    //参数检查
+    if (zm <= 0 || width < 1 || height < 1)
+        return NULL;
+    if (widthOut < 1)
+        widthOut = 1;
+    if (heightOut < 1)
+        heightOut = 1;
+
+    //一次性计划
+    plan = zoom_yuv_plan_create(width, height, widthOut, heightOut, zt, zy);
+    if (!plan)
+        return NULL;
+
+    //输出图像内存准备
+    yuvOut = (unsigned char *)_zoom_calloc(zoom_yuv_bytes(widthOut, heightOut, zy), 1);
+    zoom_yuv_plan_execute(plan, yuv, yuvOut);
+    zoom_yuv_plan_destroy(plan);
 
     //返回
     if (retWidth)
-        *retWidth = info.widthOut;
+        *retWidth = widthOut;
     if (retHeight)
-        *retHeight = info.heightOut;
-    return (unsigned char *)info.rgbOut;
+        *retHeight = heightOut;
+    return yuvOut;
+}
+
+//平面yuv数据流: 每个平面各自缩放, 回调时带上平面序号
+typedef struct
+{
+    Zoom_Info info;
+    Zoom_Src src;
+    int rows;  //输出批缓冲中已有行数
+    int batch; //每批行数
+    int plane;
+    void *objSrc, *objDist;
+    int (*srcRead)(void *, int, unsigned char *, int);
+    int (*distWrite)(void *, int, unsigned char *, int);
+} Zoom_Yuv_Stream;
+
+static int _zoom_yuv_read(void *obj, unsigned char *line, int lines)
+{
+    Zoom_Yuv_Stream *ys = (Zoom_Yuv_Stream *)obj;
+    return ys->srcRead(ys->objSrc, ys->plane, line, lines);
+}
+
+static int _zoom_yuv_write(void *obj, unsigned char *line, int lines)
+{
+    Zoom_Yuv_Stream *ys = (Zoom_Yuv_Stream *)obj;
+    return ys->distWrite(ys->objDist, ys->plane, line, lines);
+}
+
+//平面yuv数据流: 第y行输出到批缓冲, 返回: 0写出结束(失败) 1继续
+static int _zoom_yuv_row(Zoom_Yuv_Stream *ys, int y)
+{
+    return _zoom_stream_row(&ys->info, y, &ys->rows, ys->batch, &_zoom_line_src, &ys->src, ys, &_zoom_yuv_write);
 }
 
 /*
- *  数据流处理(为避免大张图片占用巨大内存空间)
- *  参数:
- *      obj: 用户私有参数,在调用下面回调函数时传回给用户
- *      srcRead: 源图片行数据读取回调函数
- *             : 函数原型 int srcRead(void *obj, unsigned char *rgbLine, int line)
- *      distWrite: 输出图片行数据回调函数
- *             : 函数原型 int distWrite(void *obj, unsigned char *rgbLine, int line)
- *  说明: 关于回调函数的返回,返回成功读写行数,返回0结束
+ *  平面yuv数据流处理
+ *  参数: 同 zoom_stream
+ *      srcRead: 源图片某个平面的行数据读取回调函数
+ *             : 函数原型 int srcRead(void *obj, int plane, unsigned char *line, int lines)
+ *      distWrite: 输出图片某个平面的行数据回调函数
+ *             : 函数原型 int distWrite(void *obj, int plane, unsigned char *line, int lines)
+ *      zy: 平面yuv格式
+ *      batch: 亮度平面每次回调读写的最多行数,传0使用默认8行, 色度平面为其一半
+ *  说明: 任一平面的 distWrite 返回0(出错)时, 余下各平面的行不再缩放、写出
  */
-void zoom_stream(
+void zoom_stream_yuv(
     void *objSrc, void *objDist,
-    int (*srcRead)(void *, unsigned char *, int),
-    int (*distWrite)(void *, unsigned char *, int),
+    int (*srcRead)(void *, int, unsigned char *, int),
+    int (*distWrite)(void *, int, unsigned char *, int),
     int width, int height,
     int *retWidth, int *retHeight,
     float zm,
-    Zoom_Type zt)
+    Zoom_Type zt,
+    Zoom_Yuv zy,
+    int batch)
 {
-    Zoom_Info info = {
-        .width = width,
-        .height = height,
-        .widthOut = (int)(width * zm),
-        .heightOut = (int)(height * zm),
-    };
+    Zoom_Stats *stats = zoom_stats_current();
+    long long tick = zoom_stats_tick(stats);
+    long long wait = 0;
+    Zoom_Yuv_Stream ys[3];
+    Zoom_Yuv_Stream *p;
+    int widthOut = (int)(width * zm);
+    int heightOut = (int)(height * zm);
+    int i, y, ret = 1, planes = _zoom_yuv_planes(zy);
 
     //参数检查
     if (zm <= 0 || width < 1 || height < 1)
         return;
+    if (planes < 1)
+    {
+        fprintf(stderr, "zoom: unsupported yuv format %d !!\n", zy);
+        return;
+    }
+    if (widthOut < 1)
+        widthOut = 1;
+    if (heightOut < 1)
+        heightOut = 1;
+    if (batch < 1)
+        batch = ZOOM_BATCH_LINES;
+
+    //各平面: 按亮度的比例定位, 输入流行缓冲(两批), 输出流行缓冲(一批)
+    memset(ys, 0, sizeof(ys));
+    for (i = 0; i < planes; i++)
+    {
+        p = &ys[i];
+        _zoom_format(&p->info, _zoom_yuv_plane(zy, i, width, height, &p->info.width, &p->info.height));
+        _zoom_yuv_plane(zy, i, widthOut, heightOut, &p->info.widthOut, &p->info.heightOut);
+        p->info.xNum = width;
+        p->info.xDen = widthOut;
+        p->info.yNum = height;
+        p->info.yDen = heightOut;
+        p->batch = i ? (batch + 1) / 2 : batch;
+        p->plane = i;
+        p->objSrc = objSrc;
+        p->objDist = objDist;
+        p->srcRead = srcRead;
+        p->distWrite = distWrite;
+        p->src.obj = p;
+        p->src.srcRead = &_zoom_yuv_read;
+        p->src.height = p->info.height;
+        p->src.batch = p->batch;
+        p->src.rowSize = p->info.width * p->info.bpp;
+        p->src.buf[0] = (unsigned char *)_zoom_calloc(p->batch, p->src.rowSize);
+        p->src.buf[1] = (unsigned char *)_zoom_calloc(p->batch, p->src.rowSize);
+        _zoom_stream_begin(&p->info, zt, p->batch);
+    }
 
-    //输入流,行缓冲内存准备(至少2行)
-    info.rgb = (Zoom_Rgb *)calloc(info.width * 2, sizeof(Zoom_Rgb));
-    //输出流,行缓冲内存准备(只需1行)
-    info.rgbOut = (Zoom_Rgb *)calloc(info.widthOut, sizeof(Zoom_Rgb));
+    zoom_stats_stage(stats, ZS_PREPARE, tick);
 
-    //开始缩放
-    if (zt == ZT_LINEAR)
-        _zoom_linear_stream(&info, objSrc, objDist, srcRead, distWrite);
-    else
-        _zoom_near_stream(&info, objSrc, objDist, srcRead, distWrite);
+    //开始缩放: 按亮度行推进, 每2行亮度之后输出对应的1行色度, 各平面的读写进度保持一致
+    //任一平面写出失败即结束
+    tick = _zoom_stream_tick(stats, &wait);
+    for (y = 0; y < heightOut && ret; y += 1)
+    {
+        ret = _zoom_yuv_row(&ys[0], y);
+        if (ret && ((y & 1) || y == heightOut - 1))
+        {
+            for (i = 1; i < planes && ret; i++)
+                ret = _zoom_yuv_row(&ys[i], y / 2);
+        }
+    }
+    _zoom_stream_resample(stats, tick, wait);
+    zoom_stats_threads(stats, 1);
 
     //返回
     if (retWidth)
-        *retWidth = info.widthOut;
+        *retWidth = widthOut;
     if (retHeight)
-        *retHeight = info.heightOut;
+        *retHeight = heightOut;
 
     //内内回收
-    free(info.rgb);
-    free(info.rgbOut);
+    for (i = 0; i < planes; i++)
+    {
+        _zoom_stream_end(&ys[i].info);
+        free(ys[i].src.buf[0]);
+        free(ys[i].src.buf[1]);
+    }
 }
@@ -5,25 +5,106 @@ typedef enum
 {
     ZT_NEAR = 0, //最近点插值
     ZT_LINEAR,   //双线性插值
+    ZT_CUBIC,    //双三次卷积(可分离,先水平后垂直)
+    ZT_LANCZOS3, //lanczos3卷积(可分离,先水平后垂直)
+    ZT_AREA,     //区域平均(大倍数缩小时覆盖到的源像素全部参与平均)
 } Zoom_Type;
 
+//像素格式: 各通道独立插值, 输出与输入同格式
+typedef enum
+{
+    ZF_RGB = 0, //rgb排列,3字节一像素
+    ZF_BGR,     //bgr排列(如bmp),3字节一像素
+    ZF_GRAY,    //灰度,1字节一像素(如灰度jpeg, output_components == 1)
+    ZF_RGBX,    //rgbx排列,4字节一像素,第4字节不使用(4字节对齐,SIMD按32位整像素处理,最快)
+    ZF_RGBA,    //rgba排列,4字节一像素,不透明度与颜色一样插值
+    ZF_RGBA_PM, //rgba排列,颜色已预乘不透明度(透明边缘不会渗出颜色),双三次、lanczos3的颜色结果不超过不透明度
+    ZF_UV,      //2字节一像素(如NV12的uv交错平面)
+} Zoom_Format;
+
+/*
+ *  每像素字节数
+ *  返回: 1~4, 0不支持的格式
+ */
+int zoom_format_bytes(Zoom_Format zf);
+
 /*
  *  缩放rgb图像(双线性插值算法)
  *  参数:
- *      rgb: 源图像数据指针,rgb排列,3字节一像素
+ *      rgb: 源图像数据指针,按像素格式排列
  *      width, height: 源图像宽、高
  *      retWidth, retHeigt: 输出图像宽、高
  *      zm: 缩放倍数,(0,1)小于1缩小倍数,(1,~]大于1放大倍数
  *      zt: 缩放方式
+ *      zf: 像素格式
  *
- *  返回: 输出rgb图像数据指针 !! 用完记得free() !!
+ *  返回: 输出图像数据指针(与输入同格式) !! 用完记得free() !!
+ *  说明: 按取整后的输出尺寸定位, 最近点、双线性插值输出第i点对应源坐标 i * width / retWidth;
+ *       输出尺寸正好是源尺寸的 p/q 倍(如 2、1.5、0.5)时按每周期重复的模式快速处理, 结果不变,
+ *       取整后只是接近 p/q 的尺寸(如 7->3)仍逐点定位
  */
 unsigned char *zoom(
     unsigned char *rgb,
     int width, int height,
     int *retWidth, int *retHeight,
     float zm,
-    Zoom_Type zt);
+    Zoom_Type zt,
+    Zoom_Format zf);
+
+// -------------------------- 缩放计划 --------------------------
+// 同一尺寸反复缩放时(如视频帧), 定位表、系数表、缓存和多线程分块只准备一次;
+// 输出按L2缓存大小切成分块, 各线程先做自己的分块, 做完后从其它线程取走剩余的一半
+
+typedef struct Zoom_Plan Zoom_Plan;
+
+/*
+ *  创建缩放计划
+ *  参数:
+ *      width, height: 源图像宽、高
+ *      widthOut, heightOut: 输出图像宽、高
+ *      zt: 缩放方式
+ *      zf: 像素格式
+ *  返回: 计划指针,NULL失败 !! 用完记得zoom_plan_destroy() !!
+ *  说明: 定位方式同 zoom(), 源坐标 i * width / widthOut; 只有 width * p == widthOut * q 时
+ *       横向才按 p/q 的重复模式处理
+ */
+Zoom_Plan *zoom_plan_create(
+    int width, int height,
+    int widthOut, int heightOut,
+    Zoom_Type zt,
+    Zoom_Format zf);
+
+/*
+ *  创建子采样平面的缩放计划(如jpeg的Cb、Cr分量)
+ *  参数: 同 zoom_plan_create, width 等为该平面的尺寸
+ *      imageWidth, imageHeight: 整幅图像(全分辨率分量)的源尺寸
+ *      imageWidthOut, imageHeightOut: 整幅图像的输出尺寸
+ *  返回: 计划指针,NULL失败 !! 用完记得zoom_plan_destroy() !!
+ *  说明: 平面按整幅图像的比例定位, 而不是按平面自身取整后的尺寸, 与全分辨率分量的采样点对应关系不变
+ */
+Zoom_Plan *zoom_plan_create_plane(
+    int width, int height,
+    int widthOut, int heightOut,
+    Zoom_Type zt,
+    Zoom_Format zf,
+    int imageWidth, int imageHeight,
+    int imageWidthOut, int imageHeightOut);
+
+/*
+ *  按计划缩放一帧
+ *  参数:
+ *      plan: zoom_plan_create() 返回的计划
+ *      rgb: 源图像数据指针,按计划的像素格式排列
+ *      rgbOut: 输出图像内存,至少 widthOut * heightOut * zoom_format_bytes(zf) 字节
+ *  返回: 0成功 -1失败
+ *  说明: 同一计划不能被多个线程同时执行
+ */
+int zoom_plan_execute(Zoom_Plan *plan, unsigned char *rgb, unsigned char *rgbOut);
+
+/*
+ *  释放缩放计划
+ */
+void zoom_plan_destroy(Zoom_Plan *plan);
 
 /*
  *  数据流处理(为避免大张图片占用巨大内存空间)
@@ -33,7 +114,10 @@ unsigned char *zoom(
  *             : 函数原型 int srcRead(void *obj, unsigned char *rgbLine, int line)
  *      distWrite: 输出图片行数据回调函数
  *             : 函数原型 int distWrite(void *obj, unsigned char *rgbLine, int line)
- *  说明: 关于回调函数的返回,返回成功读写行数,返回0异常或结束
+ *      zf: 像素格式, 读写的行数据都按此排列
+ *      batch: 每次回调读写的最多行数,传0使用默认8行(源为jpeg时取其iMCU高度8或16最合适)
+ *  说明: 关于回调函数的返回,返回成功读写行数,返回0异常或结束;
+ *       rgbLine 中连续存放 line 行, 读取时可以少于 line 行(不会要求超过图像高度的行)
  */
 void zoom_stream(
     void *objSrc, void *objDist,
@@ -42,6 +126,153 @@ void zoom_stream(
     int width, int height,
     int *retWidth, int *retHeight,
     float zm,
-    Zoom_Type zt);
+    Zoom_Type zt,
+    Zoom_Format zf,
+    int batch);
+
+/*
+ *  数据流处理(借用源数据行, 源数据已在内存中时免拷贝, 如已解码的帧、mmap的文件、摄像头缓冲)
+ *  参数: 同 zoom_stream
+ *      srcBorrow: 借出源图片第sy行数据指针, 行数据直接在原处读取
+ *             : 函数原型 unsigned char *srcBorrow(void *obj, int sy), 返回NULL异常
+ *      srcRelease: 归还第sy行, 之后不再访问该行, 不需要时传NULL
+ *             : 函数原型 void srcRelease(void *obj, int sy)
+ *  说明: 行号从小到大借出, 用不到的行会跳过; 同时借出的行不超过2行, 每行借出、归还各一次
+ */
+void zoom_stream_borrow(
+    void *objSrc, void *objDist,
+    unsigned char *(*srcBorrow)(void *, int),
+    void (*srcRelease)(void *, int),
+    int (*distWrite)(void *, unsigned char *, int),
+    int width, int height,
+    int *retWidth, int *retHeight,
+    float zm,
+    Zoom_Type zt,
+    Zoom_Format zf,
+    int batch);
+
+/*
+ *  多线程数据流处理
+ *  参数: 同 zoom_stream, batch 同时也是每个并行任务处理的输出行数
+ *      ringLines: 源图像行环形缓冲的行数,传0自动选择(不足一个任务所需时自动加大)
+ *  说明: 源数据按顺序读入环形缓冲, 输出行按任务分给线程池并行计算, 再按顺序写出;
+ *       回调函数不会被同时调用, 但可能在不同线程中调用; 内存占用由环形缓冲决定, 与图像高度无关;
+ *       srcRead 未读完或 distWrite 返回0(出错)时, 余下的任务不再计算、写出
+ */
+void zoom_stream_parallel(
+    void *objSrc, void *objDist,
+    int (*srcRead)(void *, unsigned char *, int),
+    int (*distWrite)(void *, unsigned char *, int),
+    int width, int height,
+    int *retWidth, int *retHeight,
+    float zm,
+    Zoom_Type zt,
+    Zoom_Format zf,
+    int batch,
+    int ringLines);
+
+/*
+ *  流水线数据流处理: 读取、缩放、写出分别在3个线程中同时进行(如jpeg解码、缩放、jpeg编码)
+ *  参数: 同 zoom_stream
+ *      depth: 读取与缩放、缩放与写出之间的队列各能存放的批数,传0使用默认4批
+ *  说明: srcRead 始终在读取线程、distWrite 始终在写出线程中调用, 缩放在调用线程中进行(单线程);
+ *       srcRead 未读完或 distWrite 返回0(出错)时关闭两个队列, 三个阶段都提前结束;
+ *       内存占用为 2 * depth 批行数据, 与图像高度无关; 单核时按 zoom_stream 处理
+ */
+void zoom_stream_pipeline(
+    void *objSrc, void *objDist,
+    int (*srcRead)(void *, unsigned char *, int),
+    int (*distWrite)(void *, unsigned char *, int),
+    int width, int height,
+    int *retWidth, int *retHeight,
+    float zm,
+    Zoom_Type zt,
+    Zoom_Format zf,
+    int batch,
+    int depth);
+
+// -------------------------- 平面yuv --------------------------
+// 摄像头、视频常用的4:2:0平面格式, 亮度和色度平面各自缩放(每像素平均1.5字节, 不必转rgb再转回);
+// 色度平面宽高为亮度的一半(向上取整), 缩放时各平面都按亮度的比例定位, 色度采样点与亮度的对应关系不变
+
+typedef enum
+{
+    ZY_I420 = 0, //y平面 + u平面 + v平面(YV12交换u、v即可)
+    ZY_NV12,     //y平面 + uv交错平面
+} Zoom_Yuv;
+
+/*
+ *  平面yuv一帧的字节数
+ *  返回: 0不支持的格式
+ */
+int zoom_yuv_bytes(int width, int height, Zoom_Yuv zy);
+
+/*
+ *  缩放平面yuv图像
+ *  参数: 同 zoom
+ *      yuv: 源图像数据指针,各平面依次连续存放
+ *      zy: 平面yuv格式
+ *  返回: 输出图像数据指针(与输入同格式) !! 用完记得free() !!
+ */
+unsigned char *zoom_yuv(
+    unsigned char *yuv,
+    int width, int height,
+    int *retWidth, int *retHeight,
+    float zm,
+    Zoom_Type zt,
+    Zoom_Yuv zy);
+
+typedef struct Zoom_Yuv_Plan Zoom_Yuv_Plan;
+
+/*
+ *  创建平面yuv缩放计划
+ *  参数: 同 zoom_plan_create
+ *      zy: 平面yuv格式
+ *  返回: 计划指针,NULL失败 !! 用完记得zoom_yuv_plan_destroy() !!
+ */
+Zoom_Yuv_Plan *zoom_yuv_plan_create(
+    int width, int height,
+    int widthOut, int heightOut,
+    Zoom_Type zt,
+    Zoom_Yuv zy);
+
+/*
+ *  按计划缩放一帧平面yuv
+ *  参数:
+ *      plan: zoom_yuv_plan_create() 返回的计划
+ *      yuv: 源图像数据指针,各平面依次连续存放
+ *      yuvOut: 输出图像内存,至少 zoom_yuv_bytes(widthOut, heightOut, zy) 字节
+ *  返回: 0成功 -1失败
+ *  说明: 各平面依次执行, 每个平面内部按分块多线程处理; 同一计划不能被多个线程同时执行
+ */
+int zoom_yuv_plan_execute(Zoom_Yuv_Plan *plan, unsigned char *yuv, unsigned char *yuvOut);
+
+/*
+ *  释放平面yuv缩放计划
+ */
+void zoom_yuv_plan_destroy(Zoom_Yuv_Plan *plan);
+
+/*
+ *  平面yuv数据流处理
+ *  参数: 同 zoom_stream
+ *      srcRead: 源图片某个平面的行数据读取回调函数, plane 为平面序号(0/y 1/u或uv 2/v)
+ *             : 函数原型 int srcRead(void *obj, int plane, unsigned char *line, int lines)
+ *      distWrite: 输出图片某个平面的行数据回调函数
+ *             : 函数原型 int distWrite(void *obj, int plane, unsigned char *line, int lines)
+ *      zy: 平面yuv格式
+ *      batch: 亮度平面每次回调读写的最多行数,传0使用默认8行, 色度平面为其一半
+ *  说明: 各平面按各自的行顺序读写, 每输出2行亮度输出1行色度, 各平面的进度保持一致;
+ *       任一平面的 distWrite 返回0(出错)时, 余下各平面的行不再缩放、写出
+ */
+void zoom_stream_yuv(
+    void *objSrc, void *objDist,
+    int (*srcRead)(void *, int, unsigned char *, int),
+    int (*distWrite)(void *, int, unsigned char *, int),
+    int width, int height,
+    int *retWidth, int *retHeight,
+    float zm,
+    Zoom_Type zt,
+    Zoom_Yuv zy,
+    int batch);
 
 #endif
@@ -0,0 +1,973 @@
+/*
+ *  缩放行处理内核: 标量基准版本 + x86 SIMD版本, 运行时按cpu选择
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "zoom_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ZOOM_X86 1
+#include <immintrin.h>
+#endif
+
+// -------------------------- 标量基准版本 --------------------------
+// 以下inline函数的通道数n为常量, 由 _KERNEL_C(n) 按1、2、3、4通道各展开一份, 通道用 ZOOM_EACH 展开
+
+static inline void _linear_n(unsigned char *out, const unsigned char *line1, const unsigned char *line2,
+                             const Zoom_Step *xt, int count, int wy, const int n)
+{
+    const unsigned char *p11, *p12, *p21, *p22;
+    int x, wx, v0, v1, v2, v3;
+    for (x = 0; x < count; x += 1, xt += 1, out += n)
+    {
+        p11 = &line1[xt->i1 * n];
+        p12 = &line1[xt->i2 * n];
+        p21 = &line2[xt->i1 * n];
+        p22 = &line2[xt->i2 * n];
+        wx = xt->w;
+        //先全部算完再写出(字节写出可能与任何数据重叠,边算边写会迫使编译器重新读取)
+#define _V(c) v##c = LINEAR(p11[c], p12[c], p21[c], p22[c], wx, wy)
+#define _OUT(c) out[c] = v##c
+        ZOOM_EACH(n, _V);
+        ZOOM_EACH(n, _OUT);
+#undef _V
+#undef _OUT
+    }
+}
+
+static inline void _near_n(unsigned char *out, const unsigned char *line1,
+                           const Zoom_Step *xt, int count, const int n)
+{
+    int x;
+    for (x = 0; x < count; x += 1, xt += 1, out += n)
+        memcpy(out, &line1[xt->i1 * n], n);
+}
+
+static inline void _linear_h_n(unsigned short *out, const unsigned char *line1,
+                               const Zoom_Step *xt, int count, const int n)
+{
+    const unsigned char *p1, *p2;
+    int x, wx, v0, v1, v2, v3;
+    for (x = 0; x < count; x += 1, xt += 1, out += n)
+    {
+        p1 = &line1[xt->i1 * n];
+        p2 = &line1[xt->i2 * n];
+        wx = xt->w;
+#define _V(c) v##c = p1[c] * (ZOOM_W_ONE - wx) + p2[c] * wx
+#define _OUT(c) out[c] = v##c
+        ZOOM_EACH(n, _V);
+        ZOOM_EACH(n, _OUT);
+#undef _V
+#undef _OUT
+    }
+}
+
+//垂直插值n个通道值
+static inline void _linear_v_n(unsigned char *out, const unsigned short *h1, const unsigned short *h2,
+                               int n, int wy)
+{
+    int i;
+    for (i = 0; i < n; i += 1)
+        out[i] = (unsigned char)((h1[i] * (ZOOM_W_ONE - wy) + h2[i] * wy +
+                                  (1 << (ZOOM_W_BITS * 2 - 1))) >> (ZOOM_W_BITS * 2));
+}
+
+static void _linear_v_c(unsigned char *out, const unsigned short *h1, const unsigned short *h2,
+                        int count, int wy)
+{
+    _linear_v_n(out, h1, h2, count, wy);
+}
+
+/*
+ *  有理数倍率重复模式(标量): 常用倍率的 p、q 为编译期常量, 一个周期(p个输出点、q个源像素)内各点的
+ *  源序号和权重在编译期算出, 周期内完全展开, 不读定位表, 与 jpeg_zoom2 的固定节奏相同;
+ *  其它倍率返回0交给通用版本(逐组查表并不比顺序读取整行的定位表快)
+ */
+
+//周期内第j点的源坐标(Q16)、序号和权重, 与 _zoom_step_table 按 p/q 的定位一致
+#define _PQ_POS(j, p, q) (((j) * (q) << ZOOM_FIX_BITS) / (p))
+#define _PQ_I1(j, p, q) (_PQ_POS(j, p, q) >> ZOOM_FIX_BITS)
+#define _PQ_I2(j, p, q) (_PQ_I1(j, p, q) + ((_PQ_POS(j, p, q) & ((1 << ZOOM_FIX_BITS) - 1)) != 0))
+#define _PQ_W(j, p, q) ((_PQ_POS(j, p, q) >> (ZOOM_FIX_BITS - ZOOM_W_BITS)) & (ZOOM_W_ONE - 1))
+
+//按 p/q 展开的常用倍率: 2、3、4、1.5、2.5、4/3、0.5、0.25、2/3、0.75
+#define _PQ_SWITCH(r, f, ...)                         \
+    switch ((r)->p * 16 + (r)->q)                     \
+    {                                                 \
+    case 2 * 16 + 1: return f(__VA_ARGS__, 2, 1);     \
+    case 3 * 16 + 1: return f(__VA_ARGS__, 3, 1);     \
+    case 4 * 16 + 1: return f(__VA_ARGS__, 4, 1);     \
+    case 3 * 16 + 2: return f(__VA_ARGS__, 3, 2);     \
+    case 5 * 16 + 2: return f(__VA_ARGS__, 5, 2);     \
+    case 4 * 16 + 3: return f(__VA_ARGS__, 4, 3);     \
+    case 1 * 16 + 2: return f(__VA_ARGS__, 1, 2);     \
+    case 1 * 16 + 4: return f(__VA_ARGS__, 1, 4);     \
+    case 2 * 16 + 3: return f(__VA_ARGS__, 2, 3);     \
+    case 3 * 16 + 4: return f(__VA_ARGS__, 3, 4);     \
+    default: return 0;                                \
+    }
+
+//不越出 count 个输出点、不读到源图像第 width 点及之后的整周期数, last 为一个周期用到的最大源序号
+static inline int _pq_periods(int count, int width, int last, const int p, const int q)
+{
+    int k = count / p, w = width > last ? (width - 1 - last) / q + 1 : 0;
+    return k < w ? k : w;
+}
+
+//按周期内的点展开(p为常量, 最多8点), 各点的序号和权重都是编译期常量;
+//每种倍率各内联一份(须强制内联, 否则函数体较大时 p、q 不再是常量)
+#define _PQ_EACH(p, op) \
+    do                  \
+    {                   \
+        op(0);          \
+        if (p > 1)      \
+            op(1);      \
+        if (p > 2)      \
+            op(2);      \
+        if (p > 3)      \
+            op(3);      \
+        if (p > 4)      \
+            op(4);      \
+        if (p > 5)      \
+            op(5);      \
+        if (p > 6)      \
+            op(6);      \
+        if (p > 7)      \
+            op(7);      \
+    } while (0)
+
+__attribute__((always_inline)) static inline int _linear_pq_n(
+    unsigned char *out, const unsigned char *line1, const unsigned char *line2,
+    int count, int width, int wy, const int n, const int p, const int q)
+{
+    int k = _pq_periods(count, width, _PQ_I2(p - 1, p, q), p, q), i;
+    for (i = 0; i < k; i += 1, line1 += q * n, line2 += q * n, out += p * n)
+    {
+#define _C(j, c) out[(j) * n + c] = LINEAR(line1[_PQ_I1(j, p, q) * n + c], line1[_PQ_I2(j, p, q) * n + c], \
+                                           line2[_PQ_I1(j, p, q) * n + c], line2[_PQ_I2(j, p, q) * n + c], _PQ_W(j, p, q), wy)
+#define _P(j)          \
+    do                 \
+    {                  \
+        _C(j, 0);      \
+        if (n > 1)     \
+            _C(j, 1);  \
+        if (n > 2)     \
+            _C(j, 2);  \
+        if (n > 3)     \
+            _C(j, 3);  \
+    } while (0)
+        _PQ_EACH(p, _P);
+#undef _C
+    }
+    return k * p;
+}
+
+__attribute__((always_inline)) static inline int _near_pq_n(
+    unsigned char *out, const unsigned char *line1, int count, int width, const int n, const int p, const int q)
+{
+    int k = _pq_periods(count, width, _PQ_I1(p - 1, p, q), p, q), i;
+    for (i = 0; i < k; i += 1, line1 += q * n, out += p * n)
+    {
+#define _N(j) memcpy(&out[(j) * n], &line1[_PQ_I1(j, p, q) * n], n)
+        _PQ_EACH(p, _N);
+#undef _N
+    }
+    return k * p;
+}
+
+__attribute__((always_inline)) static inline int _linear_h_pq_n(
+    unsigned short *out, const unsigned char *line1, int count, int width, const int n, const int p, const int q)
+{
+    int k = _pq_periods(count, width, _PQ_I2(p - 1, p, q), p, q), i;
+    for (i = 0; i < k; i += 1, line1 += q * n, out += p * n)
+    {
+#define _C(j, c) out[(j) * n + c] = line1[_PQ_I1(j, p, q) * n + c] * (ZOOM_W_ONE - _PQ_W(j, p, q)) + \
+                                    line1[_PQ_I2(j, p, q) * n + c] * _PQ_W(j, p, q)
+        _PQ_EACH(p, _P);
+#undef _C
+    }
+    return k * p;
+}
+#undef _P
+
+#define _KERNEL_C(n) \
+static void _linear_c##n(unsigned char *out, const unsigned char *line1, const unsigned char *line2, \
+                         const Zoom_Step *xt, int count, int width, int wy) \
+{ \
+    _linear_n(out, line1, line2, xt, count, wy, n); \
+} \
+static void _near_c##n(unsigned char *out, const unsigned char *line1, \
+                       const Zoom_Step *xt, int count, int width) \
+{ \
+    _near_n(out, line1, xt, count, n); \
+} \
+static void _linear_h_c##n(unsigned short *out, const unsigned char *line1, \
+                           const Zoom_Step *xt, int count, int width) \
+{ \
+    _linear_h_n(out, line1, xt, count, n); \
+} \
+static int _linear_ratio_c##n(unsigned char *out, const unsigned char *line1, const unsigned char *line2, \
+                              const Zoom_Ratio *r, int count, int width, int wy) \
+{ \
+    _PQ_SWITCH(r, _linear_pq_n, out, line1, line2, count, width, wy, n) \
+} \
+static int _near_ratio_c##n(unsigned char *out, const unsigned char *line1, \
+                            const Zoom_Ratio *r, int count, int width) \
+{ \
+    _PQ_SWITCH(r, _near_pq_n, out, line1, count, width, n) \
+} \
+static int _linear_h_ratio_c##n(unsigned short *out, const unsigned char *line1, \
+                                const Zoom_Ratio *r, int count, int width) \
+{ \
+    _PQ_SWITCH(r, _linear_h_pq_n, out, line1, count, width, n) \
+} \
+static const Zoom_Kernel _kernel_c##n = { \
+    .name = "c", \
+    .channels = n, \
+    .linear = &_linear_c##n, \
+    .near = &_near_c##n, \
+    .linear_h = &_linear_h_c##n, \
+    .linear_v = &_linear_v_c, \
+    .linear_ratio = &_linear_ratio_c##n, \
+    .near_ratio = &_near_ratio_c##n, \
+    .linear_h_ratio = &_linear_h_ratio_c##n, \
+};
+
+_KERNEL_C(1)
+_KERNEL_C(2)
+_KERNEL_C(3)
+_KERNEL_C(4)
+
+#ifdef ZOOM_X86
+
+// -------------------------- x86 SIMD版本 --------------------------
+// 3通道: 像素按4字节整读(第4字节为下一像素的r,计算后丢弃), 只要像素序号 <= width - 2 就不会越界,
+// 每组像素先检查该组最后一个序号(定位表单调递增), 不满足时余下部分交给标量版本
+// 4通道: 像素正好4字节, 整读整写, 不需要检查行尾
+
+//非对齐4字节读写
+static inline int _load_px(const unsigned char *p)
+{
+    int v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline void _store_12(void *out, __m128i v)
+{
+    int tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+    _mm_storel_epi64((__m128i *)out, v);
+    memcpy((unsigned char *)out + 8, &tail, 4);
+}
+
+/*
+ *  4个像素(rgbx rgbx rgbx rgbx)的双线性插值, 与 LINEAR() 逐字节一致
+ *  a、b、c、d: p11、p12、p21、p22, wx: 4个像素的右侧点权重(32位x4)
+ *  返回: 16字节, 每像素rgbx
+ */
+__attribute__((target("sse2"))) static inline __m128i _linear4_sse2(
+    __m128i a, __m128i b, __m128i c, __m128i d, __m128i wx, __m128i wyv, __m128i wy1v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(ZOOM_W_ONE);
+    const __m128i round = _mm_set1_epi32(1 << (ZOOM_W_BITS * 2 - 1));
+    __m128i wxl, wxh, wx1l, wx1h;
+    __m128i top, bot, lo, hi, s0, s1, r0, r1;
+
+    //权重扩展到每像素4个16位通道: [w0 w0 w0 w0 w1 w1 w1 w1], [w2 .. w3 ..]
+    wx = _mm_or_si128(wx, _mm_slli_epi32(wx, 16));
+    wxl = _mm_unpacklo_epi32(wx, wx);
+    wxh = _mm_unpackhi_epi32(wx, wx);
+    wx1l = _mm_sub_epi16(one, wxl);
+    wx1h = _mm_sub_epi16(one, wxh);
+
+    //前2个像素: 水平插值结果最大 255 * 256, 16位无符号不溢出
+    top = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), wx1l),
+                        _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), wxl));
+    bot = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(c, zero), wx1l),
+                        _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), wxl));
+    //垂直插值需32位
+    lo = _mm_mullo_epi16(top, wy1v);
+    hi = _mm_mulhi_epu16(top, wy1v);
+    s0 = _mm_unpacklo_epi16(lo, hi);
+    s1 = _mm_unpackhi_epi16(lo, hi);
+    lo = _mm_mullo_epi16(bot, wyv);
+    hi = _mm_mulhi_epu16(bot, wyv);
+    s0 = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(s0, _mm_unpacklo_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+    s1 = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(s1, _mm_unpackhi_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+    r0 = _mm_packs_epi32(s0, s1);
+
+    //后2个像素
+    top = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), wx1h),
+                        _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), wxh));
+    bot = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(c, zero), wx1h),
+                        _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), wxh));
+    lo = _mm_mullo_epi16(top, wy1v);
+    hi = _mm_mulhi_epu16(top, wy1v);
+    s0 = _mm_unpacklo_epi16(lo, hi);
+    s1 = _mm_unpackhi_epi16(lo, hi);
+    lo = _mm_mullo_epi16(bot, wyv);
+    hi = _mm_mulhi_epu16(bot, wyv);
+    s0 = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(s0, _mm_unpacklo_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+    s1 = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(s1, _mm_unpackhi_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+    r1 = _mm_packs_epi32(s0, s1);
+
+    return _mm_packus_epi16(r0, r1);
+}
+
+//读取4个像素, n为每像素字节数
+#define _GATHER4(line, xt, i, n) _mm_setr_epi32( \
+    _load_px(&line[xt[0].i * n]), _load_px(&line[xt[1].i * n]), \
+    _load_px(&line[xt[2].i * n]), _load_px(&line[xt[3].i * n]))
+
+__attribute__((target("sse2"))) static void _linear_sse2(
+    unsigned char *out, const unsigned char *line1, const unsigned char *line2,
+    const Zoom_Step *xt, int count, int width, int wy)
+{
+    const __m128i wyv = _mm_set1_epi16(wy);
+    const __m128i wy1v = _mm_set1_epi16(ZOOM_W_ONE - wy);
+    unsigned char px[16];
+    __m128i v;
+    int x, i;
+
+    for (x = 0; x + 4 <= count && xt[3].i2 < width - 1; x += 4, xt += 4, out += 12)
+    {
+        v = _linear4_sse2(
+            _GATHER4(line1, xt, i1, 3), _GATHER4(line1, xt, i2, 3),
+            _GATHER4(line2, xt, i1, 3), _GATHER4(line2, xt, i2, 3),
+            _mm_setr_epi32(xt[0].w, xt[1].w, xt[2].w, xt[3].w), wyv, wy1v);
+        //sse2没有字节重排指令,rgbx按4字节依次写出(后一个覆盖前一个的第4字节),最后一个只写3字节
+        _mm_storeu_si128((__m128i *)px, v);
+        for (i = 0; i < 3; i++)
+            memcpy(&out[i * 3], &px[i * 4], 4);
+        memcpy(&out[9], &px[12], 3);
+    }
+    _linear_c3(out, line1, line2, xt, count - x, width, wy);
+}
+
+//4通道: 4个像素整读, 结果正好16字节
+__attribute__((target("sse2"))) static void _linear_rgbx_sse2(
+    unsigned char *out, const unsigned char *line1, const unsigned char *line2,
+    const Zoom_Step *xt, int count, int width, int wy)
+{
+    const __m128i wyv = _mm_set1_epi16(wy);
+    const __m128i wy1v = _mm_set1_epi16(ZOOM_W_ONE - wy);
+    int x;
+
+    for (x = 0; x + 4 <= count; x += 4, xt += 4, out += 16)
+    {
+        _mm_storeu_si128((__m128i *)out, _linear4_sse2(
+            _GATHER4(line1, xt, i1, 4), _GATHER4(line1, xt, i2, 4),
+            _GATHER4(line2, xt, i1, 4), _GATHER4(line2, xt, i2, 4),
+            _mm_setr_epi32(xt[0].w, xt[1].w, xt[2].w, xt[3].w), wyv, wy1v));
+    }
+    _linear_c4(out, line1, line2, xt, count - x, width, wy);
+}
+
+/*
+ *  垂直插值: 16个Q8水平插值结果, 与 _linear_v_c 逐字节一致
+ *  返回: 16字节结果
+ */
+__attribute__((target("sse2"))) static inline __m128i _linear_v16_sse2(
+    const unsigned short *h1, const unsigned short *h2, __m128i wyv, __m128i wy1v)
+{
+    const __m128i round = _mm_set1_epi32(1 << (ZOOM_W_BITS * 2 - 1));
+    __m128i a, b, lo, hi, s0, s1, r[2];
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        a = _mm_loadu_si128((const __m128i *)&h1[i * 8]);
+        b = _mm_loadu_si128((const __m128i *)&h2[i * 8]);
+        lo = _mm_mullo_epi16(a, wy1v);
+        hi = _mm_mulhi_epu16(a, wy1v);
+        s0 = _mm_unpacklo_epi16(lo, hi);
+        s1 = _mm_unpackhi_epi16(lo, hi);
+        lo = _mm_mullo_epi16(b, wyv);
+        hi = _mm_mulhi_epu16(b, wyv);
+        s0 = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(s0, _mm_unpacklo_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+        s1 = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(s1, _mm_unpackhi_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+        r[i] = _mm_packs_epi32(s0, s1);
+    }
+    return _mm_packus_epi16(r[0], r[1]);
+}
+
+__attribute__((target("sse2"))) static void _linear_v_sse2(
+    unsigned char *out, const unsigned short *h1, const unsigned short *h2, int count, int wy)
+{
+    const __m128i wyv = _mm_set1_epi16(wy);
+    const __m128i wy1v = _mm_set1_epi16(ZOOM_W_ONE - wy);
+    int i;
+
+    //按通道值处理,与像素边界无关
+    for (i = 0; i + 16 <= count; i += 16)
+        _mm_storeu_si128((__m128i *)&out[i], _linear_v16_sse2(&h1[i], &h2[i], wyv, wy1v));
+    _linear_v_n(&out[i], &h1[i], &h2[i], count - i, wy);
+}
+
+// rgbx rgbx rgbx rgbx -> rgbrgbrgbrgb
+#define _PACK_RGB_MASK 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+// 16位通道 rgbx rgbx -> rgbrgb
+#define _PACK_RGB16_MASK 0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1
+
+__attribute__((target("ssse3"))) static void _linear_ssse3(
+    unsigned char *out, const unsigned char *line1, const unsigned char *line2,
+    const Zoom_Step *xt, int count, int width, int wy)
+{
+    const __m128i wyv = _mm_set1_epi16(wy);
+    const __m128i wy1v = _mm_set1_epi16(ZOOM_W_ONE - wy);
+    const __m128i mask = _mm_setr_epi8(_PACK_RGB_MASK);
+    __m128i v;
+    int x;
+
+    for (x = 0; x + 4 <= count && xt[3].i2 < width - 1; x += 4, xt += 4, out += 12)
+    {
+        v = _linear4_sse2(
+            _GATHER4(line1, xt, i1, 3), _GATHER4(line1, xt, i2, 3),
+            _GATHER4(line2, xt, i1, 3), _GATHER4(line2, xt, i2, 3),
+            _mm_setr_epi32(xt[0].w, xt[1].w, xt[2].w, xt[3].w), wyv, wy1v);
+        _store_12(out, _mm_shuffle_epi8(v, mask));
+    }
+    _linear_c3(out, line1, line2, xt, count - x, width, wy);
+}
+
+__attribute__((target("ssse3"))) static void _near_ssse3(
+    unsigned char *out, const unsigned char *line1,
+    const Zoom_Step *xt, int count, int width)
+{
+    const __m128i mask = _mm_setr_epi8(_PACK_RGB_MASK);
+    int x;
+
+    for (x = 0; x + 4 <= count && xt[3].i1 < width - 1; x += 4, xt += 4, out += 12)
+        _store_12(out, _mm_shuffle_epi8(_GATHER4(line1, xt, i1, 3), mask));
+    _near_c3(out, line1, xt, count - x, width);
+}
+
+/*
+ *  有理数倍率重复模式: 源图像按16字节块整读, 用重排表取出一个向量的4个像素(3、4通道),
+ *  每组先检查读取范围不越过行尾, 不满足时余下部分交给通用版本; 重排表不可用(一个向量跨度太大)时改用标量版本
+ */
+__attribute__((target("ssse3"))) static inline __m128i _ratio_pick(
+    const unsigned char *src, const unsigned char (*mask)[16], int loads)
+{
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src),
+                                 _mm_loadu_si128((const __m128i *)mask[0]));
+    int n;
+    for (n = 1; n < loads; n++)
+        v = _mm_or_si128(v, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&src[n * 16]),
+                                              _mm_loadu_si128((const __m128i *)mask[n])));
+    return v;
+}
+
+//一个向量的rgbx结果写出: 3通道压缩成12字节rgb, 4通道整16字节
+__attribute__((target("ssse3"))) static inline void _ratio_store(unsigned char *out, __m128i v, const int n)
+{
+    if (n == 3)
+        _store_12(out, _mm_shuffle_epi8(v, _mm_setr_epi8(_PACK_RGB_MASK)));
+    else
+        _mm_storeu_si128((__m128i *)out, v);
+}
+
+//16位通道结果写出: 3通道 rgbx rgbx -> rgbrgb(12字节), 4通道整16字节
+__attribute__((target("ssse3"))) static inline void _ratio_store16(unsigned short *out, __m128i v, const int n)
+{
+    if (n == 3)
+        _store_12(out, _mm_shuffle_epi8(v, _mm_setr_epi8(_PACK_RGB16_MASK)));
+    else
+        _mm_storeu_si128((__m128i *)out, v);
+}
+
+//3通道最近点插值: 重排表直接得到rgb排列(12字节)
+__attribute__((target("ssse3"))) static int _near_ratio_ssse3(
+    unsigned char *out, const unsigned char *src,
+    const Zoom_Ratio *r, int count, int width)
+{
+    int x, i, base;
+
+    //缩小时一个向量要拼接多个块, 只有数据搬运的最近点插值不比通用版本(逐点读取)快, 标量重复模式也不比它快
+    if (!r->simd || r->loads > 1)
+        return 0;
+
+    for (x = base = 0; x + r->group <= count && base + r->reach <= width * 3; x += r->group, base += r->step * 3)
+    {
+        for (i = 0; i < r->vectors; i++, out += 12)
+            _store_12(out, _ratio_pick(&src[base + r->off[i] * 3], r->near[i], 1));
+    }
+    return x;
+}
+
+__attribute__((target("ssse3"))) static inline int _linear_ratio_ssse3_n(
+    unsigned char *out, const unsigned char *src1, const unsigned char *src2,
+    const Zoom_Ratio *r, int count, int width, int wy, const int n, const int loads)
+{
+    const __m128i wyv = _mm_set1_epi16(wy);
+    const __m128i wy1v = _mm_set1_epi16(ZOOM_W_ONE - wy);
+    const unsigned char *s1, *s2;
+    int x, i, base;
+
+    for (x = base = 0; x + r->group <= count && base + r->reach <= width * n; x += r->group, base += r->step * n)
+    {
+        for (i = 0; i < r->vectors; i++, out += 4 * n)
+        {
+            s1 = &src1[base + r->off[i] * n];
+            s2 = &src2[base + r->off[i] * n];
+            _ratio_store(out, _linear4_sse2(
+                _ratio_pick(s1, r->i1[i], loads), _ratio_pick(s1, r->i2[i], loads),
+                _ratio_pick(s2, r->i1[i], loads), _ratio_pick(s2, r->i2[i], loads),
+                _mm_loadu_si128((const __m128i *)r->wx[i]), wyv, wy1v), n);
+        }
+    }
+    return x;
+}
+
+__attribute__((target("ssse3"))) static inline int _linear_h_ratio_ssse3_n(
+    unsigned short *out, const unsigned char *src,
+    const Zoom_Ratio *r, int count, int width, const int n, const int loads)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(ZOOM_W_ONE);
+    __m128i a, b, wx, wxl, wxh;
+    int x, i, base;
+
+    for (x = base = 0; x + r->group <= count && base + r->reach <= width * n; x += r->group, base += r->step * n)
+    {
+        for (i = 0; i < r->vectors; i++, out += 4 * n)
+        {
+            a = _ratio_pick(&src[base + r->off[i] * n], r->i1[i], loads);
+            b = _ratio_pick(&src[base + r->off[i] * n], r->i2[i], loads);
+            //权重扩展方式同 _linear4_sse2
+            wx = _mm_loadu_si128((const __m128i *)r->wx[i]);
+            wx = _mm_or_si128(wx, _mm_slli_epi32(wx, 16));
+            wxl = _mm_unpacklo_epi32(wx, wx);
+            wxh = _mm_unpackhi_epi32(wx, wx);
+            _ratio_store16(out,
+                _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_sub_epi16(one, wxl)),
+                              _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), wxl)), n);
+            _ratio_store16(out + 2 * n,
+                _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_sub_epi16(one, wxh)),
+                              _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), wxh)), n);
+        }
+    }
+    return x;
+}
+
+/*
+ *  双线性插值3通道、4通道各展开一份, 放大时一个向量只读1块, 块数按常量展开;
+ *  整数倍缩小(p == 1)时权重都为0, 标量版本展开后只是拷贝, 比拼接多块快, 改用标量版本
+ */
+#define _KERNEL_RATIO_SSSE3(n, name, c) \
+__attribute__((target("ssse3"))) static int _linear_ratio_##name( \
+    unsigned char *out, const unsigned char *src1, const unsigned char *src2, \
+    const Zoom_Ratio *r, int count, int width, int wy) \
+{ \
+    if (!r->simd || r->p == 1) \
+        return _linear_ratio_##c(out, src1, src2, r, count, width, wy); \
+    if (r->loads == 1) \
+        return _linear_ratio_ssse3_n(out, src1, src2, r, count, width, wy, n, 1); \
+    return _linear_ratio_ssse3_n(out, src1, src2, r, count, width, wy, n, r->loads); \
+} \
+__attribute__((target("ssse3"))) static int _linear_h_ratio_##name( \
+    unsigned short *out, const unsigned char *src, const Zoom_Ratio *r, int count, int width) \
+{ \
+    if (!r->simd || r->p == 1) \
+        return _linear_h_ratio_##c(out, src, r, count, width); \
+    if (r->loads == 1) \
+        return _linear_h_ratio_ssse3_n(out, src, r, count, width, n, 1); \
+    return _linear_h_ratio_ssse3_n(out, src, r, count, width, n, r->loads); \
+}
+
+_KERNEL_RATIO_SSSE3(3, ssse3, c3)
+_KERNEL_RATIO_SSSE3(4, rgbx_ssse3, c4)
+
+//sse2 4通道双线性插值按32位整像素处理, 缩小时比标量重复模式快, 只在放大时使用重复模式
+static int _linear_ratio_rgbx_sse2(unsigned char *out, const unsigned char *line1, const unsigned char *line2,
+                                   const Zoom_Ratio *r, int count, int width, int wy)
+{
+    if (r->p < r->q)
+        return 0;
+    return _linear_ratio_c4(out, line1, line2, r, count, width, wy);
+}
+
+/*
+ *  avx2: 8个像素一组, 定位表和像素都用gather指令读取
+ *  定位表为 {i1, i2, w} 3个int一组, 按步长3个int收集
+ */
+#define _TABLE_INDEX _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21)
+
+__attribute__((target("avx2"))) static inline __m256i _linear8_avx2(
+    __m256i a, __m256i b, __m256i c, __m256i d, __m256i wx, __m256i wyv, __m256i wy1v)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(ZOOM_W_ONE);
+    const __m256i round = _mm256_set1_epi32(1 << (ZOOM_W_BITS * 2 - 1));
+    __m256i wxl, wxh, wx1l, wx1h;
+    __m256i top, bot, lo, hi, s0, s1, r0, r1;
+
+    //每个128位通道内与sse2版本相同
+    wx = _mm256_or_si256(wx, _mm256_slli_epi32(wx, 16));
+    wxl = _mm256_unpacklo_epi32(wx, wx);
+    wxh = _mm256_unpackhi_epi32(wx, wx);
+    wx1l = _mm256_sub_epi16(one, wxl);
+    wx1h = _mm256_sub_epi16(one, wxh);
+
+    top = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), wx1l),
+                           _mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), wxl));
+    bot = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(c, zero), wx1l),
+                           _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), wxl));
+    lo = _mm256_mullo_epi16(top, wy1v);
+    hi = _mm256_mulhi_epu16(top, wy1v);
+    s0 = _mm256_unpacklo_epi16(lo, hi);
+    s1 = _mm256_unpackhi_epi16(lo, hi);
+    lo = _mm256_mullo_epi16(bot, wyv);
+    hi = _mm256_mulhi_epu16(bot, wyv);
+    s0 = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(s0, _mm256_unpacklo_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+    s1 = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(s1, _mm256_unpackhi_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+    r0 = _mm256_packs_epi32(s0, s1);
+
+    top = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), wx1h),
+                           _mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), wxh));
+    bot = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(c, zero), wx1h),
+                           _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), wxh));
+    lo = _mm256_mullo_epi16(top, wy1v);
+    hi = _mm256_mulhi_epu16(top, wy1v);
+    s0 = _mm256_unpacklo_epi16(lo, hi);
+    s1 = _mm256_unpackhi_epi16(lo, hi);
+    lo = _mm256_mullo_epi16(bot, wyv);
+    hi = _mm256_mulhi_epu16(bot, wyv);
+    s0 = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(s0, _mm256_unpacklo_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+    s1 = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(s1, _mm256_unpackhi_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+    r1 = _mm256_packs_epi32(s0, s1);
+
+    return _mm256_packus_epi16(r0, r1);
+}
+
+//8个rgbx压缩成24字节rgb写出
+__attribute__((target("avx2"))) static inline void _store_24(unsigned char *out, __m256i v)
+{
+    const __m256i mask = _mm256_setr_epi8(_PACK_RGB_MASK, _PACK_RGB_MASK);
+    v = _mm256_shuffle_epi8(v, mask);
+    _store_12(out, _mm256_castsi256_si128(v));
+    _store_12(out + 12, _mm256_extracti128_si256(v, 1));
+}
+
+__attribute__((target("avx2"))) static void _linear_avx2(
+    unsigned char *out, const unsigned char *line1, const unsigned char *line2,
+    const Zoom_Step *xt, int count, int width, int wy)
+{
+    const __m256i wyv = _mm256_set1_epi16(wy);
+    const __m256i wy1v = _mm256_set1_epi16(ZOOM_W_ONE - wy);
+    const __m256i index = _TABLE_INDEX;
+    __m256i i1, i2, wx;
+    int x;
+
+    for (x = 0; x + 8 <= count && xt[7].i2 < width - 1; x += 8, xt += 8, out += 24)
+    {
+        i1 = _mm256_i32gather_epi32(&xt->i1, index, 4);
+        i2 = _mm256_i32gather_epi32(&xt->i2, index, 4);
+        wx = _mm256_i32gather_epi32(&xt->w, index, 4);
+        //像素序号转字节偏移
+        i1 = _mm256_add_epi32(i1, _mm256_slli_epi32(i1, 1));
+        i2 = _mm256_add_epi32(i2, _mm256_slli_epi32(i2, 1));
+        _store_24(out, _linear8_avx2(
+            _mm256_i32gather_epi32((const int *)line1, i1, 1),
+            _mm256_i32gather_epi32((const int *)line1, i2, 1),
+            _mm256_i32gather_epi32((const int *)line2, i1, 1),
+            _mm256_i32gather_epi32((const int *)line2, i2, 1),
+            wx, wyv, wy1v));
+    }
+    _linear_ssse3(out, line1, line2, xt, count - x, width, wy);
+}
+
+//4通道: 像素序号直接按4字节比例收集, 8个像素结果正好32字节
+__attribute__((target("avx2"))) static void _linear_rgbx_avx2(
+    unsigned char *out, const unsigned char *line1, const unsigned char *line2,
+    const Zoom_Step *xt, int count, int width, int wy)
+{
+    const __m256i wyv = _mm256_set1_epi16(wy);
+    const __m256i wy1v = _mm256_set1_epi16(ZOOM_W_ONE - wy);
+    const __m256i index = _TABLE_INDEX;
+    __m256i i1, i2, wx;
+    int x;
+
+    for (x = 0; x + 8 <= count; x += 8, xt += 8, out += 32)
+    {
+        i1 = _mm256_i32gather_epi32(&xt->i1, index, 4);
+        i2 = _mm256_i32gather_epi32(&xt->i2, index, 4);
+        wx = _mm256_i32gather_epi32(&xt->w, index, 4);
+        _mm256_storeu_si256((__m256i *)out, _linear8_avx2(
+            _mm256_i32gather_epi32((const int *)line1, i1, 4),
+            _mm256_i32gather_epi32((const int *)line1, i2, 4),
+            _mm256_i32gather_epi32((const int *)line2, i1, 4),
+            _mm256_i32gather_epi32((const int *)line2, i2, 4),
+            wx, wyv, wy1v));
+    }
+    _linear_rgbx_sse2(out, line1, line2, xt, count - x, width, wy);
+}
+
+//垂直插值: 32个值一组, 每个128位通道内与sse2版本相同, 最后恢复两个通道的顺序
+__attribute__((target("avx2"))) static void _linear_v_avx2(
+    unsigned char *out, const unsigned short *h1, const unsigned short *h2, int count, int wy)
+{
+    const __m256i wyv = _mm256_set1_epi16(wy);
+    const __m256i wy1v = _mm256_set1_epi16(ZOOM_W_ONE - wy);
+    const __m256i round = _mm256_set1_epi32(1 << (ZOOM_W_BITS * 2 - 1));
+    __m256i a, b, lo, hi, s0, s1, r[2];
+    int i, j;
+
+    for (i = 0; i + 32 <= count; i += 32)
+    {
+        for (j = 0; j < 2; j++)
+        {
+            a = _mm256_loadu_si256((const __m256i *)&h1[i + j * 16]);
+            b = _mm256_loadu_si256((const __m256i *)&h2[i + j * 16]);
+            lo = _mm256_mullo_epi16(a, wy1v);
+            hi = _mm256_mulhi_epu16(a, wy1v);
+            s0 = _mm256_unpacklo_epi16(lo, hi);
+            s1 = _mm256_unpackhi_epi16(lo, hi);
+            lo = _mm256_mullo_epi16(b, wyv);
+            hi = _mm256_mulhi_epu16(b, wyv);
+            s0 = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(s0, _mm256_unpacklo_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+            s1 = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(s1, _mm256_unpackhi_epi16(lo, hi)), round), ZOOM_W_BITS * 2);
+            r[j] = _mm256_packs_epi32(s0, s1);
+        }
+        _mm256_storeu_si256((__m256i *)&out[i], _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(r[0], r[1]), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    _linear_v_n(&out[i], &h1[i], &h2[i], count - i, wy);
+}
+
+//水平插值每行源图像只做一次, 逐像素读取的标量版本实测比拼装寄存器的SIMD版本快, 各级共用;
+//1、2通道只有垂直插值用SIMD版本, 4通道最近点插值是4字节整拷贝, 标量版本已是整像素操作
+static const Zoom_Kernel _kernel_sse2_1 = {
+    .name = "sse2",
+    .channels = 1,
+    .linear = &_linear_c1,
+    .near = &_near_c1,
+    .linear_h = &_linear_h_c1,
+    .linear_v = &_linear_v_sse2,
+    .linear_ratio = &_linear_ratio_c1,
+    .near_ratio = &_near_ratio_c1,
+    .linear_h_ratio = &_linear_h_ratio_c1,
+};
+
+static const Zoom_Kernel _kernel_sse2_2 = {
+    .name = "sse2",
+    .channels = 2,
+    .linear = &_linear_c2,
+    .near = &_near_c2,
+    .linear_h = &_linear_h_c2,
+    .linear_v = &_linear_v_sse2,
+    .linear_ratio = &_linear_ratio_c2,
+    .near_ratio = &_near_ratio_c2,
+    .linear_h_ratio = &_linear_h_ratio_c2,
+};
+
+static const Zoom_Kernel _kernel_sse2_3 = {
+    .name = "sse2",
+    .channels = 3,
+    .linear = &_linear_sse2,
+    .near = &_near_c3,
+    .linear_h = &_linear_h_c3,
+    .linear_v = &_linear_v_sse2,
+    .linear_ratio = &_linear_ratio_c3,
+    .near_ratio = &_near_ratio_c3,
+    .linear_h_ratio = &_linear_h_ratio_c3,
+};
+
+static const Zoom_Kernel _kernel_sse2_4 = {
+    .name = "sse2",
+    .channels = 4,
+    .linear = &_linear_rgbx_sse2,
+    .near = &_near_c4,
+    .linear_h = &_linear_h_c4,
+    .linear_v = &_linear_v_sse2,
+    .linear_ratio = &_linear_ratio_rgbx_sse2,
+    .near_ratio = &_near_ratio_c4,
+    .linear_h_ratio = &_linear_h_ratio_c4,
+};
+
+//ssse3的字节重排用于3通道的逐点读取和3、4通道的重复模式, 1、2通道沿用sse2版本
+static const Zoom_Kernel _kernel_ssse3_3 = {
+    .name = "ssse3",
+    .channels = 3,
+    .linear = &_linear_ssse3,
+    .near = &_near_ssse3,
+    .linear_h = &_linear_h_c3,
+    .linear_v = &_linear_v_sse2,
+    .linear_ratio = &_linear_ratio_ssse3,
+    .near_ratio = &_near_ratio_ssse3,
+    .linear_h_ratio = &_linear_h_ratio_ssse3,
+};
+
+static const Zoom_Kernel _kernel_ssse3_4 = {
+    .name = "ssse3",
+    .channels = 4,
+    .linear = &_linear_rgbx_sse2,
+    .near = &_near_c4,
+    .linear_h = &_linear_h_c4,
+    .linear_v = &_linear_v_sse2,
+    .linear_ratio = &_linear_ratio_rgbx_ssse3,
+    .near_ratio = &_near_ratio_c4,
+    .linear_h_ratio = &_linear_h_ratio_rgbx_ssse3,
+};
+
+//最近点插值只有数据搬运,硬件gather反而比逐个读取慢,沿用ssse3版本
+static const Zoom_Kernel _kernel_avx2_1 = {
+    .name = "avx2",
+    .channels = 1,
+    .linear = &_linear_c1,
+    .near = &_near_c1,
+    .linear_h = &_linear_h_c1,
+    .linear_v = &_linear_v_avx2,
+    .linear_ratio = &_linear_ratio_c1,
+    .near_ratio = &_near_ratio_c1,
+    .linear_h_ratio = &_linear_h_ratio_c1,
+};
+
+static const Zoom_Kernel _kernel_avx2_2 = {
+    .name = "avx2",
+    .channels = 2,
+    .linear = &_linear_c2,
+    .near = &_near_c2,
+    .linear_h = &_linear_h_c2,
+    .linear_v = &_linear_v_avx2,
+    .linear_ratio = &_linear_ratio_c2,
+    .near_ratio = &_near_ratio_c2,
+    .linear_h_ratio = &_linear_h_ratio_c2,
+};
+
+static const Zoom_Kernel _kernel_avx2_3 = {
+    .name = "avx2",
+    .channels = 3,
+    .linear = &_linear_avx2,
+    .near = &_near_ssse3,
+    .linear_h = &_linear_h_c3,
+    .linear_v = &_linear_v_avx2,
+    .linear_ratio = &_linear_ratio_ssse3,
+    .near_ratio = &_near_ratio_ssse3,
+    .linear_h_ratio = &_linear_h_ratio_ssse3,
+};
+
+static const Zoom_Kernel _kernel_avx2_4 = {
+    .name = "avx2",
+    .channels = 4,
+    .linear = &_linear_rgbx_avx2,
+    .near = &_near_c4,
+    .linear_h = &_linear_h_c4,
+    .linear_v = &_linear_v_avx2,
+    .linear_ratio = &_linear_ratio_rgbx_ssse3,
+    .near_ratio = &_near_ratio_c4,
+    .linear_h_ratio = &_linear_h_ratio_rgbx_ssse3,
+};
+
+#endif // ZOOM_X86
+
+// -------------------------- 有理数倍率重复模式 --------------------------
+
+//字节重排表(3、4通道的ssse3版本), 返回: 0成功 -1一个向量跨度太大
+static int _zoom_ratio_masks(Zoom_Ratio *r, const Zoom_Step *xt, int n)
+{
+    int v, t, c, j, pos, loads;
+
+    memset(r->near, 0x80, sizeof(r->near));
+    memset(r->i1, 0x80, sizeof(r->i1));
+    memset(r->i2, 0x80, sizeof(r->i2));
+    r->vectors = r->group / 4;
+
+    //按第一组的定位表生成,之后每组源序号整体后移step点
+    for (v = 0; v < r->vectors; v++)
+    {
+        r->off[v] = xt[v * 4].i1;
+        loads = ((xt[v * 4 + 3].i2 - r->off[v] + 1) * n + 15) / 16;
+        if (loads > ZOOM_RATIO_LOADS)
+            return -1;
+        if (loads > r->loads)
+            r->loads = loads;
+        for (t = 0; t < 4; t++)
+        {
+            j = v * 4 + t;
+            r->wx[v][t] = xt[j].w;
+            for (c = 0; c < n; c++)
+            {
+                pos = (xt[j].i1 - r->off[v]) * n + c;
+                r->near[v][pos / 16][t * n + c] = pos % 16;
+                r->i1[v][pos / 16][t * 4 + c] = pos % 16;
+                pos = (xt[j].i2 - r->off[v]) * n + c;
+                r->i2[v][pos / 16][t * 4 + c] = pos % 16;
+            }
+        }
+    }
+    for (v = 0; v < r->vectors; v++)
+    {
+        if (r->off[v] * n + r->loads * 16 > r->reach)
+            r->reach = r->off[v] * n + r->loads * 16;
+    }
+    return 0;
+}
+
+int zoom_ratio_init(Zoom_Ratio *r, const Zoom_Step *xt, int count, int p, int q, int n)
+{
+    int g;
+
+    memset(r, 0, sizeof(Zoom_Ratio));
+
+    //整周期且为4的倍数
+    for (g = 1; (p * g) % 4; g++)
+        ;
+    r->p = p;
+    r->q = q;
+    r->group = p * g;
+    r->step = q * g;
+    if (r->group > ZOOM_RATIO_POINTS || r->group > count)
+        return -1;
+
+    if (n == 3 || n == 4)
+        r->simd = _zoom_ratio_masks(r, xt, n) == 0;
+    return 0;
+}
+
+// -------------------------- 运行时选择 --------------------------
+
+//按通道数索引, 0不使用
+static const Zoom_Kernel *_kernel[5] = {NULL, &_kernel_c1, &_kernel_c2, &_kernel_c3, &_kernel_c4};
+static pthread_once_t _kernel_once = PTHREAD_ONCE_INIT;
+
+static void _kernel_init(void)
+{
+    char *env = getenv("ZOOM_SIMD");
+    int level = env ? atoi(env) : 3;
+#ifdef ZOOM_X86
+    __builtin_cpu_init();
+    if (level >= 3 && __builtin_cpu_supports("avx2"))
+    {
+        _kernel[1] = &_kernel_avx2_1;
+        _kernel[2] = &_kernel_avx2_2;
+        _kernel[3] = &_kernel_avx2_3;
+        _kernel[4] = &_kernel_avx2_4;
+    }
+    else if (level >= 1 && __builtin_cpu_supports("sse2"))
+    {
+        _kernel[1] = &_kernel_sse2_1;
+        _kernel[2] = &_kernel_sse2_2;
+        _kernel[3] = &_kernel_sse2_3;
+        _kernel[4] = &_kernel_sse2_4;
+        if (level >= 2 && __builtin_cpu_supports("ssse3"))
+        {
+            _kernel[3] = &_kernel_ssse3_3;
+            _kernel[4] = &_kernel_ssse3_4;
+        }
+    }
+#endif
+    (void)level;
+}
+
+const Zoom_Kernel *zoom_kernel(int channels)
+{
+    if (channels < 1 || channels > 4)
+        return NULL;
+    pthread_once(&_kernel_once, &_kernel_init);
+    return _kernel[channels];
+}
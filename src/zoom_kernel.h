@@ -0,0 +1,126 @@
+/*
+ *  缩放行处理内核(zoom.c内部使用)
+ *  标量版本为基准实现, SIMD版本须与其逐字节结果一致
+ *  每种通道数(1、2、3、4)各有一套内核, 通道数为编译期常量, 不做逐像素判断
+ */
+#ifndef __ZOOM_KERNEL_H_
+#define __ZOOM_KERNEL_H_
+
+// 定点数精度: 坐标Q16, 权重Q8(0~256)
+#define ZOOM_FIX_BITS 16
+#define ZOOM_W_BITS 8
+#define ZOOM_W_ONE (1 << ZOOM_W_BITS)
+
+// 定点双线性插值: wx 为右侧点(p12、p22)权重, wy 为下方行(p21、p22)权重, 全程整数乘加, 结果四舍五入
+#define LINEAR(p11, p12, p21, p22, wx, wy) \
+(unsigned char)((((p11) * (ZOOM_W_ONE - (wx)) + (p12) * (wx)) * (ZOOM_W_ONE - (wy)) + \
+                 ((p21) * (ZOOM_W_ONE - (wx)) + (p22) * (wx)) * (wy) + \
+                 (1 << (ZOOM_W_BITS * 2 - 1))) >> (ZOOM_W_BITS * 2))
+
+// 按通道展开: 通道数n为常量(1、2、3、4)时多余的分支在编译期去掉, 不做逐像素判断
+#define ZOOM_EACH(n, op) \
+    do                   \
+    {                    \
+        op(0);           \
+        if (n > 1)       \
+            op(1);       \
+        if (n > 2)       \
+            op(2);       \
+        if (n > 3)       \
+            op(3);       \
+    } while (0)
+
+//相邻两点序号及权重(源图像上的定位)
+typedef struct
+{
+    int i1, i2; //相邻2个点序号, i2 = i1 + 1 (到达边界时 i2 = i1)
+    int w;      //i2点权重(Q8), i1点权重为 ZOOM_W_ONE - w
+} Zoom_Step;
+
+// 有理数倍率重复模式的上限: 每组最多8个向量(每向量4个输出点), 每向量最多读2个16字节块
+#define ZOOM_RATIO_VECTORS 8
+#define ZOOM_RATIO_POINTS (ZOOM_RATIO_VECTORS * 4)
+#define ZOOM_RATIO_LOADS 2
+
+/*
+ *  有理数倍率 p/q 的重复模式(缩放计划准备时按定位表生成一次)
+ *  输出每p点对应源图像q点, 各点相对序号和权重每个周期都相同, 不再顺序读取整行的定位表:
+ *  标量版本对常用倍率(2、3、4、1.5、2.5、4/3、0.5、0.25、2/3、0.75)按编译期的 p、q 把一个周期完全展开;
+ *  3、4通道的ssse3版本把凑满整周期且为4的倍数的一组输出点每4点作为一个向量, 从连续的源图像字节块中按重排表取像素
+ */
+typedef struct
+{
+    int p, q;
+    int group;   //每组输出点数(整周期且为4的倍数, 标量版本按周期p处理, 不受此限)
+    int step;    //每组源图像前进点数
+    int simd;    //字节重排表可用(3、4通道, 每个向量读取不超过 ZOOM_RATIO_LOADS 块)
+    int vectors; //每组向量数, group / 4
+    int loads;   //每个向量读取的16字节块数
+    int reach;   //一组读取的源图像字节范围(相对组起点), 用于避免越界读
+    int off[ZOOM_RATIO_VECTORS]; //每个向量读取起点(源像素, 相对组起点)
+    int wx[ZOOM_RATIO_VECTORS][4];
+    //字节重排表: near 直接得到输出排列(3通道rgb 12字节), i1、i2 得到rgbx排列(3通道时x为0)
+    unsigned char near[ZOOM_RATIO_VECTORS][ZOOM_RATIO_LOADS][16];
+    unsigned char i1[ZOOM_RATIO_VECTORS][ZOOM_RATIO_LOADS][16];
+    unsigned char i2[ZOOM_RATIO_VECTORS][ZOOM_RATIO_LOADS][16];
+} Zoom_Ratio;
+
+/*
+ *  行处理内核
+ *  参数:
+ *      out: 输出行
+ *      line1, line2: 源图像上、下两行(最近点插值只用line1)
+ *      xt: 列定位表,从输出行第0个点开始
+ *      count: 输出点数
+ *      width: 源图像宽,3通道的SIMD版本按4字节整读像素,据此避免越界读
+ *      wy: 下方行权重(Q8)
+ *  linear_h、linear_v 把双线性插值拆成两步, 结果与 linear 逐字节一致:
+ *      linear_h: 一行源图像水平插值, 输出每通道 p1 * (ZOOM_W_ONE - wx) + p2 * wx (Q8, 最大 255 << 8)
+ *      linear_v: 两行水平插值结果垂直插值, 与通道数无关, h1、h2 各 count 个值(输出点数 * 通道数)
+ *  *_ratio: 有理数倍率重复模式版本, 只处理开头的整周期(整组)输出点, 返回已处理点数, 余下部分(不足一周期的行尾、
+ *           会读到行尾之外的周期)及不比通用版本快的情况(返回0)交给通用版本, 可为NULL(不使用):
+ *           标量版本按周期展开, 用于各级的1、2通道, sse2级别的3、4通道(4通道双线性只在放大时)和4通道最近点插值;
+ *           ssse3、avx2级别3、4通道的双线性按字节重排表处理(整数倍缩小时用标量版本),
+ *           3通道最近点插值只在一个向量读1块(放大)时按重排表处理, 缩小时用通用版本
+ */
+typedef struct
+{
+    const char *name;
+    int channels;
+    void (*linear)(unsigned char *out, const unsigned char *line1, const unsigned char *line2,
+                   const Zoom_Step *xt, int count, int width, int wy);
+    void (*near)(unsigned char *out, const unsigned char *line1,
+                 const Zoom_Step *xt, int count, int width);
+    void (*linear_h)(unsigned short *out, const unsigned char *line1,
+                     const Zoom_Step *xt, int count, int width);
+    void (*linear_v)(unsigned char *out, const unsigned short *h1, const unsigned short *h2,
+                     int count, int wy);
+    int (*linear_ratio)(unsigned char *out, const unsigned char *line1, const unsigned char *line2,
+                        const Zoom_Ratio *r, int count, int width, int wy);
+    int (*near_ratio)(unsigned char *out, const unsigned char *line1,
+                      const Zoom_Ratio *r, int count, int width);
+    int (*linear_h_ratio)(unsigned short *out, const unsigned char *line1,
+                          const Zoom_Ratio *r, int count, int width);
+} Zoom_Kernel;
+
+/*
+ *  生成有理数倍率 p/q 的重复模式
+ *  参数:
+ *      r: 输出
+ *      xt: 按 p/q 定位生成的列定位表(第i点对应源坐标 i * q / p)
+ *      count: 定位表点数
+ *      n: 每像素通道数(字节数), 3、4通道时生成字节重排表
+ *  返回: 0成功 -1不适用(一组超过上限或比整行还长)
+ */
+int zoom_ratio_init(Zoom_Ratio *r, const Zoom_Step *xt, int count, int p, int q, int n);
+
+/*
+ *  获取当前cpu可用的最快内核(首次调用时检测cpu,之后直接返回)
+ *  参数:
+ *      channels: 每像素通道数(字节数), 1、2、3或4
+ *  返回: 内核指针, NULL不支持该通道数
+ *  说明: 环境变量 ZOOM_SIMD 可限制最高级别: 0/标量 1/sse2 2/ssse3 3/avx2
+ */
+const Zoom_Kernel *zoom_kernel(int channels);
+
+#endif